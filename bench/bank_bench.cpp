@@ -0,0 +1,134 @@
+#include <benchmark/benchmark.h>
+#include <array>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+#include "../include/opcode.h"
+#include "../include/cpu.h"
+#include "../include/bank.h"
+#include "./program.h"
+
+/**
+ *  A long block of arithmetic, every lane starts with different
+ *  registers so they compute different values on the same path.
+ */ 
+static const std::array<uint8_t, 34> lanes_loop
+{{
+    0x70, 0x01, 0x81, 0x04, 0x82, 0x13, 0x83, 0x24, 0x84, 0x35, 0x85, 0x41, 0x86, 0x56, 0x87, 0x62,
+    0x71, 0x03, 0x82, 0x14, 0x83, 0x23, 0x84, 0x37, 0x85, 0x4E, 0x86, 0x54, 0x87, 0x64, 0x68, 0x71,
+    0x11, 0xFE
+}};
+
+static void load_lanes_loop(chip::CPU& cpu, uint32_t lane)
+{
+    load_program(cpu, lanes_loop);
+
+    for(int i = 0 ; i < 16 ; i++) cpu.V[i] = lane * 16 + i;
+}
+
+/**
+ *  Every instance on its own cpu, stepped one after the other.
+ */ 
+template<uint32_t LANES>
+static void BM_LanesCycle(benchmark::State& state)
+{
+    std::vector<chip::CPU> cpus(LANES);
+
+    for(uint32_t lane = 0 ; lane < LANES ; lane++) load_lanes_loop(cpus[lane], lane);
+
+    for(auto _ : state)
+    {
+        for(chip::CPU& cpu : cpus) chip::cycle(cpu);
+    }
+
+    state.SetItemsProcessed(state.iterations() * LANES);
+}
+BENCHMARK_TEMPLATE(BM_LanesCycle, 8);
+BENCHMARK_TEMPLATE(BM_LanesCycle, 16);
+BENCHMARK_TEMPLATE(BM_LanesCycle, 32);
+BENCHMARK_TEMPLATE(BM_LanesCycle, 64);
+
+template<uint32_t LANES>
+static void BM_LanesBank(benchmark::State& state)
+{
+    std::unique_ptr<chip::CPUBank<LANES>> bank{new chip::CPUBank<LANES>{}};
+
+    for(uint32_t lane = 0 ; lane < LANES ; lane++)
+    {
+        chip::CPU cpu{};
+        load_lanes_loop(cpu, lane);
+        chip::set_lane(*bank, lane, cpu);
+    }
+
+    for(auto _ : state) chip::step_bank(*bank);
+
+    state.SetItemsProcessed(state.iterations() * LANES);
+}
+BENCHMARK_TEMPLATE(BM_LanesBank, 8);
+BENCHMARK_TEMPLATE(BM_LanesBank, 16);
+BENCHMARK_TEMPLATE(BM_LanesBank, 32);
+BENCHMARK_TEMPLATE(BM_LanesBank, 64);
+
+/**
+ *  128 additions that are all different instructions, followed by a
+ *  jump back to the first one. Each lane starts on a different addition
+ *  so, the lanes never run the same instruction.
+ */
+static std::vector<uint8_t> make_divergent_loop()
+{
+    std::vector<uint8_t> program;
+
+    for(uint32_t i = 0 ; i < 128 ; i++)
+    {
+        program.push_back(0x70 | (i % 16));
+        program.push_back(i / 16 + 1);
+    }
+
+    program.insert(program.end(), { 0x11, 0xFE });
+
+    return program;
+}
+
+static void load_divergent_loop(chip::CPU& cpu, uint32_t lane)
+{
+    load_program(cpu, make_divergent_loop());
+
+    cpu.PC = chip::ROM_START + lane * 4;
+}
+
+template<uint32_t LANES>
+static void BM_DivergentCycle(benchmark::State& state)
+{
+    std::vector<chip::CPU> cpus(LANES);
+
+    for(uint32_t lane = 0 ; lane < LANES ; lane++) load_divergent_loop(cpus[lane], lane);
+
+    for(auto _ : state)
+    {
+        for(chip::CPU& cpu : cpus) chip::cycle(cpu);
+    }
+
+    state.SetItemsProcessed(state.iterations() * LANES);
+}
+BENCHMARK_TEMPLATE(BM_DivergentCycle, 8);
+BENCHMARK_TEMPLATE(BM_DivergentCycle, 64);
+
+template<uint32_t LANES>
+static void BM_DivergentBank(benchmark::State& state)
+{
+    std::unique_ptr<chip::CPUBank<LANES>> bank{new chip::CPUBank<LANES>{}};
+
+    for(uint32_t lane = 0 ; lane < LANES ; lane++)
+    {
+        chip::CPU cpu{};
+        load_divergent_loop(cpu, lane);
+        chip::set_lane(*bank, lane, cpu);
+    }
+
+    for(auto _ : state) chip::step_bank(*bank);
+
+    state.SetItemsProcessed(state.iterations() * LANES);
+}
+BENCHMARK_TEMPLATE(BM_DivergentBank, 8);
+BENCHMARK_TEMPLATE(BM_DivergentBank, 64);
@@ -0,0 +1,201 @@
+#include <benchmark/benchmark.h>
+#include <array>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+
+#include "../include/opcode.h"
+#include "../include/cpu.h"
+#include "../include/frame.h"
+#include "../include/disassembler.h"
+#include "./program.h"
+
+/**
+ *  A family of instructions repeated and followed by a jump back
+ *  to the first one so, cycle() spends its time on that family.
+ */
+struct OpcodeLoop
+{
+    const char* name;
+    std::vector<uint8_t> setup; // Runs once, before the loop.
+    std::vector<uint8_t> body;  // Repeated until the loop is full.
+};
+
+static const std::array<OpcodeLoop, 10> opcode_loops
+{{
+    { "load 6XNN",       {},                       { 0x60, 0x2A } },
+    { "arithmetic 8XY4", {},                       { 0x81, 0x24 } },
+    { "skip 3XNN",       {},                       { 0x30, 0x01 } },
+    { "key EX9E",        {},                       { 0xE0, 0x9E } },
+    { "timer FX15 FX07", {},                       { 0xF0, 0x15, 0xF0, 0x07 } },
+    { "random CXNN",     {},                       { 0xC0, 0xFF } },
+    { "bcd FX33",        { 0xA3, 0x00 },           { 0xF2, 0x33 } },
+    { "memory FX55 FX65",{ 0xA3, 0x00 },           { 0xF5, 0x55, 0xF5, 0x65 } },
+    { "draw DXYN",       { 0xA0, 0x00 },           { 0xD0, 0x15 } },
+    { "call 2NNN 00EE",  {},                       {} }
+}};
+
+static void load_opcode_loop(chip::CPU& cpu, const OpcodeLoop& loop)
+{
+    std::vector<uint8_t> program = loop.setup;
+
+    const uint16_t start = chip::ROM_START + program.size();
+
+    if(loop.body.empty())
+    {
+        // A call to a return and a jump back to the call.
+        const uint16_t call = start + 4;
+
+        program.insert(program.end(), { static_cast<uint8_t>(0x20 | (call >> 8)), static_cast<uint8_t>(call & 0xFF) });
+        program.insert(program.end(), { static_cast<uint8_t>(0x10 | ((start - 2) >> 8)), static_cast<uint8_t>((start - 2) & 0xFF) });
+        program.insert(program.end(), { 0x00, 0xEE });
+    }
+    else
+    {
+        while(program.size() < 64) program.insert(program.end(), loop.body.begin(), loop.body.end());
+
+        // Jumps land on the instruction after their address.
+        program.insert(program.end(), { static_cast<uint8_t>(0x10 | ((start - 2) >> 8)), static_cast<uint8_t>((start - 2) & 0xFF) });
+    }
+
+    chip::load_font_set(cpu);
+
+    load_program(cpu, program);
+}
+
+static void BM_CycleOpcode(benchmark::State& state)
+{
+    const OpcodeLoop& loop = opcode_loops[state.range(0)];
+
+    chip::CPU cpu{};
+    load_opcode_loop(cpu, loop);
+
+    for(auto _ : state) chip::cycle(cpu);
+
+    state.SetLabel(loop.name);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CycleOpcode)->DenseRange(0, opcode_loops.size() - 1);
+
+/**
+ *  DXYN with its height, X and Y as arguments: rows on a byte
+ *  boundary, rows split between two bytes and sprites clipped by
+ *  the right and bottom edges.
+ */
+static void BM_DrawSprite(benchmark::State& state)
+{
+    chip::CPU cpu{};
+    chip::load_font_set(cpu);
+
+    cpu.V[0] = state.range(1);
+    cpu.V[1] = state.range(2);
+    cpu.I    = 0x0;
+
+    const chip::OpCode op_code{ 0xD, static_cast<uint16_t>(0x010 | state.range(0)) };
+
+    for(auto _ : state)
+    {
+        chip::op_code_0xD(cpu, op_code);
+        benchmark::DoNotOptimize(cpu.screen);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DrawSprite)->ArgNames({ "height", "x", "y" })
+                        ->Args({ 1, 0, 0 })->Args({ 5, 0, 0 })->Args({ 15, 0, 0 })
+                        ->Args({ 5, 4, 10 })->Args({ 15, 4, 10 })
+                        ->Args({ 5, 60, 10 })->Args({ 15, 10, 28 });
+
+static void BM_LoadROM(benchmark::State& state)
+{
+    const std::string path = "load_rom_bench.ch8";
+
+    {
+        std::ofstream rom{path, std::ios::out | std::ios::binary | std::ios::trunc};
+        for(int i = 0 ; i < state.range(0) ; i++) rom.put(static_cast<char>(i * 7));
+    }
+
+    chip::CPU cpu{};
+
+    for(auto _ : state) chip::load_ROM(cpu, path);
+
+    std::remove(path.c_str());
+
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_LoadROM)->Arg(256)->Arg(3584);
+
+static std::array<uint64_t, 32> make_screen()
+{
+    std::array<uint64_t, 32> screen{};
+
+    for(int y = 0 ; y < 32 ; y++) screen[y] = 0x9E3779B97F4A7C15ULL * (y + 1);
+
+    return screen;
+}
+
+/**
+ *  The conversion the SDL frontend did before screen_to_argb(): a
+ *  get_pixel() per pixel.
+ */
+static void BM_PixelToARGB(benchmark::State& state)
+{
+    const auto screen = make_screen();
+    std::array<uint32_t, chip::SCREEN_WIDHT * chip::SCREEN_HEIGHT> pixels{};
+
+    for(auto _ : state)
+    {
+        for(uint32_t y = 0 ; y < chip::SCREEN_HEIGHT ; y++)
+        {
+            for(uint32_t x = 0 ; x < chip::SCREEN_WIDHT ; x++)
+            {
+                const uint8_t pixel = chip::get_pixel(screen, x, y);
+                pixels[x + y * chip::SCREEN_WIDHT] = (0x00FFFFFF * pixel) | 0xFF000000;
+            }
+        }
+
+        benchmark::DoNotOptimize(pixels);
+    }
+
+    state.SetItemsProcessed(state.iterations() * pixels.size());
+}
+BENCHMARK(BM_PixelToARGB);
+
+static void BM_ScreenToARGB(benchmark::State& state)
+{
+    const auto screen = make_screen();
+    std::array<uint32_t, chip::SCREEN_WIDHT * chip::SCREEN_HEIGHT> pixels{};
+
+    const chip::ScreenRect full{ 0, 0, chip::SCREEN_WIDHT, chip::SCREEN_HEIGHT };
+
+    for(auto _ : state)
+    {
+        chip::screen_to_argb(screen, full, pixels.data());
+        benchmark::DoNotOptimize(pixels);
+    }
+
+    state.SetItemsProcessed(state.iterations() * pixels.size());
+}
+BENCHMARK(BM_ScreenToARGB);
+
+static void BM_Disassemble(benchmark::State& state)
+{
+    std::array<uint8_t, 0xE00> program{};
+
+    for(uint32_t i = 0 ; i < program.size() ; i++) program[i] = static_cast<uint8_t>(i * 0x9D + (i >> 3));
+
+    std::ostringstream output;
+
+    for(auto _ : state)
+    {
+        output.str("");
+        chip::disassemble(program, output);
+        benchmark::DoNotOptimize(output);
+    }
+
+    state.SetItemsProcessed(state.iterations() * program.size() / 2);
+}
+BENCHMARK(BM_Disassemble);
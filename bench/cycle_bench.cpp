@@ -0,0 +1,177 @@
+#include <benchmark/benchmark.h>
+#include <array>
+#include <cstdint>
+
+#include "../include/opcode.h"
+#include "../include/cpu.h"
+#include "../include/block.h"
+#include "../include/threaded.h"
+#include "../include/jit.h"
+#include "./program.h"
+
+/**
+ *  A tight loop that keeps adding registers and jumps back
+ *  to its first instruction, like most ROMs do while waiting
+ *  for the delay timer.
+ */ 
+static const std::array<uint8_t, 10> tight_loop
+{{
+    0x70, 0x01, // V0 += 1.
+    0x81, 0x04, // V1 += V0.
+    0x82, 0x13, // V2 ^= V1.
+    0x30, 0xFF, // Skip next instruction if V0 == 0xFF.
+    0x11, 0xFE  // Jump back to 0x200.
+}};
+
+/**
+ *  cycle() as it was before the decoded cache: every instruction
+ *  is fetched and looked up on the decode table.
+ */ 
+static void BM_TableCycle(benchmark::State& state)
+{
+    chip::CPU cpu{};
+    load_program(cpu, tight_loop);
+
+    for(auto _ : state)
+    {
+        const chip::Instruction& instruction = chip::decode_table()[chip::fetch(cpu)];
+
+        chip::handlers[instruction.handler](cpu, instruction.op_code);
+
+        cpu.cycles += 1;
+        cpu.PC     += 2;
+        if(cpu.PC >= chip::ROM_START + tight_loop.size()) cpu.PC = chip::ROM_START;
+    }
+}
+BENCHMARK(BM_TableCycle);
+
+static void BM_CachedCycle(benchmark::State& state)
+{
+    chip::CPU cpu{};
+    load_program(cpu, tight_loop);
+
+    for(auto _ : state)
+    {
+        chip::cycle(cpu);
+        if(cpu.PC >= chip::ROM_START + tight_loop.size()) cpu.PC = chip::ROM_START;
+    }
+}
+BENCHMARK(BM_CachedCycle);
+
+static void BM_BlockCycle(benchmark::State& state)
+{
+    chip::CPU cpu{};
+    chip::BlockCache cache{};
+    load_program(cpu, tight_loop);
+
+    uint64_t executed = 0;
+
+    for(auto _ : state)
+    {
+        executed += chip::run_block(cache, cpu, 0xFFFF);
+        if(cpu.PC >= chip::ROM_START + tight_loop.size()) cpu.PC = chip::ROM_START;
+    }
+
+    state.SetItemsProcessed(executed);
+}
+BENCHMARK(BM_BlockCycle);
+
+/**
+ *  Sets the delay timer and polls it until it reaches zero, the
+ *  way most ROMs wait for the next frame.
+ */ 
+static const std::array<uint8_t, 12> timer_loop
+{{
+    0x60, 0xFF, // V0 = 0xFF.
+    0xF0, 0x15, // DT = V0.
+    0xF0, 0x07, // V0 = DT.
+    0x30, 0x00, // Skip next instruction if V0 == 0.
+    0x12, 0x02, // Jump back to 0x204.
+    0x11, 0xFE  // Jump back to 0x200.
+}};
+
+static void BM_TimerLoopCycle(benchmark::State& state)
+{
+    chip::CPU cpu{};
+    load_program(cpu, timer_loop);
+
+    for(auto _ : state) chip::cycle(cpu);
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TimerLoopCycle);
+
+static void BM_TimerLoopBlock(benchmark::State& state)
+{
+    chip::CPU cpu{};
+    chip::BlockCache cache{};
+    load_program(cpu, timer_loop);
+
+    uint64_t executed = 0;
+
+    for(auto _ : state) executed += chip::run_block(cache, cpu, 0xFFFF);
+
+    state.SetItemsProcessed(executed);
+}
+BENCHMARK(BM_TimerLoopBlock);
+
+static void BM_TimerLoopThreaded(benchmark::State& state)
+{
+    chip::CPU cpu{};
+    load_program(cpu, timer_loop);
+
+    for(auto _ : state) chip::run_threaded(cpu, 1000);
+
+    state.SetItemsProcessed(state.iterations() * 1000);
+}
+BENCHMARK(BM_TimerLoopThreaded);
+
+static void BM_TimerLoopJit(benchmark::State& state)
+{
+    chip::CPU cpu{};
+    chip::Jit jit{};
+    load_program(cpu, timer_loop);
+
+    uint64_t executed = 0;
+
+    for(auto _ : state) executed += chip::run_jit(jit, cpu, 1000);
+
+    state.SetItemsProcessed(executed);
+}
+BENCHMARK(BM_TimerLoopJit);
+
+/**
+ *  A long block of arithmetic, where compiled code keeps every
+ *  register on the host registers.
+ */ 
+static const std::array<uint8_t, 34> arithmetic_loop
+{{
+    0x70, 0x01, 0x81, 0x04, 0x82, 0x13, 0x83, 0x24, 0x84, 0x35, 0x85, 0x41, 0x86, 0x56, 0x87, 0x62,
+    0x71, 0x03, 0x82, 0x14, 0x83, 0x23, 0x84, 0x37, 0x85, 0x4E, 0x86, 0x54, 0x87, 0x64, 0x88, 0x71,
+    0x11, 0xFE
+}};
+
+static void BM_ArithmeticLoopCycle(benchmark::State& state)
+{
+    chip::CPU cpu{};
+    load_program(cpu, arithmetic_loop);
+
+    for(auto _ : state) chip::cycle(cpu);
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ArithmeticLoopCycle);
+
+static void BM_ArithmeticLoopJit(benchmark::State& state)
+{
+    chip::CPU cpu{};
+    chip::Jit jit{};
+    load_program(cpu, arithmetic_loop);
+
+    uint64_t executed = 0;
+
+    for(auto _ : state) executed += chip::run_jit(jit, cpu, 1000);
+
+    state.SetItemsProcessed(executed);
+}
+BENCHMARK(BM_ArithmeticLoopJit);
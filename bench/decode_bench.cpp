@@ -0,0 +1,51 @@
+#include <benchmark/benchmark.h>
+#include <array>
+#include <cstdint>
+
+#include "../include/opcode.h"
+#include "../include/cpu.h"
+
+/**
+ *  Decode every instruction of a buffer filled with all the
+ *  16 bit words so both decoders see every OpCode family.
+ */ 
+static std::array<uint8_t, 0x20000> make_program()
+{
+    std::array<uint8_t, 0x20000> program{};
+
+    for(uint32_t i = 0 ; i < 0x10000 ; i++)
+    {
+        program[i * 2]     = i >> 8;
+        program[i * 2 + 1] = i & 0xFF;
+    }
+
+    return program;
+}
+
+static void BM_SwitchDecode(benchmark::State& state)
+{
+    const auto program = make_program();
+    uint32_t   PC      = 0;
+
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(chip::decode(program, PC));
+        PC = (PC + 2) & 0x1FFFE;
+    }
+}
+BENCHMARK(BM_SwitchDecode);
+
+static void BM_TableDecode(benchmark::State& state)
+{
+    const auto program = make_program();
+    uint32_t   PC      = 0;
+
+    chip::decode_table();
+
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(chip::predecode(program, PC));
+        PC = (PC + 2) & 0x1FFFE;
+    }
+}
+BENCHMARK(BM_TableDecode);
@@ -0,0 +1,8 @@
+#include <benchmark/benchmark.h>
+
+int main (int argc, char **argv)
+{  
+  ::benchmark::Initialize(&argc, argv);
+  ::benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,121 @@
+#include <benchmark/benchmark.h>
+#include <array>
+#include <cstdio>
+#include <string>
+#include <cstdint>
+
+#include "../include/opcode.h"
+#include "../include/cpu.h"
+#include "../include/batch.h"
+#include "../include/profiler.h"
+#include "../include/recorder.h"
+#include "../include/trace.h"
+#include "./program.h"
+#include "../include/debbuger.h"
+
+/**
+ *  Waits for the delay timer, draws a digit and does some arithmetic,
+ *  a mix of the instructions most ROMs spend their time on.
+ */
+static const std::array<uint8_t, 26> profiled_loop
+{{
+    0x60, 0x01, // 0x200 V0 = 1.
+    0xF0, 0x15, // 0x202 DT = V0.
+    0xF1, 0x07, // 0x204 V1 = DT.
+    0x31, 0x00, // 0x206 Skip next instruction if V1 == 0.
+    0x12, 0x02, // 0x208 Jump to 0x204.
+    0xA0, 0x00, // 0x20A I = sprite of digit 0.
+    0xD3, 0x45, // 0x20C Draw it at (V3, V4).
+    0x73, 0x05, // 0x20E V3 += 5.
+    0x84, 0x34, // 0x210 V4 += V3.
+    0x85, 0x43, // 0x212 V5 ^= V4.
+    0x35, 0x00, // 0x214 Skip next instruction if V5 == 0.
+    0x11, 0xFE, // 0x216 Jump to 0x200.
+    0x11, 0xFE  // 0x218 Jump to 0x200 when the previous one is skipped.
+}};
+
+static void load_profiled_loop(chip::CPU& cpu)
+{
+    chip::load_font_set(cpu);
+
+    load_program(cpu, profiled_loop);
+    chip::set_clock_rate(cpu, 14 * chip::TIMER_RATE);
+}
+
+static void BM_RunUnprofiled(benchmark::State& state)
+{
+    chip::CPU cpu{};
+    load_profiled_loop(cpu);
+
+    for(auto _ : state) chip::run_cycles(cpu, 1000);
+
+    state.SetItemsProcessed(state.iterations() * 1000);
+}
+BENCHMARK(BM_RunUnprofiled);
+
+static void BM_RunProfiled(benchmark::State& state)
+{
+    chip::CPU cpu{};
+    chip::Profile profile{};
+    load_profiled_loop(cpu);
+
+    for(auto _ : state) chip::run_profiled(cpu, profile, 1000);
+
+    state.SetItemsProcessed(state.iterations() * 1000);
+}
+BENCHMARK(BM_RunProfiled);
+
+static void BM_RunRecorded(benchmark::State& state)
+{
+    chip::CPU cpu{};
+    chip::FlightRecorder recorder{};
+    load_profiled_loop(cpu);
+
+    for(auto _ : state) chip::run_recorded(cpu, recorder, 1000);
+
+    state.SetItemsProcessed(state.iterations() * 1000);
+}
+BENCHMARK(BM_RunRecorded);
+
+static void BM_RunTraced(benchmark::State& state)
+{
+    const std::string path = "run_traced_bench.trace";
+
+    chip::CPU cpu{};
+    load_profiled_loop(cpu);
+
+    {
+        chip::TraceWriter writer{path};
+
+        for(auto _ : state) chip::run_traced(cpu, writer, 1000);
+
+        chip::finish_trace(writer);
+
+        state.counters["bytes_per_instruction"] = static_cast<double>(writer.bytes) / writer.instructions;
+    }
+
+    std::remove(path.c_str());
+
+    state.SetItemsProcessed(state.iterations() * 1000);
+}
+BENCHMARK(BM_RunTraced);
+
+/**
+ *  The debugger with nothing set, with a breakpoint the loop never
+ *  reaches and with a watchpoint the loop never touches.
+ */
+static void BM_RunDebugged(benchmark::State& state)
+{
+    chip::CPU cpu{};
+    chip::Debugger debugger{};
+    load_profiled_loop(cpu);
+
+    if(state.range(0) == 1) chip::set_debug_flags(debugger, 0x700, chip::DEBUG_BREAK, true);
+    if(state.range(0) == 2) chip::set_debug_flags(debugger, 0x700, chip::DEBUG_WATCH_READ | chip::DEBUG_WATCH_WRITE, true);
+
+    for(auto _ : state) chip::debug_continue(cpu, debugger, 1000);
+
+    state.SetLabel(state.range(0) == 0 ? "none" : state.range(0) == 1 ? "breakpoint" : "watchpoint");
+    state.SetItemsProcessed(state.iterations() * 1000);
+}
+BENCHMARK(BM_RunDebugged)->DenseRange(0, 2);
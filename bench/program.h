@@ -0,0 +1,23 @@
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include <cstddef>
+
+#include "../include/cpu.h"
+
+/**
+ *  Copy a program to the start of the ROM and drop the code cached
+ *  for that memory, like load_ROM() does for a file.
+ *
+ *  @param cpu the cpu whose memory will hold the program.
+ *  @param program the bytes of the program.
+ */
+template<typename Program>
+static void load_program(chip::CPU& cpu, const Program& program)
+{
+    for(size_t i = 0 ; i < program.size() ; i++) cpu.memory[chip::ROM_START + i] = program[i];
+
+    chip::invalidate(cpu, chip::ROM_START, program.size());
+}
+
+#endif
@@ -0,0 +1,64 @@
+#include <benchmark/benchmark.h>
+#include <array>
+#include <cstdint>
+
+#include "../include/opcode.h"
+#include "../include/cpu.h"
+#include "../include/batch.h"
+#include "../include/rewind.h"
+#include "./program.h"
+
+/**
+ *  Draws a digit that moves one pixel per frame and counts the frames
+ *  on memory, like the main loop of most games.
+ */ 
+static const std::array<uint8_t, 22> frame_loop
+{{
+    0x60, 0x01, // 0x200 V0 = 1.
+    0xF0, 0x15, // 0x202 DT = V0.
+    0xF1, 0x07, // 0x204 V1 = DT.
+    0x31, 0x00, // 0x206 Skip next instruction if V1 == 0.
+    0x12, 0x02, // 0x208 Jump back to 0x204.
+    0xD2, 0x35, // 0x20A Draw digit at (V2, V3).
+    0x72, 0x01, // 0x20C V2 += 1.
+    0xD2, 0x35, // 0x20E Draw digit at (V2, V3).
+    0xA3, 0x00, // 0x210 I = 0x300.
+    0xF2, 0x33, // 0x212 Store BCD of V2 at I.
+    0x11, 0xFE  // 0x214 Jump back to 0x200.
+}};
+
+static void load_frame_loop(chip::CPU& cpu)
+{
+    chip::load_font_set(cpu);
+
+    load_program(cpu, frame_loop);
+    chip::set_clock_rate(cpu, 14 * chip::TIMER_RATE);
+}
+
+static void BM_RunFrame(benchmark::State& state)
+{
+    chip::CPU cpu{};
+    load_frame_loop(cpu);
+
+    for(auto _ : state) chip::run_cycles(cpu, 14);
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RunFrame);
+
+static void BM_RunFrameWithRewind(benchmark::State& state)
+{
+    chip::CPU cpu{};
+    chip::RewindBuffer buffer{};
+    load_frame_loop(cpu);
+
+    for(auto _ : state)
+    {
+        chip::run_cycles(cpu, 14);
+        chip::push_frame(buffer, cpu);
+    }
+
+    state.counters["bytes_per_frame"] = static_cast<double>(buffer.used) / buffer.frames.size();
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RunFrameWithRewind);
@@ -0,0 +1,37 @@
+#include <benchmark/benchmark.h>
+#include <vector>
+#include <cstdint>
+
+#include "../include/opcode.h"
+#include "../include/cpu.h"
+#include "../include/state.h"
+
+static void BM_SaveState(benchmark::State& state)
+{
+    chip::CPU cpu{};
+    std::vector<uint8_t> buffer(chip::STATE_SIZE);
+
+    for(auto _ : state)
+    {
+        chip::save_state(cpu, buffer.data());
+        benchmark::DoNotOptimize(buffer.data());
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SaveState);
+
+static void BM_LoadState(benchmark::State& state)
+{
+    chip::CPU cpu{};
+    const std::vector<uint8_t> buffer = chip::save_state(cpu);
+
+    for(auto _ : state)
+    {
+        chip::load_state(cpu, buffer);
+        benchmark::DoNotOptimize(cpu.memory.data());
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LoadState);
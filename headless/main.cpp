@@ -0,0 +1,297 @@
+#include <string>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "../include/cpu.h"
+#include "../include/batch.h"
+#include "../include/headless.h"
+#include "../include/movie.h"
+#include "../include/profiler.h"
+#include "../include/recorder.h"
+#include "../include/trace.h"
+#include "../include/debbuger.h"
+
+static void print_usage()
+{
+    std::cout << "Usage: chip8-headless <ROM> [options] \n"
+              << "  --frames N            run N frames of 1/60 s (default 600) \n"
+              << "  --cycles N            run N instructions instead of a number of frames \n"
+              << "  --cycles-per-frame N  instructions per frame (default 14) \n"
+              << "  --input FILE          input script with <frame> <hex key pad> lines \n"
+              << "  --movie FILE          replay a movie recorded by chip8 --record, for as long as it lasts \n"
+              << "  --seed N              seed of the random number generator (default 0) \n"
+              << "  --ppm FILE            write the final screen as a PPM image \n"
+              << "  --profile N           count the instructions executed and report the N hottest addresses \n"
+              << "  --trace FILE          write every instruction executed to a trace, read it with chip8-trace \n"
+              << "  --debug FILE          run the debugger commands of FILE, - reads them from the standard input \n"
+              << "  --no-recorder         don't keep the last instructions executed to write them on a fault \n"
+              << "  --halt-on-fault       stop the run on any fault, like an unknown instruction \n"
+              << "Unless --no-recorder is given, a run stops before a call with a full stack or a return with an empty one. \n";
+}
+
+/**
+ *  Run debugger commands, one per line, until they end or the budget
+ *  of the run is used. Addresses are hexadecimal.
+ *
+ *    b ADDR  break before the instruction at ADDR
+ *    r ADDR  break before an instruction that reads ADDR
+ *    w ADDR  break before an instruction that writes ADDR
+ *    d ADDR  delete the breakpoints of ADDR
+ *    s [N]   execute the next N instructions (default 1)
+ *    c       continue until a breakpoint
+ *    u ADDR  run until the PC is ADDR
+ *    p       print the state of the cpu
+ *    q       quit
+ */
+static void run_debugger(chip::CPU& cpu, std::istream& commands, uint64_t cycles)
+{
+    chip::Debugger debugger{};
+    std::string    line;
+
+    while(cpu.cycles < cycles && std::getline(commands, line))
+    {
+        std::istringstream words{line};
+        std::string        command;
+        uint64_t           value = 0;
+
+        if(!(words >> command)) continue;
+
+        const bool has_value = static_cast<bool>(words >> (command == "s" ? std::dec : std::hex) >> value);
+        const auto address   = static_cast<uint16_t>(value);
+
+        if(command == "b" && has_value)      chip::set_debug_flags(debugger, address, chip::DEBUG_BREAK,       true);
+        else if(command == "r" && has_value) chip::set_debug_flags(debugger, address, chip::DEBUG_WATCH_READ,  true);
+        else if(command == "w" && has_value) chip::set_debug_flags(debugger, address, chip::DEBUG_WATCH_WRITE, true);
+        else if(command == "d" && has_value) chip::set_debug_flags(debugger, address, chip::DEBUG_BREAK | chip::DEBUG_WATCH_READ | chip::DEBUG_WATCH_WRITE, false);
+        else if(command == "p")              chip::print_debugger(cpu, debugger);
+        else if(command == "q")              break;
+        else if(command == "s" || command == "c" || (command == "u" && has_value))
+        {
+            if(command == "s")      for(uint64_t i = 0 ; i < (has_value ? value : 1) && cpu.cycles < cycles ; i++) chip::debug_step(cpu, debugger);
+            else if(command == "c") chip::debug_continue(cpu, debugger, cycles - cpu.cycles);
+            else                    chip::debug_run_to(cpu, debugger, address, cycles - cpu.cycles);
+
+            chip::print_debugger(cpu, debugger);
+        }
+        else std::cout << "Unknown command: " << line << "\n";
+
+        std::cout << std::flush;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 2)
+    {
+        print_usage();
+        return 1;
+    }
+
+    uint64_t    frames           = 600;
+    uint64_t    cycles           = 0;
+    uint64_t    cycles_per_frame = 14;
+    uint64_t    seed             = 0;
+    uint64_t    profile_top      = 0;
+    bool        flight_recorder  = true;
+    bool        halt_on_fault    = false;
+    std::string input_path;
+    std::string movie_path;
+    std::string ppm_path;
+    std::string trace_path;
+    std::string debug_path;
+
+    for(int i = 2 ; i < argc ; i++)
+    {
+        const std::string option = argv[i];
+
+        if(option == "--no-recorder" || option == "--halt-on-fault")
+        {
+            if(option == "--no-recorder") flight_recorder = false;
+            else                          halt_on_fault   = true;
+
+            continue;
+        }
+
+        if(i + 1 >= argc)
+        {
+            print_usage();
+            return 1;
+        }
+
+        const char* value = argv[++i];
+
+        if(option == "--frames")                 frames           = std::strtoull(value, nullptr, 10);
+        else if(option == "--cycles")            cycles           = std::strtoull(value, nullptr, 10);
+        else if(option == "--cycles-per-frame")  cycles_per_frame = std::strtoull(value, nullptr, 10);
+        else if(option == "--input")             input_path       = value;
+        else if(option == "--movie")             movie_path       = value;
+        else if(option == "--seed")              seed             = std::strtoull(value, nullptr, 10);
+        else if(option == "--ppm")               ppm_path         = value;
+        else if(option == "--profile")           profile_top      = std::strtoull(value, nullptr, 10);
+        else if(option == "--trace")             trace_path       = value;
+        else if(option == "--debug")             debug_path       = value;
+        else
+        {
+            print_usage();
+            return 1;
+        }
+    }
+
+    if(cycles_per_frame == 0)
+    {
+        std::cout << "The number of instructions per frame must be greater than zero \n";
+        return 1;
+    }
+
+    chip::CPU chip8{};
+    chip::Movie movie{};
+    chip::Profile profile{};
+    chip::FlightRecorder recorder{&std::cout, halt_on_fault};
+    std::unique_ptr<chip::TraceWriter> trace;
+    std::vector<chip::InputEvent> events;
+
+    try
+    {
+        chip::load_font_set(chip8);
+        chip::load_ROM(chip8, std::string{argv[1]});
+
+        if(!input_path.empty())
+        {
+            std::ifstream input{input_path};
+            if(!input.is_open()) throw std::runtime_error{"Unable to open input script " + input_path};
+
+            events = chip::parse_input(input);
+        }
+
+        if(!movie_path.empty())
+        {
+            std::ifstream file{movie_path, std::ios::in | std::ios::binary};
+            if(!file.is_open()) throw std::runtime_error{"Unable to open movie " + movie_path};
+
+            movie = chip::read_movie(file);
+            chip::start_replay(chip8, movie);
+        }
+
+        if(!trace_path.empty()) trace.reset(new chip::TraceWriter{trace_path});
+    }
+    catch(const std::exception& error)
+    {
+        std::cout << error.what() << "\n";
+        return 1;
+    }
+
+    if(movie_path.empty())
+    {
+        chip::set_clock_rate(chip8, cycles_per_frame * chip::TIMER_RATE);
+        chip::seed_random(chip8, seed);
+    }
+
+    if(cycles == 0) cycles = movie_path.empty() ? frames * cycles_per_frame : movie.length;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    size_t next = 0;
+
+    // Each option adds its observer, a run without any of them has no observer at all.
+    const auto run = [&](auto observer)
+    {
+        return movie_path.empty() ? chip::run_scripted(chip8, events, cycles, cycles_per_frame, observer)
+                                  : chip::play_movie(chip8, movie, next, cycles, observer);
+    };
+
+    const auto run_with_trace = [&](auto observer)
+    {
+        return trace ? run(chip::observe_both(observer, chip::TraceObserver{*trace})) : run(observer);
+    };
+
+    const auto run_with_profile = [&](auto observer)
+    {
+        return profile_top > 0 ? run_with_trace(chip::observe_both(observer, chip::ProfileCounter{profile})) : run_with_trace(observer);
+    };
+
+    chip::StopReason stop = chip::STOP_BUDGET;
+
+    if(debug_path == "-")
+    {
+        run_debugger(chip8, std::cin, cycles);
+    }
+    else if(!debug_path.empty())
+    {
+        std::ifstream commands{debug_path};
+
+        if(!commands.is_open())
+        {
+            std::cout << "Unable to open debugger commands " << debug_path << "\n";
+            return 1;
+        }
+
+        run_debugger(chip8, commands, cycles);
+    }
+    else
+    {
+        stop = flight_recorder ? run_with_profile(chip::FlightObserver{recorder}) : run_with_profile(chip::NoObserver{});
+    }
+
+    const auto   end     = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(end - start).count();
+
+    std::cout << "Frames: " << (chip8.cycles + cycles_per_frame - 1) / cycles_per_frame << "\n";
+    std::cout << "Cycles: " << chip8.cycles << "\n";
+    std::cout << "Seconds: " << seconds << "\n";
+    std::cout << "Cycles per second: " << std::fixed << std::setprecision(0) << (seconds > 0 ? chip8.cycles / seconds : 0) << "\n";
+    std::cout << "Screen hash: " << std::hex << std::setw(16) << std::setfill('0') << chip::screen_hash(chip8.screen) << "\n";
+
+    if(stop == chip::STOP_FAULT)
+    {
+        std::cout << "\n";
+        chip::write_flight_recorder(std::cout, recorder, chip8);
+        std::cout << std::endl;
+
+        chip::print_sp_registers(chip8);
+        chip::print_stack(chip8);
+    }
+
+    if(profile_top > 0)
+    {
+        std::cout << std::dec << "\n";
+        chip::write_profile(std::cout, profile, chip8, profile_top);
+    }
+
+    if(trace)
+    {
+        try
+        {
+            chip::finish_trace(*trace);
+        }
+        catch(const std::exception& error)
+        {
+            std::cout << error.what() << "\n";
+            return 1;
+        }
+
+        std::cout << std::dec << "\nTrace: " << trace->instructions << " instructions, " << trace->bytes << " bytes\n";
+    }
+
+    if(!ppm_path.empty())
+    {
+        std::ofstream ppm{ppm_path, std::ios::out | std::ios::binary | std::ios::trunc};
+
+        if(!ppm.is_open())
+        {
+            std::cout << "Unable to write " << ppm_path << "\n";
+            return 1;
+        }
+
+        chip::write_ppm(ppm, chip8.screen, 4);
+    }
+
+    return stop == chip::STOP_FAULT ? 1 : 0;
+}
@@ -0,0 +1,631 @@
+#ifndef BANK_H
+#define BANK_H
+
+#include <array>
+#include <cstdint>
+#include <algorithm>
+
+#include "./cpu.h"
+
+namespace chip
+{
+    /**
+     *  On this file we present a bank of cpus that run the same program
+     *  side by side, like a ROM played with many inputs or seeds.
+     *
+     *  The state is stored as a structure of arrays: every register
+     *  holds one value per lane so, an instruction is executed on every
+     *  lane by a single branch free loop that the compiler turns into
+     *  SIMD code. While every lane is at the same PC the instruction is
+     *  fetched and decoded once for the whole bank. When the lanes
+     *  diverge they are split into groups running the same instruction
+     *  that are executed one after the other, the lanes of a small
+     *  group are executed one by one like scalar cpus, until they meet
+     *  again.
+     *
+     *  Every lane executes one instruction per step so, the lanes never
+     *  drift apart in time and they share the cycle counter.
+     */
+
+    /**
+     *  One bit per lane of a bank.
+     */
+    using LaneMask = uint64_t;
+
+    /**
+     *  State of LANES cpus. Memory is the only part that isn't split
+     *  by register, each lane has its own copy and the addresses that
+     *  may hold different bytes on different lanes are tracked so, the
+     *  code shared by every lane is fetched only from the first one.
+     */
+    template<uint32_t LANES>
+    struct CPUBank
+    {
+        static_assert(LANES > 0 && LANES <= 64, "A bank holds from 1 to 64 lanes");
+
+        CPUBank() : V{}, I{}, PC{}, SP{}, stack{}, DT{}, ST{}, DT_cycle{}, ST_cycle{}, key_pad{}, random_state{},
+                    draw{}, changed{}, screen{}, memory{}, divergent{}, cycles{0}, cycles_per_tick{1}, split_steps{0}
+        {
+            PC.fill(ROM_START);
+            random_state.fill(DEFAULT_RANDOM_STATE);
+            changed.fill(EMPTY_RECT);
+        }
+
+        std::array<std::array<uint8_t, LANES>, 16> V;      // V[X][lane].
+        std::array<uint16_t, LANES> I;
+        std::array<uint16_t, LANES> PC;
+        std::array<uint8_t,  LANES> SP;
+        std::array<std::array<uint16_t, LANES>, 16> stack; // stack[level][lane].
+        std::array<uint8_t,  LANES> DT;
+        std::array<uint8_t,  LANES> ST;
+        std::array<uint64_t, LANES> DT_cycle;
+        std::array<uint64_t, LANES> ST_cycle;
+        std::array<uint16_t, LANES> key_pad;
+        std::array<uint64_t, LANES> random_state;
+        std::array<uint8_t,  LANES> draw;
+        std::array<ScreenRect, LANES> changed;
+        std::array<std::array<uint64_t, LANES>, 32> screen;  // screen[row][lane] so, a sprite row is XORed on every lane at once.
+        std::array<std::array<uint8_t, 4096>, LANES> memory; // memory[lane][address].
+        std::array<uint64_t, 64> divergent; // Addresses that may not hold the same byte on every lane, one bit each.
+        uint64_t cycles;          // Instructions executed so far by each lane.
+        uint32_t cycles_per_tick; // Instructions executed on every tick of the timers.
+        uint64_t split_steps;     // Steps where the lanes did not all run the same instruction.
+    };
+
+    /**
+     *  How an instruction is executed on a group of lanes: on the whole
+     *  bank at once, on the whole bank keeping only the lanes of the
+     *  group, or one lane of the group after the other.
+     */
+    enum GroupWidth : uint8_t
+    {
+        WHOLE_BANK,
+        MASKED_GROUP,
+        SCALAR_GROUP
+    };
+
+    /**
+     *  Groups of up to this amount of lanes are executed one lane after
+     *  the other, computing every lane would cost more than that.
+     */
+    const uint32_t MAX_SCALAR_GROUP = 4;
+
+    /**
+     *  When the lanes diverge, the lanes left after finding this amount
+     *  of groups are executed one by one.
+     */
+    const uint32_t MAX_MASKED_GROUPS = 2;
+
+    template<uint32_t LANES>
+    static inline constexpr LaneMask all_lanes()
+    {
+        return LANES == 64 ? ~LaneMask{0} : (LaneMask{1} << LANES) - 1;
+    }
+
+    template<uint32_t LANES>
+    static inline bool is_divergent(const CPUBank<LANES>& bank, uint16_t address)
+    {
+        address &= 0xFFF;
+        return (bank.divergent[address >> 6] >> (address & 0x3F)) & 0x1;
+    }
+
+    /**
+     *  Mark a range of memory written by some of the lanes as divergent.
+     *
+     *  @param bank the bank whose memory has been written.
+     *  @param address the first address written.
+     *  @param size the number of bytes written.
+     */
+    template<uint32_t LANES>
+    static inline void mark_divergent(CPUBank<LANES>& bank, uint16_t address, uint16_t size)
+    {
+        for(uint32_t i = 0 ; i < size ; i++)
+        {
+            const uint16_t written = (address + i) & 0xFFF;
+            bank.divergent[written >> 6] |= uint64_t{1} << (written & 0x3F);
+        }
+    }
+
+    /**
+     *  Compare the memory of every lane and mark exactly the addresses
+     *  that differ as divergent.
+     *
+     *  @param bank the bank whose memory will be compared.
+     */
+    template<uint32_t LANES>
+    static inline void update_divergent(CPUBank<LANES>& bank)
+    {
+        bank.divergent.fill(0x0);
+
+        for(uint32_t lane = 1 ; lane < LANES ; lane++)
+        {
+            for(uint32_t address = 0 ; address < 4096 ; address++)
+            {
+                if(bank.memory[lane][address] != bank.memory[0][address]) mark_divergent(bank, address, 1);
+            }
+        }
+    }
+
+    /**
+     *  Copy the state of a cpu into a lane. Every lane shares the cycle
+     *  counter and the clock rate so, all the cpus put on a bank must
+     *  have executed the same number of instructions at the same rate.
+     *
+     *  @param bank the bank that will hold the cpu.
+     *  @param lane the lane where the cpu is stored.
+     *  @param cpu the cpu to be copied.
+     */
+    template<uint32_t LANES>
+    static inline void set_lane(CPUBank<LANES>& bank, uint32_t lane, const CPU& cpu)
+    {
+        for(int i = 0 ; i < 16 ; i++) bank.V[i][lane]     = cpu.V[i];
+        for(int i = 0 ; i < 16 ; i++) bank.stack[i][lane] = cpu.stack[i];
+        for(int i = 0 ; i < 32 ; i++) bank.screen[i][lane] = cpu.screen[i];
+
+        bank.I[lane]            = cpu.I;
+        bank.PC[lane]           = cpu.PC;
+        bank.SP[lane]           = cpu.SP;
+        bank.DT[lane]           = cpu.DT;
+        bank.ST[lane]           = cpu.ST;
+        bank.DT_cycle[lane]     = cpu.DT_cycle;
+        bank.ST_cycle[lane]     = cpu.ST_cycle;
+        bank.key_pad[lane]      = cpu.key_pad;
+        bank.random_state[lane] = cpu.random_state;
+        bank.draw[lane]         = cpu.draw;
+        bank.changed[lane]      = cpu.changed;
+        bank.memory[lane]       = cpu.memory;
+
+        bank.cycles          = cpu.cycles;
+        bank.cycles_per_tick = cpu.cycles_per_tick;
+
+        update_divergent(bank);
+    }
+
+    /**
+     *  Copy the state of a lane into a cpu, so it can keep running on
+     *  its own or be inspected.
+     *
+     *  @param bank the bank that holds the lane.
+     *  @param lane the lane to be copied.
+     *  @param cpu the cpu where the lane is stored, its decoded cache
+     *             is invalidated.
+     */
+    template<uint32_t LANES>
+    static inline void get_lane(const CPUBank<LANES>& bank, uint32_t lane, CPU& cpu)
+    {
+        for(int i = 0 ; i < 16 ; i++) cpu.V[i]      = bank.V[i][lane];
+        for(int i = 0 ; i < 16 ; i++) cpu.stack[i]  = bank.stack[i][lane];
+        for(int i = 0 ; i < 32 ; i++) cpu.screen[i] = bank.screen[i][lane];
+
+        cpu.I               = bank.I[lane];
+        cpu.PC              = bank.PC[lane];
+        cpu.SP              = bank.SP[lane];
+        cpu.DT              = bank.DT[lane];
+        cpu.ST              = bank.ST[lane];
+        cpu.DT_cycle        = bank.DT_cycle[lane];
+        cpu.ST_cycle        = bank.ST_cycle[lane];
+        cpu.key_pad         = bank.key_pad[lane];
+        cpu.random_state    = bank.random_state[lane];
+        cpu.draw            = bank.draw[lane];
+        cpu.changed         = bank.changed[lane];
+        cpu.memory          = bank.memory[lane];
+        cpu.cycles          = bank.cycles;
+        cpu.cycles_per_tick = bank.cycles_per_tick;
+
+        invalidate(cpu, 0x0, cpu.memory.size());
+    }
+
+    /**
+     *  Same as timer_value() for a timer of a lane.
+     */
+    template<uint32_t LANES>
+    static inline uint8_t lane_timer(const CPUBank<LANES>& bank, uint8_t value, uint64_t set_cycle)
+    {
+        const uint64_t ticks = bank.cycles / bank.cycles_per_tick - set_cycle / bank.cycles_per_tick;
+
+        return ticks < value ? value - ticks : 0;
+    }
+
+    /**
+     *  Compute a new value for every lane of a register and keep it only
+     *  on the lanes of a group. The values are computed on a separate
+     *  array so, the loop has no branches and never aliases the bank,
+     *  which is what the compiler needs to turn it into SIMD code.
+     *
+     *  A scalar group only computes the values of its own lanes.
+     *
+     *  @param values the register, one value per lane.
+     *  @param group the lanes that are updated, every lane on WHOLE_BANK.
+     *  @param function callable returning the new value of a lane.
+     */
+    template<GroupWidth WIDTH, typename T, size_t LANES, typename Function>
+    static inline void update_lanes(std::array<T, LANES>& values, LaneMask group, Function function)
+    {
+        if(WIDTH == SCALAR_GROUP)
+        {
+            for(LaneMask m = group ; m != 0 ; m &= m - 1) values[__builtin_ctzll(m)] = function(__builtin_ctzll(m));
+            return;
+        }
+
+        std::array<T, LANES> result;
+
+        for(uint32_t l = 0 ; l < LANES ; l++) result[l] = function(l);
+
+        if(WIDTH == WHOLE_BANK)
+        {
+            values = result;
+            return;
+        }
+
+        for(LaneMask m = group ; m != 0 ; m &= m - 1) values[__builtin_ctzll(m)] = result[__builtin_ctzll(m)];
+    }
+
+    /**
+     *  Draw a sprite on every lane of a group, following op_code_0xD().
+     *  When the sprite has the same position on every lane each row is
+     *  XORed on all of them at once, unless the group is scalar.
+     */
+    template<uint32_t LANES, GroupWidth WIDTH>
+    static inline void draw_lanes(CPUBank<LANES>& bank, const Instruction& instruction, LaneMask group)
+    {
+        auto& VX = bank.V[instruction.X];
+        auto& VY = bank.V[instruction.Y];
+        auto& VF = bank.V[0xF];
+
+        const uint32_t first = __builtin_ctzll(group);
+        const uint8_t  vx    = VX[first] % SCREEN_WIDHT;
+        const uint8_t  vy    = VY[first] % SCREEN_HEIGHT;
+
+        bool same_position = WIDTH != SCALAR_GROUP;
+        for(LaneMask m = same_position ? group : 0 ; m != 0 ; m &= m - 1)
+        {
+            const uint32_t l = __builtin_ctzll(m);
+            same_position &= VX[l] % SCREEN_WIDHT == vx && VY[l] % SCREEN_HEIGHT == vy;
+        }
+
+        if(same_position)
+        {
+            const uint8_t h = std::min<uint8_t>(instruction.N, SCREEN_HEIGHT - vy);
+
+            std::array<uint64_t, LANES> collision{};
+            std::array<uint64_t, LANES> sprite{};
+
+            for(int i = 0 ; i < h ; i++)
+            {
+                std::array<uint64_t, LANES>& row = bank.screen[vy + i];
+
+                // Lanes out of the group draw an empty row.
+                for(LaneMask m = group ; m != 0 ; m &= m - 1)
+                {
+                    const uint32_t l = __builtin_ctzll(m);
+                    sprite[l] = bank.memory[l][(bank.I[l] + i) & 0xFFF];
+                }
+
+                for(uint32_t l = 0 ; l < LANES ; l++)
+                {
+                    const uint64_t bits = (sprite[l] << 56) >> vx;
+
+                    collision[l] |= row[l] & bits;
+                    row[l]       ^= bits;
+                }
+            }
+
+            update_lanes<WIDTH>(VF,        group, [&](uint32_t l) -> uint8_t { return collision[l] != 0x0; });
+            update_lanes<WIDTH>(bank.draw, group, [&](uint32_t)   -> uint8_t { return 0x1; });
+
+            const ScreenRect rect{ vx, vy, static_cast<uint8_t>(std::min<uint16_t>(vx + 8, SCREEN_WIDHT)), static_cast<uint8_t>(vy + h) };
+
+            if(h > 0) for(LaneMask m = group ; m != 0 ; m &= m - 1) merge_rect(bank.changed[__builtin_ctzll(m)], rect);
+
+            return;
+        }
+
+        for(LaneMask m = group ; m != 0 ; m &= m - 1)
+        {
+            const uint32_t l  = __builtin_ctzll(m);
+            const uint8_t  x  = VX[l] % SCREEN_WIDHT;
+            const uint8_t  y  = VY[l] % SCREEN_HEIGHT;
+            const uint8_t  h  = std::min<uint8_t>(instruction.N, SCREEN_HEIGHT - y);
+
+            uint64_t collision = 0x0;
+
+            for(int i = 0 ; i < h ; i++)
+            {
+                const uint64_t bits = (static_cast<uint64_t>(bank.memory[l][(bank.I[l] + i) & 0xFFF]) << 56) >> x;
+                uint64_t&      row  = bank.screen[y + i][l];
+
+                collision |= row & bits;
+                row       ^= bits;
+            }
+
+            VF[l]        = collision != 0x0;
+            bank.draw[l] = 0x1;
+
+            if(h > 0) merge_rect(bank.changed[l], ScreenRect{ x, y, static_cast<uint8_t>(std::min<uint16_t>(x + 8, SCREEN_WIDHT)), static_cast<uint8_t>(y + h) });
+        }
+    }
+
+    /**
+     *  Execute an instruction on a group of lanes, with the same result
+     *  as its handler on each of them. The program counters aren't
+     *  moved to the next instruction.
+     *
+     *  @param bank the bank that holds the lanes.
+     *  @param instruction the instruction every lane of the group runs.
+     *  @param group the lanes that run the instruction, every lane on
+     *               WHOLE_BANK.
+     */
+    template<uint32_t LANES, GroupWidth WIDTH>
+    static inline void execute_lanes(CPUBank<LANES>& bank, const Instruction& instruction, LaneMask group)
+    {
+        using Lane = uint32_t;
+
+        auto& VX = bank.V[instruction.X];
+        auto& VY = bank.V[instruction.Y];
+        auto& VF = bank.V[0xF];
+        auto& V0 = bank.V[0x0];
+        auto& PC = bank.PC;
+        auto& I  = bank.I;
+
+        const uint8_t  X   = instruction.X;
+        const uint8_t  NN  = instruction.NN;
+        const uint16_t NNN = instruction.NNN;
+
+        switch(instruction.handler)
+        {
+        case OP_0xE0:
+            for(int i = 0 ; i < 32 ; i++) update_lanes<WIDTH>(bank.screen[i], group, [](Lane) -> uint64_t { return 0x0; });
+
+            update_lanes<WIDTH>(bank.draw, group, [](Lane) -> uint8_t { return 0x1; });
+
+            for(LaneMask m = group ; m != 0 ; m &= m - 1) merge_rect(bank.changed[__builtin_ctzll(m)], ScreenRect{ 0, 0, SCREEN_WIDHT, SCREEN_HEIGHT });
+            break;
+        case OP_0xEE:
+            for(LaneMask m = group ; m != 0 ; m &= m - 1)
+            {
+                const Lane l = __builtin_ctzll(m);
+
+                bank.SP[l] -= 1;
+                PC[l] = bank.stack[bank.SP[l] & 0xF][l];
+            }
+            break;
+        case OP_0x1:
+            update_lanes<WIDTH>(PC, group, [&](Lane) -> uint16_t { return NNN; });
+            break;
+        case OP_0x2:
+            for(LaneMask m = group ; m != 0 ; m &= m - 1)
+            {
+                const Lane l = __builtin_ctzll(m);
+
+                bank.stack[bank.SP[l] & 0xF][l] = PC[l];
+                PC[l]       = NNN - 2;
+                bank.SP[l] += 1;
+            }
+            break;
+        case OP_0x3:
+            update_lanes<WIDTH>(PC, group, [&](Lane l) -> uint16_t { return PC[l] + 2 * (VX[l] == NN); });
+            break;
+        case OP_0x4:
+            update_lanes<WIDTH>(PC, group, [&](Lane l) -> uint16_t { return PC[l] + 2 * (VX[l] != NN); });
+            break;
+        case OP_0x50:
+            update_lanes<WIDTH>(PC, group, [&](Lane l) -> uint16_t { return PC[l] + 2 * (VX[l] == VY[l]); });
+            break;
+        case OP_0x6:
+            update_lanes<WIDTH>(VX, group, [&](Lane)   -> uint8_t { return NN; });
+            break;
+        case OP_0x7:
+            update_lanes<WIDTH>(VX, group, [&](Lane l) -> uint8_t { return VX[l] + NN; });
+            break;
+        case OP_0x80:
+            update_lanes<WIDTH>(VX, group, [&](Lane l) -> uint8_t { return VY[l]; });
+            break;
+        case OP_0x81:
+            update_lanes<WIDTH>(VX, group, [&](Lane l) -> uint8_t { return VX[l] | VY[l]; });
+            break;
+        case OP_0x82:
+            update_lanes<WIDTH>(VX, group, [&](Lane l) -> uint8_t { return VX[l] & VY[l]; });
+            break;
+        case OP_0x83:
+            update_lanes<WIDTH>(VX, group, [&](Lane l) -> uint8_t { return VX[l] ^ VY[l]; });
+            break;
+        // The flag is written before the result, like the handlers do, so X or Y may be F.
+        case OP_0x84:
+            update_lanes<WIDTH>(VF, group, [&](Lane l) -> uint8_t { return VX[l] + VY[l] > 255U; });
+            update_lanes<WIDTH>(VX, group, [&](Lane l) -> uint8_t { return VX[l] + VY[l]; });
+            break;
+        case OP_0x85:
+            update_lanes<WIDTH>(VF, group, [&](Lane l) -> uint8_t { return VX[l] > VY[l]; });
+            update_lanes<WIDTH>(VX, group, [&](Lane l) -> uint8_t { return VX[l] - VY[l]; });
+            break;
+        case OP_0x86:
+            update_lanes<WIDTH>(VF, group, [&](Lane l) -> uint8_t { return VX[l] & 0x1; });
+            update_lanes<WIDTH>(VX, group, [&](Lane l) -> uint8_t { return VX[l] >> 1; });
+            break;
+        case OP_0x87:
+            update_lanes<WIDTH>(VF, group, [&](Lane l) -> uint8_t { return VY[l] > VX[l]; });
+            update_lanes<WIDTH>(VX, group, [&](Lane l) -> uint8_t { return VY[l] - VX[l]; });
+            break;
+        case OP_0x8E:
+            update_lanes<WIDTH>(VF, group, [&](Lane l) -> uint8_t { return VX[l] >> 7; });
+            update_lanes<WIDTH>(VX, group, [&](Lane l) -> uint8_t { return VX[l] << 1; });
+            break;
+        case OP_0x90:
+            update_lanes<WIDTH>(PC, group, [&](Lane l) -> uint16_t { return PC[l] + 2 * (VX[l] != VY[l]); });
+            break;
+        case OP_0xA:
+            update_lanes<WIDTH>(I,  group, [&](Lane)   -> uint16_t { return NNN; });
+            break;
+        case OP_0xB:
+            update_lanes<WIDTH>(PC, group, [&](Lane l) -> uint16_t { return V0[l] + NNN; });
+            break;
+        case OP_0xC:
+        {
+            const auto next_state = [&](Lane l) -> uint64_t
+            {
+                uint64_t state = bank.random_state[l];
+
+                state ^= state >> 12;
+                state ^= state << 25;
+                state ^= state >> 27;
+
+                return state;
+            };
+
+            update_lanes<WIDTH>(VX,                group, [&](Lane l) -> uint8_t  { return ((next_state(l) * 0x2545F4914F6CDD1DULL) >> 56) & NN; });
+            update_lanes<WIDTH>(bank.random_state, group, next_state);
+            break;
+        }
+        case OP_0xD:
+            draw_lanes<LANES, WIDTH>(bank, instruction, group);
+            break;
+        // Keys past F are never pressed.
+        case OP_0xE9E:
+            update_lanes<WIDTH>(PC, group, [&](Lane l) -> uint16_t { return PC[l] + 2 * (VX[l] < 16 && ((bank.key_pad[l] >> (VX[l] & 0xF)) & 0x1)); });
+            break;
+        case OP_0xEA1:
+            update_lanes<WIDTH>(PC, group, [&](Lane l) -> uint16_t { return PC[l] + 2 * !(VX[l] < 16 && ((bank.key_pad[l] >> (VX[l] & 0xF)) & 0x1)); });
+            break;
+        case OP_0xF07:
+            for(LaneMask m = group ; m != 0 ; m &= m - 1)
+            {
+                const Lane l = __builtin_ctzll(m);
+                VX[l] = lane_timer(bank, bank.DT[l], bank.DT_cycle[l]);
+            }
+            break;
+        case OP_0xF0A:
+            for(LaneMask m = group ; m != 0 ; m &= m - 1)
+            {
+                const Lane l = __builtin_ctzll(m);
+
+                if(bank.key_pad[l] == 0) PC[l] -= 2;
+                else                     VX[l]  = __builtin_ctz(bank.key_pad[l]);
+            }
+            break;
+        case OP_0xF15:
+            update_lanes<WIDTH>(bank.DT,       group, [&](Lane l) -> uint8_t  { return VX[l]; });
+            update_lanes<WIDTH>(bank.DT_cycle, group, [&](Lane)   -> uint64_t { return bank.cycles; });
+            break;
+        case OP_0xF18:
+            update_lanes<WIDTH>(bank.ST,       group, [&](Lane l) -> uint8_t  { return VX[l]; });
+            update_lanes<WIDTH>(bank.ST_cycle, group, [&](Lane)   -> uint64_t { return bank.cycles; });
+            break;
+        case OP_0xF1E:
+            update_lanes<WIDTH>(I, group, [&](Lane l) -> uint16_t { return I[l] + VX[l]; });
+            break;
+        case OP_0xF29:
+            update_lanes<WIDTH>(I, group, [&](Lane)   -> uint16_t { return X * 5; });
+            break;
+        case OP_0xF33:
+            for(LaneMask m = group ; m != 0 ; m &= m - 1)
+            {
+                const Lane    l    = __builtin_ctzll(m);
+                const uint8_t data = VX[l];
+
+                bank.memory[l][(I[l] + 2) & 0xFFF] = data % 10;
+                bank.memory[l][(I[l] + 1) & 0xFFF] = (data / 10) % 10;
+                bank.memory[l][I[l] & 0xFFF]       = data / 100;
+
+                mark_divergent(bank, I[l], 3);
+            }
+            break;
+        case OP_0xF55:
+            for(LaneMask m = group ; m != 0 ; m &= m - 1)
+            {
+                const Lane l = __builtin_ctzll(m);
+
+                for(int i = 0 ; i <= X ; i++) bank.memory[l][(I[l] + i) & 0xFFF] = bank.V[i][l];
+
+                mark_divergent(bank, I[l], X + 1);
+            }
+            break;
+        case OP_0xF65:
+            for(LaneMask m = group ; m != 0 ; m &= m - 1)
+            {
+                const Lane l = __builtin_ctzll(m);
+
+                for(int i = 0 ; i <= X ; i++) bank.V[i][l] = bank.memory[l][(I[l] + i) & 0xFFF];
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    /**
+     *  Execute one instruction on every lane.
+     *
+     *  @param bank the bank that will run the instruction.
+     */
+    template<uint32_t LANES>
+    static inline void step_bank(CPUBank<LANES>& bank)
+    {
+        const uint16_t PC = bank.PC[0];
+
+        uint16_t difference = 0x0;
+        for(uint32_t l = 0 ; l < LANES ; l++) difference |= bank.PC[l] ^ PC;
+
+        // Every lane is at the same instruction and none of them has rewritten it.
+        if(difference == 0x0 && !is_divergent(bank, PC) && !is_divergent(bank, PC + 1))
+        {
+            const uint16_t word = (bank.memory[0][PC & 0xFFF] << 0x8) | bank.memory[0][(PC + 1) & 0xFFF];
+
+            execute_lanes<LANES, WHOLE_BANK>(bank, decode_table()[word], all_lanes<LANES>());
+        }
+        else
+        {
+            const Instruction* table = decode_table();
+
+            std::array<uint16_t, LANES> words;
+
+            for(uint32_t l = 0 ; l < LANES ; l++) words[l] = (bank.memory[l][bank.PC[l] & 0xFFF] << 0x8) | bank.memory[l][(bank.PC[l] + 1) & 0xFFF];
+
+            LaneMask pending = all_lanes<LANES>();
+            bool     split   = false;
+
+            // Finding a group costs a pass over every lane so, after a few groups the lanes left run one by one.
+            for(uint32_t g = 0 ; g < MAX_MASKED_GROUPS && pending != 0 ; g++)
+            {
+                const uint16_t word  = words[__builtin_ctzll(pending)];
+                LaneMask       group = 0;
+
+                for(uint32_t l = 0 ; l < LANES ; l++) group |= LaneMask{words[l] == word} << l;
+
+                group &= pending;
+                split |= group != all_lanes<LANES>();
+
+                if(group == all_lanes<LANES>())                          execute_lanes<LANES, WHOLE_BANK>(bank, table[word], group);
+                else if(__builtin_popcountll(group) <= MAX_SCALAR_GROUP) execute_lanes<LANES, SCALAR_GROUP>(bank, table[word], group);
+                else                                                     execute_lanes<LANES, MASKED_GROUP>(bank, table[word], group);
+
+                pending &= ~group;
+            }
+
+            for(LaneMask m = pending ; m != 0 ; m &= m - 1)
+            {
+                const uint32_t l = __builtin_ctzll(m);
+                execute_lanes<LANES, SCALAR_GROUP>(bank, table[words[l]], LaneMask{1} << l);
+            }
+
+            bank.split_steps += split;
+        }
+
+        for(uint32_t l = 0 ; l < LANES ; l++) bank.PC[l] += 2;
+
+        bank.cycles += 1;
+    }
+
+    /**
+     *  Execute a number of instructions on every lane.
+     *
+     *  @param bank the bank that will run the instructions.
+     *  @param cycles the number of instructions each lane executes.
+     */
+    template<uint32_t LANES>
+    static inline void run_bank(CPUBank<LANES>& bank, uint64_t cycles)
+    {
+        for(uint64_t i = 0 ; i < cycles ; i++) step_bank(bank);
+    }
+}
+
+#endif
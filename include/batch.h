@@ -0,0 +1,174 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <cstdint>
+
+#include "./opcode.h"
+#include "./cpu.h"
+
+namespace chip
+{
+    /**
+     *  Reasons why a batch of instructions stopped running.
+     *
+     *  STOP_BUDGET      every requested instruction has been executed.
+     *  STOP_DRAW        the last instruction executed changed the screen.
+     *  STOP_WAIT_KEY    the program is waiting for a key (FX0A) that is
+     *                   not pressed, so nothing changes until the host
+     *                   updates the key pad.
+     *  STOP_BREAKPOINT  the predicate given to run_until() returned true
+     *                   for the next instruction.
+     *  STOP_FAULT       the observer found that the next instruction
+     *                   can't run, like a call with a full stack.
+     */
+    enum StopReason : uint8_t
+    {
+        STOP_BUDGET,
+        STOP_DRAW,
+        STOP_WAIT_KEY,
+        STOP_BREAKPOINT,
+        STOP_FAULT
+    };
+
+    /**
+     *  Result of running a batch of instructions.
+     */
+    struct RunResult
+    {
+        StopReason reason;
+        uint64_t   cycles; // instructions executed, including the ones spent waiting for a key.
+    };
+
+    /**
+     *  Never stop before an instruction.
+     */
+    struct NoBreakpoint
+    {
+        bool operator()(const CPU&) const { return false; }
+    };
+
+    /**
+     *  Don't look at the instructions executed, every call is inlined
+     *  away.
+     */
+    struct NoObserver
+    {
+        bool operator()(const CPU&, const CachedInstruction&, uint64_t) const { return false; }
+    };
+
+    /**
+     *  Show every instruction to two observers, the second one doesn't
+     *  see an instruction the first one stopped the run before.
+     */
+    template<typename First, typename Second>
+    struct ObserverPair
+    {
+        First  first;
+        Second second;
+
+        bool operator()(const CPU& cpu, const CachedInstruction& instruction, uint64_t count) const
+        {
+            return first(cpu, instruction, count) || second(cpu, instruction, count);
+        }
+    };
+
+    template<typename First, typename Second>
+    static inline ObserverPair<First, Second> observe_both(First first, Second second)
+    {
+        return ObserverPair<First, Second>{ first, second };
+    }
+
+    /**
+     *  Execute instructions until the budget is used, or a stop
+     *  condition is found. The state of the cpu is exactly the same
+     *  as calling cycle() the number of times returned.
+     *
+     *  Waiting for a key with none pressed repeats FX0A until the key
+     *  pad changes so, the rest of the budget is counted at once and
+     *  the loop returns to the host.
+     *
+     *  The predicate is checked before every instruction except the
+     *  first one so, a run stopped by it can be resumed by calling this
+     *  function again.
+     *
+     *  @param cpu the cpu that will run the instructions.
+     *  @param cycles the maximum number of instructions to execute.
+     *  @param stop_on_draw stop after any instruction that draws.
+     *  @param predicate callable taking a const CPU&, true stops the run.
+     *  @param observer callable taking the cpu, the next instruction and
+     *                  the number of times it is about to be executed,
+     *                  true stops the run before the instruction runs.
+     */
+    template<typename Predicate, typename Observer = NoObserver>
+    static inline RunResult run_batch(CPU& cpu, uint64_t cycles, bool stop_on_draw, Predicate predicate, Observer observer = Observer{})
+    {
+        for(uint64_t executed = 0 ; executed < cycles ; executed++)
+        {
+            if(executed > 0 && predicate(static_cast<const CPU&>(cpu))) return RunResult{ STOP_BREAKPOINT, executed };
+
+            const CachedInstruction& instruction = lookup(cpu);
+            const bool               waiting     = instruction.handler == OP_0xF0A && cpu.key_pad == 0;
+
+            if(observer(static_cast<const CPU&>(cpu), instruction, waiting ? cycles - executed : 1)) return RunResult{ STOP_FAULT, executed };
+
+            if(waiting)
+            {
+                cpu.cycles += cycles - executed;
+
+                return RunResult{ STOP_WAIT_KEY, cycles };
+            }
+
+            handlers[instruction.handler](cpu, instruction.op_code);
+
+            cpu.cycles += 1;
+            cpu.PC     += 2;
+
+            if(stop_on_draw && (instruction.handler == OP_0xD || instruction.handler == OP_0xE0))
+            {
+                return RunResult{ STOP_DRAW, executed + 1 };
+            }
+        }
+
+        return RunResult{ STOP_BUDGET, cycles };
+    }
+
+    /**
+     *  Execute a number of instructions without returning to the host
+     *  unless the program waits for a key.
+     *
+     *  @param cpu the cpu that will run the instructions.
+     *  @param cycles the number of instructions to execute.
+     */
+    static inline RunResult run_cycles(CPU& cpu, uint64_t cycles)
+    {
+        return run_batch(cpu, cycles, false, NoBreakpoint{});
+    }
+
+    /**
+     *  Execute the instructions of a frame, stopping early when the
+     *  screen changes so the host can present it.
+     *
+     *  @param cpu the cpu that will run the instructions.
+     *  @param cycles_per_frame the number of instructions of a frame.
+     */
+    static inline RunResult run_frame(CPU& cpu, uint64_t cycles_per_frame)
+    {
+        return run_batch(cpu, cycles_per_frame, true, NoBreakpoint{});
+    }
+
+    /**
+     *  Execute instructions until the predicate returns true for the
+     *  next one, or the budget is used.
+     *
+     *  @param cpu the cpu that will run the instructions.
+     *  @param cycles the maximum number of instructions to execute.
+     *  @param predicate callable taking a const CPU&, true stops the run.
+     */
+    template<typename Predicate>
+    static inline RunResult run_until(CPU& cpu, uint64_t cycles, Predicate predicate)
+    {
+        return run_batch(cpu, cycles, false, predicate);
+    }
+}
+
+#endif
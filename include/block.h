@@ -0,0 +1,466 @@
+#ifndef BLOCK_H
+#define BLOCK_H
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "./opcode.h"
+#include "./cpu.h"
+
+namespace chip
+{
+    /**
+     *  On this file we present a backend that, instead of executing
+     *  one instruction at a time, translates basic blocks of Chip-8
+     *  instructions into an array of micro operations and executes
+     *  the whole block at once.
+     *
+     *  A basic block starts at any address reached by the program and
+     *  ends at the first instruction that can change the flow of the
+     *  program (jumps, calls, returns, skips and FX0A) or that writes
+     *  memory (FX33 and FX55) because, it could overwrite the block itself.
+     *
+     *  The state of the cpu after running a block is exactly the same
+     *  as running cycle() once per instruction of the block.
+     */
+
+    /**
+     *  Blocks without a control flow instruction are split after
+     *  this amount of instructions.
+     */
+    const uint16_t MAX_BLOCK_SIZE = 64;
+
+    /**
+     *  Once this amount of micro operations is translated, the whole
+     *  cache is flushed so, the memory used by dropped blocks is reused.
+     */
+    const uint32_t MAX_CACHED_OPS = 0x10000;
+
+    /**
+     *  Kinds of micro operations.
+     *
+     *  EXECUTE           calls the handler of an instruction that neither
+     *                    reads PC nor the timers.
+     *  SET_REGISTER      6XNN executed inline, VX is set to NN.
+     *  ADD_REGISTER      7XNN executed inline, NN is added to VX.
+     *  SET_INDEX         ANNN executed inline, I is set to NNN.
+     *  EXECUTE_TIMER     calls the handler of FX07, FX15 or FX18 after
+     *                    bringing the cycle counter up to date.
+     *  EXECUTE_BRANCH    calls the handler of the instruction that ends
+     *                    the block with PC pointing to it.
+     *  SET_DELAY_TIMER   fused 6XNN + FX15, the delay timer is set to NN.
+     *  WAIT_DELAY_TIMER  fused FX07 + 3XNN + 1NNN loop that waits until
+     *                    the delay timer reaches NN.
+     */
+    enum MicroOpKind : uint8_t
+    {
+        EXECUTE,
+        SET_REGISTER,
+        ADD_REGISTER,
+        SET_INDEX,
+        EXECUTE_TIMER,
+        EXECUTE_BRANCH,
+        SET_DELAY_TIMER,
+        WAIT_DELAY_TIMER
+    };
+
+    struct MicroOp
+    {
+        Handler     handler;
+        OpCode      op_code;
+        uint16_t    address; // address of the first instruction of the micro operation.
+        MicroOpKind kind;
+        uint8_t     X;
+        uint8_t     NN;
+    };
+
+    /**
+     *  A translated block covers the memory range [start, end) and
+     *  its micro operations are stored on the ops pool of the cache.
+     */
+    struct Block
+    {
+        uint16_t start;
+        uint16_t end;
+        uint32_t first_op;
+        uint16_t size;   // number of micro operations.
+        uint16_t cycles; // number of instructions executed by one run of the block.
+    };
+
+    /**
+     *  Translated blocks indexed by their start address. An index
+     *  of zero means that there is no block starting at the address,
+     *  otherwise, the block is stored at blocks[index - 1].
+     */
+    struct BlockCache
+    {
+        BlockCache() : index{}, blocks{}, ops{} {}
+        std::array<uint16_t, 4096> index;
+        std::vector<Block>   blocks;
+        std::vector<MicroOp> ops;
+    };
+
+    /**
+     *  Check if the instruction can change the PC register so, it
+     *  has to be the last one of a block.
+     *
+     *  @param handler the index of the handler of the instruction.
+     */
+    static inline bool is_branch(uint8_t handler)
+    {
+        switch (handler)
+        {
+        case OP_0xEE:
+        case OP_0x1:
+        case OP_0x2:
+        case OP_0x3:
+        case OP_0x4:
+        case OP_0x50:
+        case OP_0x90:
+        case OP_0xB:
+        case OP_0xE9E:
+        case OP_0xEA1:
+        case OP_0xF0A:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    /**
+     *  Check if the instruction writes memory so, it has to be the
+     *  last one of a block.
+     *
+     *  @param handler the index of the handler of the instruction.
+     */
+    static inline bool is_memory_write(uint8_t handler)
+    {
+        return handler == OP_0xF33 || handler == OP_0xF55;
+    }
+
+    /**
+     *  Check if the instruction reads or writes the timers.
+     *
+     *  @param handler the index of the handler of the instruction.
+     */
+    static inline bool is_timer_access(uint8_t handler)
+    {
+        return handler == OP_0xF07 || handler == OP_0xF15 || handler == OP_0xF18;
+    }
+
+    /**
+     *  Run one basic block on the interpreter, it is used by the 
+     *  backends that translate code for the blocks they have not 
+     *  translated.
+     *
+     *  @param cpu the cpu that will run the block.
+     *  @param cycles the maximum number of instructions to execute.
+     *
+     *  @return the number of instructions executed.
+     */
+    static inline uint32_t interpret_block(CPU& cpu, uint64_t cycles)
+    {
+        uint32_t executed = 0;
+
+        while(executed < cycles && executed < MAX_BLOCK_SIZE)
+        {
+            const uint8_t handler = lookup(cpu).handler;
+
+            cycle(cpu);
+            executed++;
+
+            if(is_branch(handler) || is_memory_write(handler)) break;
+        }
+
+        return executed;
+    }
+
+    /**
+     *  Drop every block that overlaps the memory written since the
+     *  last time the cache was checked.
+     *
+     *  @param cache the cache whose stale blocks will be dropped.
+     *  @param cpu the cpu whose memory has been written.
+     */
+    static inline void invalidate_blocks(BlockCache& cache, CPU& cpu)
+    {
+        for(uint32_t i = 0 ; i < cache.blocks.size() ; i++)
+        {
+            const Block& block = cache.blocks[i];
+
+            if(cache.index[block.start] == i + 1 && block.start < cpu.dirty_end && cpu.dirty_begin < block.end)
+                cache.index[block.start] = 0;
+        }
+
+        clear_dirty(cpu);
+    }
+
+    /**
+     *  Drop every block of the cache.
+     *
+     *  @param cache the cache that will be emptied.
+     */
+    static inline void flush_blocks(BlockCache& cache)
+    {
+        cache.index.fill(0);
+        cache.blocks.clear();
+        cache.ops.clear();
+    }
+
+    /**
+     *  Translate the basic block that starts at an address into micro
+     *  operations, fusing the sequences of instructions that have a
+     *  superinstruction.
+     *
+     *  @param cache the cache where the block will be stored.
+     *  @param cpu the cpu whose memory holds the program.
+     *  @param start the address of the first instruction of the block.
+     *
+     *  @return the translated block.
+     */
+    static inline const Block& translate(BlockCache& cache, const CPU& cpu, uint16_t start)
+    {
+        if(cache.ops.size() >= MAX_CACHED_OPS || cache.blocks.size() >= 0xFFFF) flush_blocks(cache);
+
+        Block block{ start, start, static_cast<uint32_t>(cache.ops.size()), 0, 0 };
+
+        uint16_t address = start;
+
+        while(block.cycles < MAX_BLOCK_SIZE && static_cast<size_t>(address) + 1 < cpu.memory.size())
+        {
+            const Instruction& instruction = predecode(cpu.memory, address);
+            MicroOp op{ handlers[instruction.handler], instruction.op_code, address, EXECUTE, instruction.X, instruction.NN };
+            uint16_t length = 1;
+
+            const bool has_next  = static_cast<size_t>(address) + 3 < cpu.memory.size();
+            const bool has_third = static_cast<size_t>(address) + 5 < cpu.memory.size();
+
+            if(instruction.handler == OP_0x6 && has_next)
+            {
+                const Instruction& next = predecode(cpu.memory, address + 2);
+
+                if(next.handler == OP_0xF15 && next.X == instruction.X)
+                {
+                    op.kind = SET_DELAY_TIMER;
+                    length  = 2;
+                }
+            }
+            else if(instruction.handler == OP_0xF07 && has_third)
+            {
+                const Instruction& skip = predecode(cpu.memory, address + 2);
+                const Instruction& jump = predecode(cpu.memory, address + 4);
+
+                // cycle() adds two to PC after 1NNN so, the loop jumps to NNN + 2.
+                if(skip.handler == OP_0x3 && skip.X == instruction.X && jump.handler == OP_0x1 && jump.NNN + 2 == address)
+                {
+                    op.kind = WAIT_DELAY_TIMER;
+                    op.NN   = skip.NN;
+                    length  = 3;
+                }
+            }
+
+            if(op.kind == EXECUTE)
+            {
+                if(is_branch(instruction.handler)) op.kind = EXECUTE_BRANCH;
+                else if(is_timer_access(instruction.handler)) op.kind = EXECUTE_TIMER;
+                else if(instruction.handler == OP_0x6) op.kind = SET_REGISTER;
+                else if(instruction.handler == OP_0x7) op.kind = ADD_REGISTER;
+                else if(instruction.handler == OP_0xA) op.kind = SET_INDEX;
+            }
+
+            cache.ops.push_back(op);
+            block.size   += 1;
+            block.cycles += length;
+            address      += 2 * length;
+
+            if(op.kind == EXECUTE_BRANCH || op.kind == WAIT_DELAY_TIMER || is_memory_write(instruction.handler)) break;
+        }
+
+        block.end = address;
+        cache.blocks.push_back(block);
+        cache.index[start] = cache.blocks.size();
+
+        return cache.blocks.back();
+    }
+
+    /**
+     *  Count the instructions executed since the last update so, the
+     *  timers read the same value they would read under cycle().
+     *
+     *  @param cpu the cpu whose cycle counter will be updated.
+     *  @param pending the number of instructions executed since the last update.
+     */
+    static inline void add_cycles(CPU& cpu, uint32_t& pending)
+    {
+        cpu.cycles += pending;
+        pending = 0;
+    }
+
+    /**
+     *  Number of iterations of a WAIT_DELAY_TIMER loop, starting on
+     *  the current cycle, that read a delay timer greater than NN.
+     *
+     *  @param cpu the cpu running the loop.
+     *  @param NN the value the loop waits for.
+     */
+    static inline uint64_t delay_timer_wait(const CPU& cpu, uint8_t NN)
+    {
+        if(delay_timer(cpu) <= NN) return 0;
+
+        const uint64_t target = (cpu.DT_cycle / cpu.cycles_per_tick + cpu.DT - NN) * cpu.cycles_per_tick;
+
+        return (target - cpu.cycles + 2) / 3;
+    }
+
+    /**
+     *  Run the block that starts at PC, translating it first if it
+     *  is not on the cache.
+     *
+     *  @param cache the cache of translated blocks.
+     *  @param cpu the cpu that will run the block.
+     *  @param budget maximum number of instructions spent waiting on
+     *                the delay timer by a WAIT_DELAY_TIMER loop.
+     *
+     *  @return the number of instructions executed.
+     */
+    static inline uint32_t run_block(BlockCache& cache, CPU& cpu, uint32_t budget)
+    {
+        if(is_dirty(cpu)) invalidate_blocks(cache, cpu);
+
+        if(static_cast<size_t>(cpu.PC) + 1 >= cpu.memory.size())
+        {
+            cycle(cpu);
+            return 1;
+        }
+
+        const uint16_t index = cache.index[cpu.PC];
+        const Block&   block = index != 0 ? cache.blocks[index - 1] : translate(cache, cpu, cpu.PC);
+        const MicroOp* ops   = &cache.ops[block.first_op];
+
+        uint32_t pending  = 0;
+        uint32_t executed = block.cycles;
+
+        cpu.PC = block.end;
+
+        for(uint16_t i = 0 ; i < block.size ; i++)
+        {
+            const MicroOp& op = ops[i];
+
+            switch (op.kind)
+            {
+            case EXECUTE:
+                op.handler(cpu, op.op_code);
+                pending += 1;
+                break;
+            case SET_REGISTER:
+                cpu.V[op.X] = op.NN;
+                pending += 1;
+                break;
+            case ADD_REGISTER:
+                cpu.V[op.X] += op.NN;
+                pending += 1;
+                break;
+            case SET_INDEX:
+                cpu.I = op.op_code.data;
+                pending += 1;
+                break;
+            case EXECUTE_TIMER:
+                add_cycles(cpu, pending);
+                op.handler(cpu, op.op_code);
+                pending += 1;
+                break;
+            case EXECUTE_BRANCH:
+                cpu.PC = op.address;
+                op.handler(cpu, op.op_code);
+                cpu.PC += 2;
+                pending += 1;
+                break;
+            case SET_DELAY_TIMER:
+                cpu.V[op.X] = op.NN;
+                pending += 1;
+                add_cycles(cpu, pending);
+                set_delay_timer(cpu, op.NN);
+                pending += 1;
+                break;
+            case WAIT_DELAY_TIMER:
+                executed -= 3;
+                cpu.PC = op.address;
+
+                add_cycles(cpu, pending);
+
+                for(;;)
+                {
+                    cpu.V[op.X] = delay_timer(cpu);
+
+                    if(cpu.V[op.X] == op.NN)
+                    {
+                        cpu.PC     += 6;
+                        cpu.cycles += 2;
+                        executed   += 2;
+                        break;
+                    }
+
+                    cpu.cycles += 3;
+                    executed   += 3;
+
+                    if(executed + 3 > budget) break;
+
+                    // Iterations that read a value above NN again can be skipped at once.
+                    const uint64_t skipped = std::min<uint64_t>(delay_timer_wait(cpu, op.NN), (budget - executed) / 3 - 1);
+
+                    cpu.cycles += skipped * 3;
+                    executed   += skipped * 3;
+                }
+                break;
+            }
+        }
+
+        add_cycles(cpu, pending);
+
+        return executed;
+    }
+
+    /**
+     *  Run blocks until the given amount of instructions have been
+     *  executed. Blocks are never split so, once a block doesn't fit
+     *  on the instructions left they are interpreted instead.
+     *
+     *  @param cache the cache of translated blocks.
+     *  @param cpu the cpu that will run the blocks.
+     *  @param cycles the number of instructions to execute.
+     *
+     *  @return the number of instructions executed, always cycles.
+     */
+    static inline uint64_t run_blocks(BlockCache& cache, CPU& cpu, uint64_t cycles)
+    {
+        uint64_t executed = 0;
+
+        while(executed < cycles)
+        {
+            const uint64_t left = cycles - executed;
+
+            // A block takes up to three instructions more than MAX_BLOCK_SIZE.
+            if(left < MAX_BLOCK_SIZE + 3 && static_cast<size_t>(cpu.PC) + 1 < cpu.memory.size())
+            {
+                if(is_dirty(cpu)) invalidate_blocks(cache, cpu);
+
+                const uint16_t index = cache.index[cpu.PC];
+                const Block&   block = index != 0 ? cache.blocks[index - 1] : translate(cache, cpu, cpu.PC);
+
+                if(block.cycles > left)
+                {
+                    executed += interpret_block(cpu, left);
+                    continue;
+                }
+            }
+
+            executed += run_block(cache, cpu, left < 0xFFFFFFFF ? left : 0xFFFFFFFF);
+        }
+
+        return executed;
+    }
+}
+
+#endif
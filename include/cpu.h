@@ -3,13 +3,12 @@
 
 #include <tuple>
 #include <array>
-#include <time.h>
+#include <algorithm>
+#include <memory>
 #include <string>
 #include <fstream>
 #include <cstdint>
 #include <stdlib.h>
-#include <functional>
-#include <unordered_map>
 
 #include "./opcode.h"
 
@@ -20,8 +19,52 @@ namespace chip
      */ 
     const uint16_t ROM_START = 0x200;
 
+    /**
+     *  Region of the screen made by the columns [left, right) and 
+     *  the rows [top, bottom).
+     */ 
+    struct ScreenRect
+    {
+        uint8_t left;
+        uint8_t top;
+        uint8_t right;
+        uint8_t bottom;
+    };
+
+    /**
+     *  The delay and sound timers count down at 60 Hz.
+     */ 
+    const uint32_t TIMER_RATE = 60;
+
+    /**
+     *  State of the random number generator of a cpu that hasn't been
+     *  seeded, so every run of a program is reproducible by default.
+     */ 
+    const uint64_t DEFAULT_RANDOM_STATE = 0x853C49E6748FEA9BULL;
+
     const uint16_t SCREEN_WIDHT  = 64;
     const uint16_t SCREEN_HEIGHT = 32;
+
+    const ScreenRect EMPTY_RECT{ SCREEN_WIDHT, SCREEN_HEIGHT, 0, 0 };
+
+    static inline bool is_empty(const ScreenRect& rect)
+    {
+        return rect.left >= rect.right || rect.top >= rect.bottom;
+    }
+
+    /**
+     *  Grow a region of the screen until it also covers another one.
+     * 
+     *  @param rect the region that will grow.
+     *  @param other the region to be covered.
+     */ 
+    static inline void merge_rect(ScreenRect& rect, const ScreenRect& other)
+    {
+        rect.left   = std::min(rect.left,   other.left);
+        rect.top    = std::min(rect.top,    other.top);
+        rect.right  = std::max(rect.right,  other.right);
+        rect.bottom = std::max(rect.bottom, other.bottom);
+    }
     
     /**
      *  Chip-8 has a font set which can be used to 
@@ -49,6 +92,22 @@ namespace chip
         0xF0, 0x80, 0xF0, 0x80, 0x80  // 0xF
     }};
 
+    /**
+     *  Marks a slot of the predecoded instruction cache that has
+     *  to be decoded again before being executed.
+     */ 
+    const uint8_t NOT_DECODED = 0xFF;
+
+    /**
+     *  A slot of the predecoded instruction cache: the OpCode that 
+     *  starts at an address and the index of its handler.
+     */ 
+    struct CachedInstruction
+    {
+        OpCode  op_code;
+        uint8_t handler;
+    };
+
     /**
      *  Representation of the Chip-8 CPU and memory. Chip-8 has
      *  16 general purpose registers but, the VF register can't 
@@ -68,23 +127,240 @@ namespace chip
      * 
      *  Finally, although screen and memory are not part of the
      *  CPU perse we are putting it on the struct for convenience. 
+     * 
+     *  Every address of memory has a slot on the decoded cache so,
+     *  instructions are decoded only the first time they are executed.
+     *  Because of that, any write to memory after the program started
+     *  running must be followed by a call to invalidate().
      */ 
     struct CPU
     {
-        CPU() : draw{false}, DT{0}, ST{0}, SP{0}, PC{0x200},I{0}, key_pad{}, V{}, memory{}, screen{}, stack{} {}
+        CPU() : draw{false}, DT{0}, ST{0}, SP{0}, PC{0x200},I{0}, key_pad{}, V{}, memory{}, screen{}, stack{}, dirty_begin{0xFFFF}, dirty_end{0x0},
+                written_pages{~0x0ULL}, cycles{0}, DT_cycle{0}, ST_cycle{0}, cycles_per_tick{1}, random_state{DEFAULT_RANDOM_STATE},
+                changed(EMPTY_RECT)
+        {
+            decoded.fill(CachedInstruction{ OpCode{ 0x0, 0x0 }, NOT_DECODED });
+        }
         bool     draw;
-        uint8_t  DT; // Delay Time register.
-        uint8_t  ST; // Sound Time register.    
+        uint8_t  DT; // Delay Time register, value it had at DT_cycle.
+        uint8_t  ST; // Sound Time register, value it had at ST_cycle.
         uint8_t  SP; // Stack Pointer.
         uint16_t PC; // Program Counter.
         uint16_t I;  // Special register I.
         uint16_t key_pad; // The key pad of a Chip-8 has 16 keys that can be encoded on a unsigned short.
         std::array<uint8_t, 16> V; // General purpose registers (Vx).
         std::array<uint8_t, 4096> memory; // memory of the program.
-        std::array<uint8_t, 64 * 32> screen; // Chip-8 expects a screen of 64 by 32 pixels.
+        std::array<uint64_t, 32> screen; // Chip-8 expects a screen of 64 by 32 pixels, one row per word with x = 0 on the highest bit.
         std::array<uint16_t,16> stack; // stack for function call.
+        std::array<CachedInstruction, 4096> decoded; // predecoded instruction starting at every address.
+        uint16_t dirty_begin; // First address written since the last clear_dirty().
+        uint16_t dirty_end;   // One past the last address written since the last clear_dirty().
+        uint64_t written_pages; // Pages of 64 bytes of memory written since the rewind history last looked, one bit each.
+        uint64_t cycles;   // Instructions executed so far.
+        uint64_t DT_cycle; // Value of cycles when DT was set.
+        uint64_t ST_cycle; // Value of cycles when ST was set.
+        uint32_t cycles_per_tick; // Instructions executed on every tick of the timers.
+        uint64_t random_state; // State of the xorshift generator used by CXNN, never zero.
+        ScreenRect changed; // Pixels that may have changed since the last clear_changed().
     };
 
+    /**
+     *  Drop the predecoded instructions that overlap a range of memory
+     *  that has been written. An instruction takes two bytes so, the 
+     *  one starting right before the range is dropped too.
+     * 
+     *  The range is also merged into the dirty range of the cpu so, 
+     *  other caches of translated code can drop their stale entries,
+     *  and its pages are marked as written for the rewind history.
+     * 
+     *  @param cpu the cpu whose decoded cache will be invalidated.
+     *  @param address the first address that has been written.
+     *  @param size the number of bytes written.
+     */ 
+    static inline void invalidate(CPU& cpu, uint16_t address, uint16_t size)
+    {
+        const uint32_t first = address > 0 ? address - 1 : 0;
+        const uint32_t last  = std::min<uint32_t>(address + size, cpu.decoded.size());
+
+        for(uint32_t i = first ; i < last ; i++) cpu.decoded[i].handler = NOT_DECODED;
+
+        // The instruction at the last address wraps around to the first one.
+        if(address == 0) cpu.decoded[cpu.decoded.size() - 1].handler = NOT_DECODED;
+
+        cpu.dirty_begin = std::min<uint32_t>(cpu.dirty_begin, first);
+        cpu.dirty_end   = std::max<uint32_t>(cpu.dirty_end, last);
+
+        // Pages written, wrapping around the end of memory.
+        const uint32_t first_page = (address & 0xFFF) >> 6;
+        const uint32_t pages      = ((address & 0x3F) + size + 0x3F) >> 6;
+        const uint64_t mask       = pages >= 64 ? ~0x0ULL : (0x1ULL << pages) - 1;
+
+        cpu.written_pages |= (mask << first_page) | (first_page > 0 ? mask >> (64 - first_page) : 0x0);
+    }
+
+    /**
+     *  Check if memory has been written since the last clear_dirty().
+     * 
+     *  @param cpu the cpu whose memory will be checked.
+     */ 
+    static inline bool is_dirty(const CPU& cpu)
+    {
+        return cpu.dirty_begin < cpu.dirty_end;
+    }
+
+    /**
+     *  Forget the range of memory written so far.
+     * 
+     *  @param cpu the cpu whose dirty range will be cleared.
+     */ 
+    static inline void clear_dirty(CPU& cpu)
+    {
+        cpu.dirty_begin = 0xFFFF;
+        cpu.dirty_end   = 0x0;
+    }
+
+    /**
+     *  Value of a timer that was set to value when the cycle counter
+     *  was set_cycle. Timers tick every cycles_per_tick instructions
+     *  so, they are only computed when the program reads them.
+     * 
+     *  @param cpu the cpu that owns the timer.
+     *  @param value the value the timer was set to.
+     *  @param set_cycle the value of the cycle counter when it was set.
+     */ 
+    static inline uint8_t timer_value(const CPU& cpu, uint8_t value, uint64_t set_cycle)
+    {
+        const uint64_t ticks = cpu.cycles / cpu.cycles_per_tick - set_cycle / cpu.cycles_per_tick;
+
+        return ticks < value ? value - ticks : 0;
+    }
+
+    static inline uint8_t delay_timer(const CPU& cpu)
+    {
+        return timer_value(cpu, cpu.DT, cpu.DT_cycle);
+    }
+
+    static inline uint8_t sound_timer(const CPU& cpu)
+    {
+        return timer_value(cpu, cpu.ST, cpu.ST_cycle);
+    }
+
+    static inline void set_delay_timer(CPU& cpu, uint8_t value)
+    {
+        cpu.DT       = value;
+        cpu.DT_cycle = cpu.cycles;
+    }
+
+    static inline void set_sound_timer(CPU& cpu, uint8_t value)
+    {
+        cpu.ST       = value;
+        cpu.ST_cycle = cpu.cycles;
+    }
+
+    /**
+     *  Set how many instructions per second the cpu runs. The timers
+     *  keep their current values and tick at 60 Hz of that clock. By
+     *  default they tick after every instruction.
+     * 
+     *  @param cpu the cpu whose clock will be set.
+     *  @param hz the number of instructions per second.
+     */ 
+    static inline void set_clock_rate(CPU& cpu, uint32_t hz)
+    {
+        const uint8_t DT = delay_timer(cpu);
+        const uint8_t ST = sound_timer(cpu);
+
+        cpu.cycles_per_tick = std::max<uint32_t>(hz / TIMER_RATE, 1);
+
+        set_delay_timer(cpu, DT);
+        set_sound_timer(cpu, ST);
+    }
+
+    /**
+     *  Seed the random number generator of a cpu. The seed is mixed
+     *  with splitmix64 so, close seeds give unrelated sequences.
+     * 
+     *  @param cpu the cpu whose generator will be seeded.
+     *  @param seed any value, the same seed gives the same sequence.
+     */ 
+    static inline void seed_random(CPU& cpu, uint64_t seed)
+    {
+        uint64_t state = seed + 0x9E3779B97F4A7C15ULL;
+
+        state = (state ^ (state >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        state = (state ^ (state >> 27)) * 0x94D049BB133111EBULL;
+        state = state ^ (state >> 31);
+
+        cpu.random_state = state != 0 ? state : DEFAULT_RANDOM_STATE;
+    }
+
+    /**
+     *  Next byte of the xorshift64* generator of a cpu.
+     * 
+     *  @param cpu the cpu whose generator will be advanced.
+     */ 
+    static inline uint8_t next_random(CPU& cpu)
+    {
+        uint64_t state = cpu.random_state;
+
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+
+        cpu.random_state = state;
+
+        return (state * 0x2545F4914F6CDD1DULL) >> 56;
+    }
+
+    /**
+     *  Check if a pixel of the screen is on.
+     * 
+     *  @param screen the rows of the screen.
+     *  @param x the column of the pixel, from 0 to 63.
+     *  @param y the row of the pixel, from 0 to 31.
+     */ 
+    static inline bool get_pixel(const std::array<uint64_t, 32>& screen, uint8_t x, uint8_t y)
+    {
+        return (screen[y] >> (SCREEN_WIDHT - 1 - x)) & 0x1;
+    }
+
+    static inline bool get_pixel(const CPU& cpu, uint8_t x, uint8_t y)
+    {
+        return get_pixel(cpu.screen, x, y);
+    }
+
+    /**
+     *  Merge a region of the screen into the pixels that changed since
+     *  the last clear_changed().
+     * 
+     *  @param cpu the cpu that holds the screen.
+     *  @param rect the region of the screen that changed.
+     */ 
+    static inline void mark_changed(CPU& cpu, const ScreenRect& rect)
+    {
+        merge_rect(cpu.changed, rect);
+    }
+
+    /**
+     *  Check if any pixel changed since the last clear_changed().
+     * 
+     *  @param cpu the cpu that holds the screen.
+     */ 
+    static inline bool has_changed(const CPU& cpu)
+    {
+        return !is_empty(cpu.changed);
+    }
+
+    /**
+     *  Forget the pixels changed so far, usually after presenting them.
+     * 
+     *  @param cpu the cpu that holds the screen.
+     */ 
+    static inline void clear_changed(CPU& cpu)
+    {
+        cpu.changed = EMPTY_RECT;
+    }
+
     /**
      * Load the character font set into memory.
      * 
@@ -93,6 +369,8 @@ namespace chip
     static inline void load_font_set(CPU& cpu)
     {
         for(int i = 0 ; i < font_set.size() ; i++) cpu.memory[i] = font_set[i];
+
+        invalidate(cpu, 0x0, font_set.size());
     }
 
     /**
@@ -111,7 +389,9 @@ namespace chip
     static inline void op_code_0xE0(CPU& cpu, const OpCode& op_code)
     { 
         cpu.draw = true;  
-        for(int i = 0 ; i < cpu.screen.size() ; i++) cpu.screen[i] = 0;
+        cpu.screen.fill(0x0);
+
+        mark_changed(cpu, ScreenRect{ 0, 0, SCREEN_WIDHT, SCREEN_HEIGHT });
     }
 
     /**
@@ -416,8 +696,7 @@ namespace chip
      */ 
     static inline void op_code_0xC(CPU& cpu, const OpCode& op_code)
     {
-        srand (time(NULL));
-        cpu.V[(op_code.data & 0xF00) >> 8] = (rand() % (0xFF + 1)) & (op_code.data & 0xFF);
+        cpu.V[(op_code.data & 0xF00) >> 8] = next_random(cpu) & (op_code.data & 0xFF);
     }
 
     /**
@@ -426,31 +705,38 @@ namespace chip
      *  read as bit-coded starting from memory location I; I value 
      *  doesn’t change after the execution of this instruction
      * 
+     *  The coordinate wraps around the screen but, the pixels of the
+     *  sprite that fall outside of it are clipped. Each row is shifted
+     *  into place and XORed with a whole row of the screen at once. The
+     *  rows and columns covered by the sprite are marked as changed.
+     * 
      *  @param cpu the cpu that contains the registers used by the operation.
      *  @param op_code contains the id of the registers that will be used.
      */ 
     static inline void op_code_0xD(CPU& cpu, const OpCode& op_code)
     {
-        const uint8_t vx = cpu.V[(op_code.data & 0xF00) >> 8] % 64;
-        const uint8_t vy = cpu.V[(op_code.data & 0xF0)  >> 4] % 32;
-        const uint8_t h  = op_code.data & 0xF;
+        const uint8_t vx = cpu.V[(op_code.data & 0xF00) >> 8] % SCREEN_WIDHT;
+        const uint8_t vy = cpu.V[(op_code.data & 0xF0)  >> 4] % SCREEN_HEIGHT;
+        const uint8_t h  = std::min<uint8_t>(op_code.data & 0xF, SCREEN_HEIGHT - vy);
+
+        uint64_t collision = 0x0;
 
-        cpu.V[0xF] = 0x0;
-        cpu.draw = true;  
-        
         for(int i = 0 ; i < h ; i++)
         {
-            uint8_t row = cpu.memory[cpu.I + i];
+            const uint64_t sprite = (static_cast<uint64_t>(cpu.memory[(cpu.I + i) & 0xFFF]) << 56) >> vx;
+            uint64_t&      row    = cpu.screen[vy + i];
 
-            for(int j = 0 ; j < 8 ; j++)
-            {
-                if((row & (0x80 >> j)) != 0x0)
-                {
-                    if(cpu.screen[j + vx + ((i + vy) * 64)] == 0x1) cpu.V[0xF] = 0x1;
-                    cpu.screen[j + vx + ((i + vy) * 64)] ^= 0x1;
-                }            
-            }
+            collision |= row & sprite;
+            row       ^= sprite;
         }
+
+        cpu.V[0xF] = collision != 0x0;
+        cpu.draw = true;
+
+        const uint8_t right  = std::min<uint16_t>(vx + 8, SCREEN_WIDHT);
+        const uint8_t bottom = vy + h;
+
+        if(h > 0) mark_changed(cpu, ScreenRect{ vx, vy, right, bottom });
     }
 
      /**
@@ -483,7 +769,7 @@ namespace chip
      */ 
     static inline void op_code_0xF07(CPU& cpu, const OpCode& op_code)
     {
-        cpu.V[op_code.data] = cpu.DT;
+        cpu.V[op_code.data] = delay_timer(cpu);
     }
 
     /**
@@ -515,7 +801,7 @@ namespace chip
      */ 
     static inline void op_code_0xF15(CPU& cpu, const OpCode& op_code)
     {
-        cpu.DT = cpu.V[op_code.data];
+        set_delay_timer(cpu, cpu.V[op_code.data]);
     }
 
     /**
@@ -526,7 +812,7 @@ namespace chip
      */ 
     static inline void op_code_0xF18(CPU& cpu, const OpCode& op_code)
     {
-        cpu.ST = cpu.V[op_code.data];
+        set_sound_timer(cpu, cpu.V[op_code.data]);
     }
 
     /**
@@ -574,6 +860,8 @@ namespace chip
 
         data /= 10;
         cpu.memory[cpu.I] = data % 10;
+
+        invalidate(cpu, cpu.I, 3);
     }
 
     /**
@@ -585,6 +873,8 @@ namespace chip
     static inline void op_code_0xF55(CPU& cpu, const OpCode& op_code)
     {
         for(int i = 0; i <= op_code.data; i++) cpu.memory[cpu.I + i] = cpu.V[i];
+
+        invalidate(cpu, cpu.I, op_code.data + 1);
     }
 
     /**
@@ -616,6 +906,8 @@ namespace chip
 
         for(int i = 0 ; i < rom_size ; i++) cpu.memory[ROM_START + i] = static_cast<uint8_t>(file_data[i]);
 
+        invalidate(cpu, ROM_START, rom_size);
+
         delete[] file_data;
     }
 
@@ -681,64 +973,313 @@ namespace chip
         return OpCode{ code , data };  
     }
 
-    const std::unordered_map<uint16_t, std::function<void (CPU& cpu, const OpCode& op_code)>> op_codes 
-    {
-        { 0xE0,  op_code_0xE0 },
-        { 0xEE,  op_code_0xEE },
-        { 0x0 ,  op_code_0x0  }, 
-        { 0x1,   op_code_0x1  }, 
-        { 0x2,   op_code_0x2  }, 
-        { 0x3,   op_code_0x3  }, 
-        { 0x4,   op_code_0x4  }, 
-        { 0x50,  op_code_0x50 }, 
-        { 0x6,   op_code_0x6  }, 
-        { 0x7,   op_code_0x7  }, 
-        { 0x80,  op_code_0x80 }, 
-        { 0x81,  op_code_0x81 }, 
-        { 0x82,  op_code_0x82 }, 
-        { 0x83,  op_code_0x83 }, 
-        { 0x84,  op_code_0x84 }, 
-        { 0x85,  op_code_0x85 }, 
-        { 0x86,  op_code_0x86 }, 
-        { 0x87,  op_code_0x87 }, 
-        { 0x8E,  op_code_0x8E }, 
-        { 0x90,  op_code_0x90 }, 
-        { 0xA,   op_code_0xA }, 
-        { 0xB,   op_code_0xB }, 
-        { 0xC,   op_code_0xC }, 
-        { 0xD,   op_code_0xD }, 
-        { 0xE9E, op_code_0xE9E }, 
-        { 0xEA1, op_code_0xEA1 }, 
-        { 0xF07, op_code_0xF07 }, 
-        { 0xF0A, op_code_0xF0A }, 
-        { 0xF15, op_code_0xF15 }, 
-        { 0xF18, op_code_0xF18 }, 
-        { 0xF1E, op_code_0xF1E }, 
-        { 0xF29, op_code_0xF29 }, 
-        { 0xF33, op_code_0xF33 }, 
-        { 0xF55, op_code_0xF55 }, 
-        { 0xF65, op_code_0xF65 }
+    /**
+     *  Every OpCode handler shares the same signature so they can be 
+     *  stored as plain function pointers.
+     */ 
+    using Handler = void (*)(CPU& cpu, const OpCode& op_code);
+
+    /**
+     *  Index of every handler on the handlers table. Instructions that
+     *  don't match any OpCode are mapped to OP_UNKNOWN, which executes
+     *  as a NOP but, unlike OP_0x0, has no assembly counterpart.
+     */ 
+    enum HandlerIndex : uint8_t
+    {
+        OP_0xE0, OP_0xEE, OP_0x0,   OP_0x1,   OP_0x2,   OP_0x3,   OP_0x4,   OP_0x50, 
+        OP_0x6,  OP_0x7,  OP_0x80,  OP_0x81,  OP_0x82,  OP_0x83,  OP_0x84,  OP_0x85, 
+        OP_0x86, OP_0x87, OP_0x8E,  OP_0x90,  OP_0xA,   OP_0xB,   OP_0xC,   OP_0xD, 
+        OP_0xE9E, OP_0xEA1, OP_0xF07, OP_0xF0A, OP_0xF15, OP_0xF18, OP_0xF1E, OP_0xF29, 
+        OP_0xF33, OP_0xF55, OP_0xF65, OP_UNKNOWN, HANDLER_COUNT
+    };
+
+    /**
+     *  Handlers ordered by HandlerIndex.
+     */ 
+    constexpr Handler handlers[HANDLER_COUNT]
+    {
+        op_code_0xE0,  op_code_0xEE,  op_code_0x0,   op_code_0x1,   op_code_0x2,   op_code_0x3,   op_code_0x4,   op_code_0x50,
+        op_code_0x6,   op_code_0x7,   op_code_0x80,  op_code_0x81,  op_code_0x82,  op_code_0x83,  op_code_0x84,  op_code_0x85,
+        op_code_0x86,  op_code_0x87,  op_code_0x8E,  op_code_0x90,  op_code_0xA,   op_code_0xB,   op_code_0xC,   op_code_0xD,
+        op_code_0xE9E, op_code_0xEA1, op_code_0xF07, op_code_0xF0A, op_code_0xF15, op_code_0xF18, op_code_0xF1E, op_code_0xF29,
+        op_code_0xF33, op_code_0xF55, op_code_0xF65, op_code_0x0
+    };
+
+    /**
+     *  Second level of the dispatch table. Depending on the first nibble
+     *  of an instruction, the handler is selected by none (1NNN), the last
+     *  nibble (8XY4) or the last byte (FX15) of the instruction so, each
+     *  row holds up to 256 handler indexes and the mask that selects them.
+     */ 
+    struct HandlerRow
+    {
+        uint16_t mask;
+        uint8_t  handlers[256];
+    };
+
+    /**
+     *  Build a row whose entries are all unknown instructions so, they 
+     *  are ignored just like the original interpreter did.
+     */ 
+    constexpr HandlerRow make_handler_row(uint16_t mask)
+    {
+        HandlerRow row{ mask, {} };
+        for(int i = 0 ; i < 256 ; i++) row.handlers[i] = OP_UNKNOWN;
+        return row;
+    }
+
+    constexpr HandlerRow make_single_handler_row(HandlerIndex handler)
+    {
+        HandlerRow row = make_handler_row(0x0);
+        row.handlers[0x0] = handler;
+        return row;
+    }
+
+    constexpr HandlerRow make_handler_row_0x0()
+    {
+        HandlerRow row = make_handler_row(0xFF);
+        row.handlers[0x00] = OP_0x0;
+        row.handlers[0xE0] = OP_0xE0;
+        row.handlers[0xEE] = OP_0xEE;
+        return row;
+    }
+
+    constexpr HandlerRow make_handler_row_0x5()
+    {
+        HandlerRow row = make_handler_row(0xF);
+        row.handlers[0x0] = OP_0x50;
+        return row;
+    }
+
+    constexpr HandlerRow make_handler_row_0x8()
+    {
+        HandlerRow row = make_handler_row(0xF);
+        row.handlers[0x0] = OP_0x80;
+        row.handlers[0x1] = OP_0x81;
+        row.handlers[0x2] = OP_0x82;
+        row.handlers[0x3] = OP_0x83;
+        row.handlers[0x4] = OP_0x84;
+        row.handlers[0x5] = OP_0x85;
+        row.handlers[0x6] = OP_0x86;
+        row.handlers[0x7] = OP_0x87;
+        row.handlers[0xE] = OP_0x8E;
+        return row;
+    }
+
+    constexpr HandlerRow make_handler_row_0x9()
+    {
+        HandlerRow row = make_handler_row(0xF);
+        row.handlers[0x0] = OP_0x90;
+        return row;
+    }
+
+    constexpr HandlerRow make_handler_row_0xE()
+    {
+        HandlerRow row = make_handler_row(0xFF);
+        row.handlers[0x9E] = OP_0xE9E;
+        row.handlers[0xA1] = OP_0xEA1;
+        return row;
+    }
+
+    constexpr HandlerRow make_handler_row_0xF()
+    {
+        HandlerRow row = make_handler_row(0xFF);
+        row.handlers[0x07] = OP_0xF07;
+        row.handlers[0x0A] = OP_0xF0A;
+        row.handlers[0x15] = OP_0xF15;
+        row.handlers[0x18] = OP_0xF18;
+        row.handlers[0x1E] = OP_0xF1E;
+        row.handlers[0x29] = OP_0xF29;
+        row.handlers[0x33] = OP_0xF33;
+        row.handlers[0x55] = OP_0xF55;
+        row.handlers[0x65] = OP_0xF65;
+        return row;
+    }
+
+    /**
+     *  First level of the dispatch table, indexed by the first nibble
+     *  of the instruction. The whole table is built at compile time so,
+     *  selecting a handler costs two array accesses instead of hashing 
+     *  the decoded OpCode.
+     */ 
+    constexpr HandlerRow handler_table[16]
+    {
+        make_handler_row_0x0(),
+        make_single_handler_row(OP_0x1),
+        make_single_handler_row(OP_0x2),
+        make_single_handler_row(OP_0x3),
+        make_single_handler_row(OP_0x4),
+        make_handler_row_0x5(),
+        make_single_handler_row(OP_0x6),
+        make_single_handler_row(OP_0x7),
+        make_handler_row_0x8(),
+        make_handler_row_0x9(),
+        make_single_handler_row(OP_0xA),
+        make_single_handler_row(OP_0xB),
+        make_single_handler_row(OP_0xC),
+        make_single_handler_row(OP_0xD),
+        make_handler_row_0xE(),
+        make_handler_row_0xF()
+    };
+
+    /**
+     *  Fetch the raw 16 bit instruction pointed by PC. Addresses
+     *  wrap around the 4Kb of memory so, a program that runs past 
+     *  the end of memory never reads outside of it.
+     * 
+     *  @param cpu the cpu whose memory holds the program.
+     * 
+     *  @return the instruction in big endian order as stored by Chip-8.
+     */ 
+    static inline uint16_t fetch(const CPU& cpu)
+    {
+        return (cpu.memory[cpu.PC & 0xFFF] << 0x8) | cpu.memory[(cpu.PC + 1) & 0xFFF];
+    }
+
+    /**
+     *  Select the index of the handler of a raw instruction using the 
+     *  two level dispatch table.
+     * 
+     *  @param instruction the raw 16 bit instruction.
+     * 
+     *  @return the position of the handler on the handlers table.
+     */ 
+    static inline HandlerIndex get_handler_index(uint16_t instruction)
+    {
+        const HandlerRow& row = handler_table[instruction >> 0xC];
+        return static_cast<HandlerIndex>(row.handlers[instruction & row.mask]);
+    }
+
+    /**
+     *  Select the handler of a raw instruction.
+     * 
+     *  @param instruction the raw 16 bit instruction.
+     * 
+     *  @return the function that executes the instruction.
+     */ 
+    static inline Handler get_handler(uint16_t instruction)
+    {
+        return handlers[get_handler_index(instruction)];
+    }
+
+    /**
+     *  An instruction with every field already extracted so, neither
+     *  the interpreter nor the disassembler have to shift and mask 
+     *  the raw instruction again.
+     * 
+     *  op_code is the same translation returned by decode() and, the 
+     *  remaining fields follow the nomenclature described on decode().
+     */ 
+    struct Instruction
+    {
+        OpCode   op_code;
+        uint8_t  handler; // HandlerIndex of the instruction.
+        uint8_t  X;
+        uint8_t  Y;
+        uint8_t  N;
+        uint8_t  NN;
+        uint16_t NNN;
     };
 
+    /**
+     *  Decode a raw instruction into an Instruction record.
+     * 
+     *  @param instruction the raw 16 bit instruction.
+     * 
+     *  @return the decoded instruction.
+     */ 
+    static inline Instruction make_instruction(uint16_t instruction)
+    {
+        const std::array<uint8_t, 2> word {{ static_cast<uint8_t>(instruction >> 0x8), static_cast<uint8_t>(instruction & 0xFF) }};
+
+        Instruction result{};
+        result.op_code = decode(word, 0);
+        result.handler = get_handler_index(instruction);
+        result.X       = (instruction & 0xF00) >> 0x8;
+        result.Y       = (instruction & 0xF0)  >> 0x4;
+        result.N       = instruction & 0xF;
+        result.NN      = instruction & 0xFF;
+        result.NNN     = instruction & 0xFFF;
+
+        return result;
+    }
+
+    /**
+     *  Every 16 bit word has exactly one decoding so, all of them are
+     *  decoded once, the first time the table is requested, and then 
+     *  decoding an instruction is just an indexed load.
+     * 
+     *  @return a table with 65536 entries indexed by the raw instruction.
+     */ 
+    static inline const Instruction* decode_table()
+    {
+        static const std::unique_ptr<Instruction[]> table = []
+        {
+            std::unique_ptr<Instruction[]> result{new Instruction[0x10000]};
+            for(uint32_t i = 0 ; i < 0x10000 ; i++) result[i] = make_instruction(i);
+            return result;
+        }();
+
+        return table.get();
+    }
+
+    /**
+     *  Table backed counterpart of decode(). 
+     *  
+     *  @tparam N the number of bytes in the buffer program.
+     *  
+     *  @param program the buffer that contains the binary data.
+     *  @param PC the program counter which tells us where is the next OpCode.
+     *  
+     *  @return the decoded instruction pointed by PC.
+     */
+    template <size_t N>
+    static inline const Instruction& predecode(const std::array<uint8_t, N>& program, uint16_t PC)
+    {
+        return decode_table()[(program[PC] << 0x8) | program[PC + 1]];
+    }
+
+    /**
+     *  Get the instruction pointed by PC from the decoded cache.
+     *  The instruction is only fetched and decoded when its slot 
+     *  was invalidated.
+     * 
+     *  @param cpu the cpu whose next instruction will be returned.
+     * 
+     *  @return the slot of the decoded cache pointed by PC.
+     */ 
+    static inline const CachedInstruction& lookup(CPU& cpu)
+    {
+        CachedInstruction& instruction = cpu.decoded[cpu.PC & 0xFFF];
+
+        if(instruction.handler == NOT_DECODED)
+        {
+            const Instruction& decoded = decode_table()[fetch(cpu)];
+
+            instruction.op_code = decoded.op_code;
+            instruction.handler = decoded.handler;
+        }
+
+        return instruction;
+    }
+
     /**
      *  Fetch, decode and execute an instruction
      *  from memory. Also, increment the PC register
-     *  by two (advance to the next instruction).
+     *  by two (advance to the next instruction) and
+     *  count the instruction for the timers.
      * 
      *  @param cpu it contains all the resources
      *             used by the program.
      */
     static inline void cycle(CPU& cpu)
     {
-        OpCode op_code = decode(cpu.memory, cpu.PC);
+        const CachedInstruction& instruction = lookup(cpu);
 
-        if(op_codes.find(op_code.code) != op_codes.end())
-            op_codes.at(op_code.code)(cpu, op_code);
+        handlers[instruction.handler](cpu, instruction.op_code);
         
-        if(cpu.DT > 0) --cpu.DT;
-        if(cpu.ST > 0) --cpu.ST;
-
-        cpu.PC += 2;
+        cpu.cycles += 1;
+        cpu.PC     += 2;
     }
 }
 
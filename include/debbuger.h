@@ -1,24 +1,29 @@
 #ifndef DEBUGER_H
 #define DEBUGER_H
 
+#include <array>
 #include <string>
+#include <cstdint>
 #include <stdio.h>
+#include <algorithm>
 
 #include "./cpu.h"
+#include "./batch.h"
+#include "./disassembler.h"
 
 namespace chip
 {
-    void print_registers(const CPU& cpu)
+    static inline void print_registers(const CPU& cpu)
     {
         for(int i = 0; i < cpu.V.size(); i++) printf("V[%d]\t%d\n", i, cpu.V[i]);
 
         printf("----\n");
     }
 
-    void print_sp_registers(const CPU& cpu)
+    static inline void print_sp_registers(const CPU& cpu)
     {
-        printf("DT\t%d\n", cpu.DT);
-        printf("ST\t%d\n", cpu.ST);
+        printf("DT\t%d\n", delay_timer(cpu));
+        printf("ST\t%d\n", sound_timer(cpu));
         printf("SP\t%d\n", cpu.SP);
         printf("PC\t%d\n", cpu.PC);
         printf("I \t%d\n", cpu.I);
@@ -26,12 +31,248 @@ namespace chip
         printf("\n");
     }
 
-    void print_stack(const CPU& cpu)
+    static inline void print_stack(const CPU& cpu)
     {
         for(int i = 0; i < cpu.stack.size(); i++) printf("S[%d]\t%d\n", i, cpu.stack[i]);
         printf("\n");
     }
 
+    /**
+     *  Flags of an address of the debugger.
+     */
+    const uint8_t DEBUG_BREAK       = 0x1; // Stop before the instruction at the address.
+    const uint8_t DEBUG_WATCH_READ  = 0x2; // Stop before an instruction that reads the address.
+    const uint8_t DEBUG_WATCH_WRITE = 0x4; // Stop before an instruction that writes the address.
+
+    /**
+     *  Why the debugger stopped the last run.
+     */
+    enum DebugHit : uint8_t
+    {
+        HIT_NONE,
+        HIT_BREAKPOINT,
+        HIT_READ,
+        HIT_WRITE,
+        HIT_RUN_TO
+    };
+
+    const std::array<const char*, 5> hit_names
+    {{
+        "none", "breakpoint", "read watchpoint", "write watchpoint", "run to address"
+    }};
+
+    /**
+     *  Breakpoints and watchpoints as flags for each address of the
+     *  memory. A run with none of them set doesn't look at the flags,
+     *  a run with breakpoints only looks up the flags of each PC and
+     *  only the instructions that read or write memory look up the
+     *  flags of the addresses they access, when a watchpoint is set.
+     */
+    struct Debugger
+    {
+        Debugger() : flags{}, breakpoints{0}, watchpoints{0}, hit{HIT_NONE}, address{0} {}
+
+        std::array<uint8_t, 4096> flags;
+        uint32_t breakpoints; // Addresses with DEBUG_BREAK set.
+        uint32_t watchpoints; // Addresses with DEBUG_WATCH_READ or DEBUG_WATCH_WRITE set.
+        DebugHit hit;         // What stopped the last run.
+        uint16_t address;     // Address of the breakpoint or watchpoint hit.
+    };
+
+    /**
+     *  Set or clear flags of an address.
+     *
+     *  @param debugger the debugger.
+     *  @param address the address of the memory.
+     *  @param flags DEBUG_BREAK, DEBUG_WATCH_READ and DEBUG_WATCH_WRITE.
+     *  @param enabled true sets the flags, false clears them.
+     */
+    static inline void set_debug_flags(Debugger& debugger, uint16_t address, uint8_t flags, bool enabled)
+    {
+        const uint8_t WATCH = DEBUG_WATCH_READ | DEBUG_WATCH_WRITE;
+
+        uint8_t&      slot     = debugger.flags[address & 0xFFF];
+        const uint8_t previous = slot;
+
+        slot = enabled ? slot | flags : slot & ~flags;
+
+        debugger.breakpoints += ((slot & DEBUG_BREAK) != 0) - ((previous & DEBUG_BREAK) != 0);
+        debugger.watchpoints += ((slot & WATCH) != 0)       - ((previous & WATCH) != 0);
+    }
+
+    /**
+     *  Find the addresses the next instruction of a cpu reads or writes.
+     *
+     *  @param cpu the cpu about to run the instruction.
+     *  @param first where the first address is stored.
+     *  @param count where the number of addresses is stored.
+     *
+     *  @return DEBUG_WATCH_READ or DEBUG_WATCH_WRITE, 0 if the
+     *          instruction doesn't access memory.
+     */
+    static inline uint8_t memory_access(const CPU& cpu, uint16_t& first, uint16_t& count)
+    {
+        const uint16_t raw = fetch(cpu);
+
+        first = cpu.I;
+        count = 0;
+
+        // Only DXYN and some FX instructions access memory.
+        if(raw < 0xD000 || (raw >= 0xE000 && raw < 0xF000)) return 0;
+
+        const Instruction& instruction = decode_table()[raw];
+        const uint16_t     data        = instruction.op_code.data;
+
+        switch(instruction.handler)
+        {
+            case OP_0xD:
+                // The rows of the sprite below the screen are never read.
+                count = std::min<uint16_t>(data & 0xF, SCREEN_HEIGHT - cpu.V[(data & 0xF0) >> 4] % SCREEN_HEIGHT);
+                return DEBUG_WATCH_READ;
+
+            case OP_0xF33: count = 3;        return DEBUG_WATCH_WRITE;
+            case OP_0xF55: count = data + 1; return DEBUG_WATCH_WRITE;
+            case OP_0xF65: count = data + 1; return DEBUG_WATCH_READ;
+
+            default:                         return 0;
+        }
+    }
+
+    /**
+     *  Check the breakpoints and watchpoints of the next instruction of
+     *  a cpu, recording the one hit on the debugger.
+     *
+     *  @param debugger the debugger.
+     *  @param cpu the cpu about to run the instruction.
+     *
+     *  @return true if the run must stop.
+     */
+    static inline bool check_debugger(Debugger& debugger, const CPU& cpu)
+    {
+        if(debugger.flags[cpu.PC & 0xFFF] & DEBUG_BREAK)
+        {
+            debugger.hit     = HIT_BREAKPOINT;
+            debugger.address = cpu.PC;
+            return true;
+        }
+
+        if(debugger.watchpoints == 0) return false;
+
+        uint16_t first = 0;
+        uint16_t count = 0;
+
+        const uint8_t access = memory_access(cpu, first, count);
+
+        for(uint16_t i = 0 ; i < count ; i++)
+        {
+            const uint16_t address = (first + i) & 0xFFF;
+
+            if(debugger.flags[address] & access)
+            {
+                debugger.hit     = access == DEBUG_WATCH_READ ? HIT_READ : HIT_WRITE;
+                debugger.address = address;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     *  Address a run of the debugger doesn't stop at by itself.
+     */
+    const uint32_t NO_TARGET = 0x10000;
+
+    struct DebugPredicate
+    {
+        Debugger& debugger;
+        uint32_t  target; // Address to run to, NO_TARGET if there is none.
+
+        bool operator()(const CPU& cpu) const
+        {
+            if(cpu.PC == target)
+            {
+                debugger.hit     = HIT_RUN_TO;
+                debugger.address = cpu.PC;
+                return true;
+            }
+
+            return check_debugger(debugger, cpu);
+        }
+    };
+
+    /**
+     *  Execute the next instruction, whatever the breakpoints.
+     *
+     *  @param cpu the cpu being debugged.
+     *  @param debugger the debugger.
+     */
+    static inline RunResult debug_step(CPU& cpu, Debugger& debugger)
+    {
+        debugger.hit = HIT_NONE;
+
+        return run_batch(cpu, 1, false, NoBreakpoint{});
+    }
+
+    /**
+     *  Execute instructions until a breakpoint or a watchpoint is hit,
+     *  or the budget is used. The instruction the cpu is stopped at is
+     *  executed even if it has a breakpoint so, calling this function
+     *  again continues the run.
+     *
+     *  @param cpu the cpu being debugged.
+     *  @param debugger the debugger.
+     *  @param cycles the maximum number of instructions to execute.
+     */
+    static inline RunResult debug_continue(CPU& cpu, Debugger& debugger, uint64_t cycles)
+    {
+        debugger.hit = HIT_NONE;
+
+        // Nothing to check so, the run is the same as run_cycles().
+        if(debugger.breakpoints == 0 && debugger.watchpoints == 0) return run_batch(cpu, cycles, false, NoBreakpoint{});
+
+        return run_batch(cpu, cycles, false, DebugPredicate{debugger, NO_TARGET});
+    }
+
+    /**
+     *  Execute instructions until the PC reaches an address, or a
+     *  breakpoint or a watchpoint is hit first.
+     *
+     *  @param cpu the cpu being debugged.
+     *  @param debugger the debugger.
+     *  @param address the address to run to.
+     *  @param cycles the maximum number of instructions to execute.
+     */
+    static inline RunResult debug_run_to(CPU& cpu, Debugger& debugger, uint16_t address, uint64_t cycles)
+    {
+        debugger.hit = HIT_NONE;
+
+        return run_batch(cpu, cycles, false, DebugPredicate{debugger, address});
+    }
+
+    /**
+     *  Print why the debugger stopped, the next instruction and the
+     *  registers and the stack of the cpu.
+     *
+     *  @param cpu the cpu being debugged.
+     *  @param debugger the debugger.
+     */
+    static inline void print_debugger(const CPU& cpu, const Debugger& debugger)
+    {
+        if(debugger.hit != HIT_NONE) printf("Stopped by %s at 0x%03X\n", hit_names[debugger.hit], debugger.address);
+
+        if(static_cast<size_t>(cpu.PC) + 1 < cpu.memory.size())
+        {
+            const Instruction& instruction = predecode(cpu.memory, cpu.PC);
+            const std::string  assembly    = disassemblers[instruction.handler] != nullptr ? disassemblers[instruction.handler](instruction.op_code) : "(unknown)";
+
+            printf("0x%03X\t%04X\t%s\n\n", cpu.PC, fetch(cpu), assembly.c_str());
+        }
+
+        print_registers(cpu);
+        print_sp_registers(cpu);
+        print_stack(cpu);
+    }
 }
 
-#endif
\ No newline at end of file
+#endif
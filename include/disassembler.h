@@ -6,10 +6,9 @@
 #include <memory>
 #include <cstdint>
 #include <fstream>
+#include <iomanip>
 #include <sstream>
 #include <iostream>
-#include <functional>
-#include <unordered_map>
 
 #include "./opcode.h"
 #include "./cpu.h"
@@ -330,58 +329,34 @@ namespace chip
         return result.str();
     }
 
+    using Disassembler = std::string (*)(const OpCode& op_code);
+
+    /**
+     *  Disassemblers ordered by HandlerIndex. Unknown instructions
+     *  have no assembly counterpart so they are skipped.
+     */ 
+    constexpr Disassembler disassemblers[HANDLER_COUNT]
+    {
+        disassemble_0xE0,  disassemble_0xEE,  disassemble_0x0,   disassemble_0x1,   disassemble_0x2,   disassemble_0x3,   disassemble_0x4,   disassemble_0x50,
+        disassemble_0x6,   disassemble_0x7,   disassemble_0x80,  disassemble_0x81,  disassemble_0x82,  disassemble_0x83,  disassemble_0x84,  disassemble_0x85,
+        disassemble_0x86,  disassemble_0x87,  disassemble_0x8E,  disassemble_0x90,  disassemble_0xA,   disassemble_0xB,   disassemble_0xC,   disassemble_0xD,
+        disassemble_0xE9E, disassemble_0xEA1, disassemble_0xF07, disassemble_0xF0A, disassemble_0xF15, disassemble_0xF18, disassemble_0xF1E, disassemble_0xF29,
+        disassemble_0xF33, disassemble_0xF55, disassemble_0xF65, nullptr
+    };
+
     /**
      *  Convert every OpCode in the binary buffer to its corresponding
      *  assembly counterpart and decode the OpCode data so we can 
      *  properly see how is the program working.
      *  
      *  @param program a buffer that contains the loaded program.
-     * 
+     *  @param output where the assembly is written.
      */ 
     template <size_t N>
-    void disassemble(const std::array<uint8_t, N>& program, std::ofstream& output)
+    void disassemble(const std::array<uint8_t, N>& program, std::ostream& output)
     {
         uint32_t PC = 0;
 
-        const std::unordered_map<uint16_t, std::function<std::string (const OpCode&)>> disassemblers
-        {
-            { 0xE0,  disassemble_0xE0 },
-            { 0xEE,  disassemble_0xEE },
-            { 0x0 ,  disassemble_0x0  }, 
-            { 0x1,   disassemble_0x1  }, 
-            { 0x2,   disassemble_0x2  }, 
-            { 0x3,   disassemble_0x3  }, 
-            { 0x4,   disassemble_0x4  }, 
-            { 0x50,  disassemble_0x50 }, 
-            { 0x6,   disassemble_0x6  }, 
-            { 0x7,   disassemble_0x7  }, 
-            { 0x80,  disassemble_0x80 }, 
-            { 0x81,  disassemble_0x81 }, 
-            { 0x82,  disassemble_0x82 }, 
-            { 0x83,  disassemble_0x83 }, 
-            { 0x84,  disassemble_0x84 }, 
-            { 0x85,  disassemble_0x85 }, 
-            { 0x86,  disassemble_0x86 }, 
-            { 0x87,  disassemble_0x87 }, 
-            { 0x8E,  disassemble_0x8E }, 
-            { 0x90,  disassemble_0x90 }, 
-            { 0xA,   disassemble_0xA }, 
-            { 0xB,   disassemble_0xB }, 
-            { 0xC,   disassemble_0xC }, 
-            { 0xD,   disassemble_0xD }, 
-            { 0xE9E, disassemble_0xE9E }, 
-            { 0xEA1, disassemble_0xEA1 }, 
-            { 0xF07, disassemble_0xF07 }, 
-            { 0xF0A, disassemble_0xF0A }, 
-            { 0xF15, disassemble_0xF15 }, 
-            { 0xF18, disassemble_0xF18 }, 
-            { 0xF1E, disassemble_0xF1E }, 
-            { 0xF29, disassemble_0xF29 }, 
-            { 0xF33, disassemble_0xF33 }, 
-            { 0xF55, disassemble_0xF55 }, 
-            { 0xF65, disassemble_0xF65 }
-        };
-
         int line = 0;
 
         output << "ADDR" << "  " << "Assembly" << "\n";
@@ -389,11 +364,11 @@ namespace chip
 
         while(PC < program.size())
         {
-            OpCode op_code = decode(program, PC);
+            const Instruction& instruction = predecode(program, PC);
             
-            if(disassemblers.find(op_code.code) != disassemblers.end())
+            if(disassemblers[instruction.handler] != nullptr)
             {
-                std::string message = disassemblers.at(op_code.code)(op_code);
+                std::string message = disassemblers[instruction.handler](instruction.op_code);
                 output <<  std::setfill('0') << std::setw(4) << std::to_string(line) << "  " << message << "\n";
                 line++;
             }
@@ -0,0 +1,155 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "./cpu.h"
+
+namespace chip
+{
+    /**
+     *  On this file we present the hand off of frames between the
+     *  thread that runs a cpu and the thread that presents its screen.
+     *
+     *  Frames go through a lock free triple buffer: the emulation
+     *  thread writes the back buffer and swaps it with the middle one,
+     *  the presenter swaps the middle buffer with the front one when
+     *  there is a new frame. Neither side ever waits for the other and,
+     *  the presenter always gets the newest frame, older frames that
+     *  were never presented are dropped.
+     */
+
+    /**
+     *  A snapshot of the screen. The changed region covers every
+     *  pixel that changed since the last frame the presenter could
+     *  have taken so, presenting it never misses a dropped frame.
+     */
+    struct Frame
+    {
+        std::array<uint64_t, 32> screen;
+        ScreenRect changed;
+        uint64_t   sequence; // Number of the frame, starting at 1.
+    };
+
+    /**
+     *  Bit set on the middle index when it holds a frame that has not
+     *  been taken by the presenter.
+     */
+    const uint8_t FRESH_FRAME = 0x4;
+
+    /**
+     *  Three frames and the counters used to check that the emulation
+     *  thread is never blocked by the presenter.
+     *
+     *  back and since_taken belong to the emulation thread, front belongs
+     *  to the presenter and middle is the only index both of them touch.
+     */
+    struct FrameBuffer
+    {
+        FrameBuffer() : frames{}, middle{1}, back{0}, front{2}, since_taken(EMPTY_RECT),
+                        published{0}, presented{0}, dropped{0} {}
+
+        FrameBuffer(const FrameBuffer&) = delete;
+        FrameBuffer& operator=(const FrameBuffer&) = delete;
+
+        std::array<Frame, 3> frames;
+        std::atomic<uint8_t> middle;
+        uint8_t back;
+        uint8_t front;
+        ScreenRect since_taken; // Changes since the last frame known to be taken.
+        std::atomic<uint64_t> published;
+        std::atomic<uint64_t> presented;
+        std::atomic<uint64_t> dropped;
+    };
+
+    /**
+     *  Copy the screen of the cpu into a new frame and hand it to the
+     *  presenter. It never waits, if the previous frame has not been
+     *  taken yet it is dropped and replaced by this one.
+     *
+     *  @param buffer the frames shared with the presenter.
+     *  @param cpu the cpu whose screen will be published, its changed
+     *             region is cleared.
+     */
+    static inline void publish_frame(FrameBuffer& buffer, CPU& cpu)
+    {
+        Frame& frame = buffer.frames[buffer.back];
+
+        // The last frame published has been taken so, this one only needs its own changes.
+        if((buffer.middle.load(std::memory_order_acquire) & FRESH_FRAME) == 0) buffer.since_taken = EMPTY_RECT;
+
+        merge_rect(buffer.since_taken, cpu.changed);
+        clear_changed(cpu);
+
+        frame.screen   = cpu.screen;
+        frame.changed  = buffer.since_taken;
+        frame.sequence = buffer.published.load(std::memory_order_relaxed) + 1;
+
+        const uint8_t previous = buffer.middle.exchange(buffer.back | FRESH_FRAME, std::memory_order_acq_rel);
+
+        buffer.back = previous & ~FRESH_FRAME;
+        buffer.published.fetch_add(1, std::memory_order_relaxed);
+
+        if(previous & FRESH_FRAME) buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     *  Take the newest frame published, if there is one that the
+     *  presenter has not taken yet.
+     *
+     *  @param buffer the frames shared with the emulation thread.
+     *
+     *  @return the new frame or nullptr, the frame stays valid until
+     *          the next call.
+     */
+    static inline const Frame* take_frame(FrameBuffer& buffer)
+    {
+        if((buffer.middle.load(std::memory_order_acquire) & FRESH_FRAME) == 0) return nullptr;
+
+        const uint8_t previous = buffer.middle.exchange(buffer.front, std::memory_order_acq_rel);
+
+        buffer.front = previous & ~FRESH_FRAME;
+
+        return &buffer.frames[buffer.front];
+    }
+
+    /**
+     *  Convert a region of a screen to ARGB8888 pixels, pixels that are
+     *  on are white and the rest are black. Each row is read once and
+     *  its bits are expanded from the left.
+     *
+     *  @param screen the rows of the screen.
+     *  @param rect the region to be converted.
+     *  @param pixels SCREEN_WIDHT * SCREEN_HEIGHT pixels, only the ones
+     *                inside the region are written.
+     */
+    static inline void screen_to_argb(const std::array<uint64_t, 32>& screen, const ScreenRect& rect, uint32_t* pixels)
+    {
+        for(uint32_t y = rect.top ; y < rect.bottom ; y++)
+        {
+            const uint64_t row  = screen[y] << rect.left;
+            uint32_t*      line = pixels + y * SCREEN_WIDHT;
+
+            for(uint32_t x = rect.left ; x < rect.right ; x++)
+            {
+                const uint32_t pixel = (row >> (63 - (x - rect.left))) & 0x1;
+
+                line[x] = (0x00FFFFFF * pixel) | 0xFF000000;
+            }
+        }
+    }
+
+    /**
+     *  Count a frame taken with take_frame() as presented.
+     *
+     *  @param buffer the frames shared with the emulation thread.
+     */
+    static inline void frame_presented(FrameBuffer& buffer)
+    {
+        buffer.presented.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+#endif
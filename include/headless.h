@@ -0,0 +1,183 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+#include "./cpu.h"
+#include "./batch.h"
+
+namespace chip
+{
+    /**
+     *  FNV-1a hash of the rows of a screen, two screens with the same
+     *  pixels always have the same hash.
+     *
+     *  @param screen the rows of the screen.
+     */
+    static inline uint64_t screen_hash(const std::array<uint64_t, 32>& screen)
+    {
+        uint64_t hash = 0xCBF29CE484222325ULL;
+
+        for(uint64_t row : screen)
+        {
+            for(int i = 0 ; i < 8 ; i++)
+            {
+                hash ^= (row >> (i * 8)) & 0xFF;
+                hash *= 0x100000001B3ULL;
+            }
+        }
+
+        return hash;
+    }
+
+    /**
+     *  FNV-1a hash of everything a program can observe: registers,
+     *  timers, stack, memory and screen.
+     *
+     *  @param cpu the cpu whose state will be hashed.
+     */
+    static inline uint64_t state_hash(const CPU& cpu)
+    {
+        uint64_t hash = screen_hash(cpu.screen);
+
+        const auto add = [&hash](uint64_t value, int bytes)
+        {
+            for(int i = 0 ; i < bytes ; i++)
+            {
+                hash ^= (value >> (i * 8)) & 0xFF;
+                hash *= 0x100000001B3ULL;
+            }
+        };
+
+        for(uint8_t  value : cpu.V)      add(value, 1);
+        for(uint16_t value : cpu.stack)  add(value, 2);
+        for(uint8_t  value : cpu.memory) add(value, 1);
+
+        add(cpu.PC, 2);
+        add(cpu.I,  2);
+        add(cpu.SP, 1);
+        add(delay_timer(cpu), 1);
+        add(sound_timer(cpu), 1);
+
+        return hash;
+    }
+
+    /**
+     *  Write a screen as a binary PPM image, pixels that are on are
+     *  white and the rest are black.
+     *
+     *  @param output where the image is written.
+     *  @param screen the rows of the screen.
+     *  @param scale the size in pixels of each pixel of the screen.
+     */
+    static inline void write_ppm(std::ostream& output, const std::array<uint64_t, 32>& screen, uint32_t scale = 1)
+    {
+        output << "P6\n" << SCREEN_WIDHT * scale << " " << SCREEN_HEIGHT * scale << "\n255\n";
+
+        for(uint32_t y = 0 ; y < SCREEN_HEIGHT * scale ; y++)
+        {
+            for(uint32_t x = 0 ; x < SCREEN_WIDHT * scale ; x++)
+            {
+                const char color = get_pixel(screen, x / scale, y / scale) ? static_cast<char>(0xFF) : 0x0;
+
+                output.put(color); output.put(color); output.put(color);
+            }
+        }
+    }
+
+    /**
+     *  State of the key pad from the start of a frame until the next
+     *  input event.
+     */
+    struct InputEvent
+    {
+        uint64_t frame;
+        uint16_t key_pad;
+    };
+
+    /**
+     *  Read an input script. Each line holds the frame where the key
+     *  pad changes and the new key pad as a hexadecimal mask where bit
+     *  N is key N, text after # is ignored:
+     *
+     *      # Hold key 5 for a second.
+     *      60  0x0020
+     *      120 0x0000
+     *
+     *  @param input the script.
+     *
+     *  @return the events sorted by frame.
+     */
+    static inline std::vector<InputEvent> parse_input(std::istream& input)
+    {
+        std::vector<InputEvent> events;
+        std::string line;
+        uint32_t number = 0;
+
+        while(std::getline(input, line))
+        {
+            number++;
+
+            line = line.substr(0, line.find('#'));
+            if(line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+            std::istringstream fields{line};
+            uint64_t frame;
+            uint32_t key_pad;
+
+            if(!(fields >> std::dec >> frame >> std::hex >> key_pad) || key_pad > 0xFFFF)
+            {
+                throw std::runtime_error{"Invalid input event on line " + std::to_string(number)};
+            }
+
+            events.push_back(InputEvent{ frame, static_cast<uint16_t>(key_pad) });
+        }
+
+        std::stable_sort(events.begin(), events.end(), [](const InputEvent& a, const InputEvent& b) { return a.frame < b.frame; });
+
+        return events;
+    }
+
+    /**
+     *  Execute a number of instructions in frames, setting the key pad
+     *  at the start of every frame as the input script says.
+     *
+     *  @param cpu the cpu that will run the instructions.
+     *  @param events the input script sorted by frame.
+     *  @param cycles the number of instructions to execute.
+     *  @param cycles_per_frame the number of instructions of a frame.
+     *  @param observer sees every instruction, see run_batch().
+     *
+     *  @return STOP_FAULT if the observer stopped the run, STOP_BUDGET
+     *          otherwise.
+     */
+    template<typename Observer = NoObserver>
+    static inline StopReason run_scripted(CPU& cpu, const std::vector<InputEvent>& events, uint64_t cycles, uint64_t cycles_per_frame,
+                                          Observer observer = Observer{})
+    {
+        auto event = events.begin();
+
+        for(uint64_t frame = 0 ; cycles > 0 ; frame++)
+        {
+            for(; event != events.end() && event->frame <= frame ; event++) cpu.key_pad = event->key_pad;
+
+            const uint64_t budget = std::min(cycles, cycles_per_frame);
+
+            if(run_batch(cpu, budget, false, NoBreakpoint{}, observer).reason == STOP_FAULT) return STOP_FAULT;
+
+            cycles -= budget;
+        }
+
+        return STOP_BUDGET;
+    }
+}
+
+#endif
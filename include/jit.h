@@ -0,0 +1,704 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#include "./opcode.h"
+#include "./cpu.h"
+#include "./block.h"
+
+/**
+ *  The recompiler emits x86-64 machine code into memory obtained
+ *  with mmap so, it is only available on x86-64 unix systems. On
+ *  any other target run_jit() only uses the interpreter.
+ */
+#if defined(__x86_64__) && (defined(__linux__) || defined(__unix__)) && !defined(CHIP8_NO_JIT)
+#define CHIP8_JIT 1
+#include <sys/mman.h>
+#endif
+
+namespace chip
+{
+    /**
+     *  On this file we present a dynamic recompiler that translates
+     *  hot basic blocks of Chip-8 instructions into x86-64 code.
+     *
+     *  Blocks are found with the same rules as the block backend and,
+     *  a block is compiled once it started JIT_THRESHOLD times on the
+     *  interpreter. Within a compiled block the V registers live on
+     *  host registers, arithmetic, loads, skips and jumps are emitted
+     *  natively and every other instruction (DXYN, CXNN, the timers,
+     *  the keyboard, calls and memory accesses) calls back into its
+     *  handler through jit_call().
+     *
+     *  Running a compiled block leaves the cpu in exactly the same
+     *  state as calling cycle() once per instruction of the block.
+     */
+
+#ifdef CHIP8_JIT
+    const bool CHIP8_JIT_AVAILABLE = true;
+#else
+    const bool CHIP8_JIT_AVAILABLE = false;
+#endif
+
+    const uint16_t JIT_THRESHOLD = 32;
+    const size_t   JIT_CODE_SIZE = 1 << 20;
+
+    /**
+     *  A compiled block covers the memory range [start, end) and its
+     *  code executes cycles instructions.
+     */
+    struct JitBlock
+    {
+        uint16_t start;
+        uint16_t end;
+        uint16_t cycles;
+        void (*code)(CPU* cpu);
+    };
+
+    /**
+     *  Hotness counters and compiled blocks indexed by their start
+     *  address. An index of zero means that there is no compiled block
+     *  starting at the address, otherwise, the block is stored at
+     *  blocks[index - 1].
+     */
+    struct Jit
+    {
+        explicit Jit(uint16_t threshold = JIT_THRESHOLD) : threshold{threshold}, hotness{}, index{}, blocks{}, code{nullptr}, code_used{0}
+        {
+#ifdef CHIP8_JIT
+            void* memory = mmap(nullptr, JIT_CODE_SIZE, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+            if(memory == MAP_FAILED) throw std::runtime_error{"Unable to map memory for the recompiler"};
+
+            code = static_cast<uint8_t*>(memory);
+#endif
+        }
+
+        ~Jit()
+        {
+#ifdef CHIP8_JIT
+            munmap(code, JIT_CODE_SIZE);
+#endif
+        }
+
+        Jit(const Jit&) = delete;
+        Jit& operator=(const Jit&) = delete;
+
+        uint16_t threshold;
+        std::array<uint16_t, 4096> hotness;
+        std::array<uint16_t, 4096> index;
+        std::vector<JitBlock> blocks;
+        uint8_t* code;
+        size_t   code_used;
+    };
+
+    /**
+     *  Execute a single instruction from compiled code.
+     *
+     *  @param cpu the cpu that runs the compiled block.
+     *  @param instruction the raw 16 bit instruction.
+     */
+    static inline void jit_call(CPU* cpu, uint32_t instruction)
+    {
+        const Instruction& decoded = decode_table()[instruction];
+
+        handlers[decoded.handler](*cpu, decoded.op_code);
+    }
+
+    /**
+     *  Check if an instruction is emitted natively instead of calling
+     *  back into its handler.
+     *
+     *  @param handler the index of the handler of the instruction.
+     */
+    static inline bool is_native(uint8_t handler)
+    {
+        switch (handler)
+        {
+        case OP_0x0:  case OP_UNKNOWN: case OP_0x1:  case OP_0x3:  case OP_0x4:  case OP_0x50:
+        case OP_0x6:  case OP_0x7:     case OP_0x80: case OP_0x81: case OP_0x82: case OP_0x83:
+        case OP_0x84: case OP_0x85:    case OP_0x86: case OP_0x87: case OP_0x8E: case OP_0x90:
+        case OP_0xA:  case OP_0xF1E:   case OP_0xF29:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    /**
+     *  Minimal x86-64 assembler. Registers are numbered as in the
+     *  instruction encoding (rax = 0 ... r15 = 15) and every arithmetic
+     *  instruction works on 32 bit registers.
+     */
+    struct Assembler
+    {
+        std::vector<uint8_t> bytes;
+
+        void byte(uint8_t value) { bytes.push_back(value); }
+
+        void imm16(uint16_t value)
+        {
+            byte(value & 0xFF);
+            byte(value >> 8);
+        }
+
+        void imm32(uint32_t value)
+        {
+            for(int i = 0 ; i < 4 ; i++) byte((value >> (i * 8)) & 0xFF);
+        }
+
+        void imm64(uint64_t value)
+        {
+            for(int i = 0 ; i < 8 ; i++) byte((value >> (i * 8)) & 0xFF);
+        }
+
+        void rex(bool w, uint8_t reg, uint8_t rm, bool force = false)
+        {
+            const uint8_t prefix = 0x40 | (w << 3) | ((reg >> 3) << 2) | (rm >> 3);
+            if(prefix != 0x40 || force) byte(prefix);
+        }
+
+        void modrm(uint8_t mod, uint8_t reg, uint8_t rm) { byte((mod << 6) | ((reg & 7) << 3) | (rm & 7)); }
+
+        // op r/m32, r32 (add 01, or 09, and 21, sub 29, xor 31, cmp 39, mov 89).
+        void op_rr(uint8_t opcode, uint8_t dst, uint8_t src)
+        {
+            rex(false, src, dst);
+            byte(opcode);
+            modrm(3, src, dst);
+        }
+
+        // op r/m32, imm32 (add 0, or 1, and 4, sub 5, xor 6, cmp 7).
+        void op_ri(uint8_t extension, uint8_t dst, uint32_t value)
+        {
+            rex(false, 0, dst);
+            byte(0x81);
+            modrm(3, extension, dst);
+            imm32(value);
+        }
+
+        void mov_ri(uint8_t dst, uint32_t value)
+        {
+            rex(false, 0, dst);
+            byte(0xB8 + (dst & 7));
+            imm32(value);
+        }
+
+        // shl (4) / shr (5) r/m32, imm8.
+        void shift(uint8_t extension, uint8_t dst, uint8_t count)
+        {
+            rex(false, 0, dst);
+            byte(0xC1);
+            modrm(3, extension, dst);
+            byte(count);
+        }
+
+        // Every memory access is relative to r15, which holds the cpu.
+        void load_byte(uint8_t dst, uint32_t offset)
+        {
+            rex(false, dst, 15);
+            byte(0x0F); byte(0xB6);
+            modrm(2, dst, 15);
+            imm32(offset);
+        }
+
+        void store_byte(uint32_t offset, uint8_t src)
+        {
+            rex(false, src, 15, true);
+            byte(0x88);
+            modrm(2, src, 15);
+            imm32(offset);
+        }
+
+        void load_word(uint8_t dst, uint32_t offset)
+        {
+            rex(false, dst, 15);
+            byte(0x0F); byte(0xB7);
+            modrm(2, dst, 15);
+            imm32(offset);
+        }
+
+        void store_word(uint32_t offset, uint8_t src)
+        {
+            byte(0x66);
+            rex(false, src, 15);
+            byte(0x89);
+            modrm(2, src, 15);
+            imm32(offset);
+        }
+
+        // add qword [r15 + offset], imm32.
+        void add_qword_imm(uint32_t offset, uint32_t value)
+        {
+            rex(true, 0, 15);
+            byte(0x81);
+            modrm(2, 0, 15);
+            imm32(offset);
+            imm32(value);
+        }
+
+        void store_word_imm(uint32_t offset, uint16_t value)
+        {
+            byte(0x66);
+            rex(false, 0, 15);
+            byte(0xC7);
+            modrm(2, 0, 15);
+            imm32(offset);
+            imm16(value);
+        }
+
+        // setcc cl after clearing rcx, flags must be set after the clear.
+        void setcc_cl(uint8_t condition)
+        {
+            byte(0x0F); byte(0x90 | condition);
+            byte(0xC1);
+        }
+
+        // jcc rel32, returns the position of the displacement to patch.
+        size_t jcc(uint8_t condition)
+        {
+            byte(0x0F); byte(0x80 | condition);
+            imm32(0);
+            return bytes.size() - 4;
+        }
+
+        void patch(size_t position)
+        {
+            const uint32_t displacement = bytes.size() - (position + 4);
+            std::memcpy(&bytes[position], &displacement, 4);
+        }
+
+        void push(uint8_t reg)
+        {
+            rex(false, 0, reg);
+            byte(0x50 + (reg & 7));
+        }
+
+        void pop(uint8_t reg)
+        {
+            rex(false, 0, reg);
+            byte(0x58 + (reg & 7));
+        }
+
+        void call(const void* function)
+        {
+            byte(0x48); byte(0xB8);
+            imm64(reinterpret_cast<uint64_t>(function));
+            byte(0xFF); byte(0xD0);
+        }
+    };
+
+    const uint8_t RAX = 0, RCX = 1, RSP = 4, RSI = 6, RDI = 7, R15 = 15;
+
+    const uint8_t CONDITION_B  = 0x2;
+    const uint8_t CONDITION_E  = 0x4;
+    const uint8_t CONDITION_NE = 0x5;
+    const uint8_t CONDITION_A  = 0x7;
+
+    /**
+     *  Host registers that can hold V registers. rax and rcx are used
+     *  as scratch registers, r15 holds the cpu.
+     */
+    const std::array<uint8_t, 12> jit_registers {{ 3, 5, 12, 13, 14, 2, 6, 7, 8, 9, 10, 11 }};
+
+    /**
+     *  Translates one block, keeping track of which host register holds
+     *  each V register.
+     */
+    struct JitCompiler
+    {
+        Assembler assembler;
+        std::array<int8_t, 16> mapping;
+        std::vector<uint8_t> mapped;
+
+        JitCompiler() : assembler{}, mapping{}, mapped{} { mapping.fill(-1); }
+
+        uint8_t reg(uint8_t v) const { return mapping[v]; }
+
+        static uint32_t v_offset(uint8_t v) { return offsetof(CPU, V) + v; }
+
+        void store_registers()
+        {
+            for(uint8_t v : mapped) assembler.store_byte(v_offset(v), reg(v));
+        }
+
+        void load_registers()
+        {
+            for(uint8_t v : mapped) assembler.load_byte(reg(v), v_offset(v));
+        }
+
+        void add_cycles(uint32_t pending)
+        {
+            if(pending != 0) assembler.add_qword_imm(offsetof(CPU, cycles), pending);
+        }
+
+        void call(uint16_t instruction)
+        {
+            store_registers();
+            // mov rdi, r15.
+            assembler.byte(0x4C); assembler.byte(0x89); assembler.byte(0xFF);
+            assembler.mov_ri(RSI, instruction);
+            assembler.call(reinterpret_cast<const void*>(&jit_call));
+            load_registers();
+        }
+
+        /**
+         *  Set VF to one when the condition holds after comparing a with b.
+         */
+        void set_flag(uint8_t condition, uint8_t a, uint8_t b)
+        {
+            assembler.op_rr(0x31, RCX, RCX);
+            assembler.op_rr(0x39, a, b);
+            assembler.setcc_cl(condition);
+            assembler.op_rr(0x89, reg(0xF), RCX);
+        }
+
+        void emit(const Instruction& instruction)
+        {
+            const uint8_t x = instruction.X;
+            const uint8_t y = instruction.Y;
+
+            switch (instruction.handler)
+            {
+            case OP_0x6:
+                assembler.mov_ri(reg(x), instruction.NN);
+                break;
+            case OP_0x7:
+                assembler.op_ri(0, reg(x), instruction.NN);
+                assembler.op_ri(4, reg(x), 0xFF);
+                break;
+            case OP_0x80:
+                assembler.op_rr(0x89, reg(x), reg(y));
+                break;
+            case OP_0x81:
+                assembler.op_rr(0x09, reg(x), reg(y));
+                break;
+            case OP_0x82:
+                assembler.op_rr(0x21, reg(x), reg(y));
+                break;
+            case OP_0x83:
+                assembler.op_rr(0x31, reg(x), reg(y));
+                break;
+            case OP_0x84:
+                assembler.op_rr(0x89, RAX, reg(x));
+                assembler.op_rr(0x01, RAX, reg(y));
+                assembler.op_rr(0x31, RCX, RCX);
+                assembler.op_ri(7, RAX, 0xFF);
+                assembler.setcc_cl(CONDITION_A);
+                assembler.op_rr(0x89, reg(0xF), RCX);
+                assembler.op_rr(0x01, reg(x), reg(y));
+                assembler.op_ri(4, reg(x), 0xFF);
+                break;
+            case OP_0x85:
+                set_flag(CONDITION_A, reg(x), reg(y));
+                assembler.op_rr(0x29, reg(x), reg(y));
+                assembler.op_ri(4, reg(x), 0xFF);
+                break;
+            case OP_0x86:
+                assembler.op_rr(0x89, RCX, reg(x));
+                assembler.op_ri(4, RCX, 0x1);
+                assembler.op_rr(0x89, reg(0xF), RCX);
+                assembler.shift(5, reg(x), 1);
+                break;
+            case OP_0x87:
+                set_flag(CONDITION_A, reg(y), reg(x));
+                assembler.op_rr(0x89, RAX, reg(y));
+                assembler.op_rr(0x29, RAX, reg(x));
+                assembler.op_ri(4, RAX, 0xFF);
+                assembler.op_rr(0x89, reg(x), RAX);
+                break;
+            case OP_0x8E:
+                assembler.op_rr(0x89, RCX, reg(x));
+                assembler.shift(5, RCX, 7);
+                assembler.op_rr(0x89, reg(0xF), RCX);
+                assembler.shift(4, reg(x), 1);
+                assembler.op_ri(4, reg(x), 0xFF);
+                break;
+            case OP_0xA:
+                assembler.store_word_imm(offsetof(CPU, I), instruction.NNN);
+                break;
+            case OP_0xF1E:
+                assembler.load_word(RAX, offsetof(CPU, I));
+                assembler.op_rr(0x01, RAX, reg(x));
+                assembler.store_word(offsetof(CPU, I), RAX);
+                break;
+            case OP_0xF29:
+                assembler.store_word_imm(offsetof(CPU, I), instruction.op_code.data * 5);
+                break;
+            default:
+                break;
+            }
+        }
+
+        /**
+         *  Emit the last instruction of a block, it leaves the address
+         *  of the next instruction on PC.
+         */
+        void emit_branch(const Instruction& instruction, uint16_t address, uint16_t raw)
+        {
+            size_t skip = 0;
+
+            switch (instruction.handler)
+            {
+            case OP_0x1:
+                assembler.store_word_imm(offsetof(CPU, PC), instruction.NNN + 2);
+                return;
+            case OP_0x3:
+            case OP_0x4:
+                assembler.op_ri(7, reg(instruction.X), instruction.NN);
+                break;
+            case OP_0x50:
+            case OP_0x90:
+                assembler.op_rr(0x39, reg(instruction.X), reg(instruction.Y));
+                break;
+            default:
+                assembler.store_word_imm(offsetof(CPU, PC), address);
+                call(raw);
+                assembler.load_word(RAX, offsetof(CPU, PC));
+                assembler.op_ri(0, RAX, 2);
+                assembler.store_word(offsetof(CPU, PC), RAX);
+                return;
+            }
+
+            const bool skip_if_equal = instruction.handler == OP_0x3 || instruction.handler == OP_0x50;
+
+            assembler.store_word_imm(offsetof(CPU, PC), address + 2);
+            skip = assembler.jcc(skip_if_equal ? CONDITION_NE : CONDITION_E);
+            assembler.store_word_imm(offsetof(CPU, PC), address + 4);
+            assembler.patch(skip);
+        }
+    };
+
+    /**
+     *  V registers read or written by a natively emitted instruction.
+     */
+    static inline uint32_t used_registers(const Instruction& instruction)
+    {
+        switch (instruction.handler)
+        {
+        case OP_0x3: case OP_0x4: case OP_0x6: case OP_0x7: case OP_0xF1E:
+            return 1u << instruction.X;
+        case OP_0x50: case OP_0x80: case OP_0x81: case OP_0x82: case OP_0x83: case OP_0x90:
+            return (1u << instruction.X) | (1u << instruction.Y);
+        case OP_0x84: case OP_0x85: case OP_0x87:
+            return (1u << instruction.X) | (1u << instruction.Y) | (1u << 0xF);
+        case OP_0x86: case OP_0x8E:
+            return (1u << instruction.X) | (1u << 0xF);
+        default:
+            return 0;
+        }
+    }
+
+    static inline uint32_t count_registers(uint32_t registers)
+    {
+        uint32_t count = 0;
+        for(; registers != 0 ; registers &= registers - 1) count++;
+        return count;
+    }
+
+    /**
+     *  Drop every compiled block and its code.
+     *
+     *  @param jit the recompiler that will be emptied.
+     */
+    static inline void flush_jit(Jit& jit)
+    {
+        jit.index.fill(0);
+        jit.hotness.fill(0);
+        jit.blocks.clear();
+        jit.code_used = 0;
+    }
+
+    /**
+     *  Drop every compiled block that overlaps the memory written since
+     *  the last check. Its hotness counter starts again from zero.
+     *
+     *  @param jit the recompiler whose stale blocks will be dropped.
+     *  @param cpu the cpu whose memory has been written.
+     */
+    static inline void invalidate_jit(Jit& jit, CPU& cpu)
+    {
+        for(uint32_t i = 0 ; i < jit.blocks.size() ; i++)
+        {
+            const JitBlock& block = jit.blocks[i];
+
+            if(jit.index[block.start] == i + 1 && block.start < cpu.dirty_end && cpu.dirty_begin < block.end)
+            {
+                jit.index[block.start]   = 0;
+                jit.hotness[block.start] = 0;
+            }
+        }
+
+        clear_dirty(cpu);
+    }
+
+    /**
+     *  Compile the block that starts at an address.
+     *
+     *  @param jit the recompiler where the code will be stored.
+     *  @param cpu the cpu whose memory holds the program.
+     *  @param start the address of the first instruction of the block.
+     *
+     *  @return false if the block could not be compiled.
+     */
+    static inline bool compile(Jit& jit, const CPU& cpu, uint16_t start)
+    {
+#ifdef CHIP8_JIT
+        std::vector<uint16_t> block;
+        uint32_t registers = 0;
+        uint16_t address   = start;
+
+        while(block.size() < MAX_BLOCK_SIZE && static_cast<size_t>(address) + 1 < cpu.memory.size())
+        {
+            const uint16_t     raw         = (cpu.memory[address] << 0x8) | cpu.memory[address + 1];
+            const Instruction& instruction = decode_table()[raw];
+            const uint32_t     used        = registers | used_registers(instruction);
+
+            if(count_registers(used) > jit_registers.size()) break;
+
+            registers = used;
+            block.push_back(raw);
+            address += 2;
+
+            if(is_branch(instruction.handler) || is_memory_write(instruction.handler)) break;
+        }
+
+        if(block.empty()) return false;
+
+        JitCompiler compiler{};
+
+        for(uint8_t v = 0 ; v < 16 ; v++)
+        {
+            if((registers & (1u << v)) == 0) continue;
+
+            compiler.mapping[v] = jit_registers[compiler.mapped.size()];
+            compiler.mapped.push_back(v);
+        }
+
+        Assembler& assembler = compiler.assembler;
+        const std::array<uint8_t, 6> saved {{ 3, 5, 12, 13, 14, 15 }};
+
+        for(uint8_t reg : saved) assembler.push(reg);
+        // sub rsp, 8 keeps the stack aligned to 16 bytes on calls.
+        assembler.byte(0x48); assembler.byte(0x83); assembler.byte(0xEC); assembler.byte(0x08);
+        // mov r15, rdi.
+        assembler.byte(0x49); assembler.byte(0x89); assembler.byte(0xFF);
+
+        compiler.load_registers();
+
+        uint32_t applied = 0;
+        bool     ended   = false;
+
+        for(uint32_t i = 0 ; i < block.size() ; i++)
+        {
+            const Instruction& instruction = decode_table()[block[i]];
+            const uint16_t     at          = start + i * 2;
+
+            if(is_timer_access(instruction.handler))
+            {
+                compiler.add_cycles(i - applied);
+                applied = i;
+            }
+
+            if(is_branch(instruction.handler))
+            {
+                compiler.emit_branch(instruction, at, block[i]);
+                ended = true;
+            }
+            else if(is_native(instruction.handler))
+            {
+                compiler.emit(instruction);
+            }
+            else
+            {
+                compiler.call(block[i]);
+            }
+        }
+
+        if(!ended) assembler.store_word_imm(offsetof(CPU, PC), address);
+
+        compiler.store_registers();
+        compiler.add_cycles(block.size() - applied);
+
+        assembler.byte(0x48); assembler.byte(0x83); assembler.byte(0xC4); assembler.byte(0x08);
+        for(auto reg = saved.rbegin() ; reg != saved.rend() ; reg++) assembler.pop(*reg);
+        assembler.byte(0xC3);
+
+        if(jit.code_used + assembler.bytes.size() > JIT_CODE_SIZE || jit.blocks.size() >= 0xFFFF) flush_jit(jit);
+
+        uint8_t* code = jit.code + jit.code_used;
+
+        mprotect(jit.code, JIT_CODE_SIZE, PROT_READ | PROT_WRITE);
+        std::memcpy(code, assembler.bytes.data(), assembler.bytes.size());
+        mprotect(jit.code, JIT_CODE_SIZE, PROT_READ | PROT_EXEC);
+
+        jit.code_used += (assembler.bytes.size() + 15) & ~static_cast<size_t>(15);
+        jit.blocks.push_back(JitBlock{ start, address, static_cast<uint16_t>(block.size()), reinterpret_cast<void (*)(CPU*)>(code) });
+        jit.index[start] = jit.blocks.size();
+
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     *  Execute the given amount of instructions, running the compiled
+     *  code of every hot block and interpreting the cold ones. Compiled
+     *  blocks are never split so, a block that doesn't fit on the
+     *  instructions left is interpreted too.
+     *
+     *  @param jit the recompiler that holds the compiled blocks.
+     *  @param cpu the cpu that will run the program.
+     *  @param cycles the number of instructions to execute.
+     *
+     *  @return the number of instructions executed, always cycles.
+     */
+    static inline uint64_t run_jit(Jit& jit, CPU& cpu, uint64_t cycles)
+    {
+        uint64_t executed = 0;
+
+        while(executed < cycles)
+        {
+            if(is_dirty(cpu)) invalidate_jit(jit, cpu);
+
+            const uint16_t PC = cpu.PC;
+
+            if(static_cast<size_t>(PC) + 1 >= cpu.memory.size())
+            {
+                executed += interpret_block(cpu, cycles - executed);
+                continue;
+            }
+
+            uint16_t index = jit.index[PC];
+
+            if(index == 0 && ++jit.hotness[PC] >= jit.threshold)
+            {
+                jit.hotness[PC] = 0;
+                if(compile(jit, cpu, PC)) index = jit.index[PC];
+            }
+
+            if(index != 0 && jit.blocks[index - 1].cycles <= cycles - executed)
+            {
+                const JitBlock& block = jit.blocks[index - 1];
+
+                block.code(&cpu);
+                executed += block.cycles;
+            }
+            else
+            {
+                executed += interpret_block(cpu, cycles - executed);
+            }
+        }
+
+        return executed;
+    }
+}
+
+#endif
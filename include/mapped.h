@@ -0,0 +1,104 @@
+#ifndef MAPPED_H
+#define MAPPED_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+/**
+ *  Files are mapped with mmap on unix systems, anywhere else they are
+ *  read into memory.
+ */
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(CHIP8_NO_MMAP)
+#define CHIP8_MMAP 1
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace chip
+{
+    /**
+     *  On this file we present read only files mapped into memory, the
+     *  state files and the traces are read through them. Opening a file
+     *  takes the same time whatever its size and only the pages that
+     *  are touched are ever loaded.
+     */
+    struct MappedFile
+    {
+        /**
+         *  Map a file.
+         *
+         *  @param path the file.
+         *  @param kind what the file holds, for the errors.
+         *  @param sequential whether the file is read once from the start to the end.
+         */
+        MappedFile(const std::string& path, const std::string& kind, bool sequential = false) : data{nullptr}, size{0}
+        {
+#ifdef CHIP8_MMAP
+            const int file = open(path.c_str(), O_RDONLY);
+            if(file < 0) throw std::runtime_error{"Unable to open " + kind + " " + path};
+
+            struct stat status;
+
+            if(fstat(file, &status) != 0)
+            {
+                close(file);
+                throw std::runtime_error{"Unable to read " + kind + " " + path};
+            }
+
+            size = status.st_size;
+
+            if(size > 0)
+            {
+                void* memory = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+
+                if(memory == MAP_FAILED)
+                {
+                    close(file);
+                    throw std::runtime_error{"Unable to map " + kind + " " + path};
+                }
+
+                if(sequential) madvise(memory, size, MADV_SEQUENTIAL);
+
+                data = static_cast<const uint8_t*>(memory);
+            }
+
+            close(file);
+#else
+            (void)sequential;
+
+            std::ifstream file{path.c_str(), std::ios::in | std::ios::binary};
+            if(!file.is_open()) throw std::runtime_error{"Unable to open " + kind + " " + path};
+
+            contents.assign(std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{});
+
+            data = contents.data();
+            size = contents.size();
+#endif
+        }
+
+        ~MappedFile()
+        {
+#ifdef CHIP8_MMAP
+            if(data != nullptr) munmap(const_cast<uint8_t*>(data), size);
+#endif
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const uint8_t* data;
+        size_t size;
+#ifndef CHIP8_MMAP
+        std::vector<uint8_t> contents;
+#endif
+    };
+}
+
+#endif
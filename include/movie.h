@@ -0,0 +1,296 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <algorithm>
+#include <stdexcept>
+
+#include "./cpu.h"
+#include "./batch.h"
+
+namespace chip
+{
+    /**
+     *  On this file we present movies: the input of a session stamped
+     *  with the instruction it was seen on. The timers are derived from
+     *  the number of instructions executed and CXNN draws from a seeded
+     *  generator so, a cpu that starts from the same ROM, clock rate and
+     *  seed and sees the same key pad on the same instructions always
+     *  ends on the same state, whatever the host and however the
+     *  instructions are split in frames.
+     *
+     *  A movie file is the magic number, the version, the seed and the
+     *  hash of the memory the session started with followed by
+     *  variable length integers: the clock rate, the length of the
+     *  session, the number of events and each event as the instructions
+     *  since the previous one and the new key pad. A key pad held for a
+     *  second takes about 4 bytes.
+     */
+
+    const uint32_t MOVIE_MAGIC   = 0x4D384843; // "CH8M"
+    const uint16_t MOVIE_VERSION = 1;
+
+    /**
+     *  State of the key pad from an instruction until the next event.
+     */
+    struct MovieEvent
+    {
+        uint64_t cycle;
+        uint16_t key_pad;
+    };
+
+    struct Movie
+    {
+        uint64_t seed;       // Seed of the random number generator.
+        uint32_t clock_rate; // Instructions per second.
+        uint64_t rom_hash;   // movie_hash() of the memory when the session started.
+        uint64_t length;     // Instructions executed by the session.
+        std::vector<MovieEvent> events;
+    };
+
+    /**
+     *  FNV-1a hash of the memory of a cpu, it tells apart sessions of
+     *  different ROMs.
+     *
+     *  @param cpu the cpu whose memory will be hashed.
+     */
+    static inline uint64_t movie_hash(const CPU& cpu)
+    {
+        uint64_t hash = 0xCBF29CE484222325ULL;
+
+        for(uint8_t value : cpu.memory)
+        {
+            hash ^= value;
+            hash *= 0x100000001B3ULL;
+        }
+
+        return hash;
+    }
+
+    /**
+     *  Seed a cpu and start recording its session. The ROM must be
+     *  loaded and no instruction executed.
+     *
+     *  @param cpu the cpu to be recorded.
+     *  @param seed the seed of the random number generator.
+     *  @param clock_rate instructions per second.
+     *
+     *  @return a movie holding the state of the key pad.
+     */
+    static inline Movie start_movie(CPU& cpu, uint64_t seed, uint32_t clock_rate)
+    {
+        set_clock_rate(cpu, clock_rate);
+        seed_random(cpu, seed);
+
+        return Movie{ seed, clock_rate, movie_hash(cpu), cpu.cycles, { MovieEvent{ cpu.cycles, cpu.key_pad } } };
+    }
+
+    /**
+     *  Record the key pad of a cpu if it changed since the last event,
+     *  call it every time the host sets the key pad and once more when
+     *  the session ends.
+     *
+     *  @param movie the movie being recorded.
+     *  @param cpu the cpu being recorded.
+     */
+    static inline void record_input(Movie& movie, const CPU& cpu)
+    {
+        movie.length = cpu.cycles;
+
+        if(!movie.events.empty() && movie.events.back().key_pad == cpu.key_pad) return;
+
+        movie.events.push_back(MovieEvent{ cpu.cycles, cpu.key_pad });
+    }
+
+    /**
+     *  Drop the events after an instruction, for when the recorded cpu
+     *  is rewound.
+     *
+     *  @param movie the movie being recorded.
+     *  @param cycles the instructions executed by the cpu.
+     */
+    static inline void truncate_movie(Movie& movie, uint64_t cycles)
+    {
+        while(!movie.events.empty() && movie.events.back().cycle > cycles) movie.events.pop_back();
+
+        movie.length = cycles;
+    }
+
+    static inline void write_varint(std::ostream& output, uint64_t value)
+    {
+        while(value >= 0x80)
+        {
+            output.put(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+
+        output.put(static_cast<char>(value));
+    }
+
+    static inline void write_fixed(std::ostream& output, uint64_t value, int bytes)
+    {
+        for(int i = 0 ; i < bytes ; i++) output.put(static_cast<char>((value >> (i * 8)) & 0xFF));
+    }
+
+    static inline uint64_t read_varint(std::istream& input)
+    {
+        uint64_t value = 0;
+
+        for(int shift = 0 ; shift < 64 ; shift += 7)
+        {
+            const int byte = input.get();
+            if(byte == std::char_traits<char>::eof()) throw std::runtime_error{"The movie is truncated"};
+
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+
+            if((byte & 0x80) == 0) return value;
+        }
+
+        throw std::runtime_error{"The movie is corrupted"};
+    }
+
+    static inline uint64_t read_fixed(std::istream& input, int bytes)
+    {
+        uint64_t value = 0;
+
+        for(int i = 0 ; i < bytes ; i++)
+        {
+            const int byte = input.get();
+            if(byte == std::char_traits<char>::eof()) throw std::runtime_error{"The movie is truncated"};
+
+            value |= static_cast<uint64_t>(byte) << (i * 8);
+        }
+
+        return value;
+    }
+
+    /**
+     *  Write a movie, values are stored little endian whatever the
+     *  host.
+     *
+     *  @param output where the movie is written.
+     *  @param movie the movie to be written.
+     */
+    static inline void write_movie(std::ostream& output, const Movie& movie)
+    {
+        write_fixed(output, MOVIE_MAGIC,   4);
+        write_fixed(output, MOVIE_VERSION, 2);
+        write_fixed(output, movie.seed,     8);
+        write_fixed(output, movie.rom_hash, 8);
+
+        write_varint(output, movie.clock_rate);
+        write_varint(output, movie.length);
+        write_varint(output, movie.events.size());
+
+        uint64_t cycle = 0;
+
+        for(const MovieEvent& event : movie.events)
+        {
+            write_varint(output, event.cycle - cycle);
+            write_varint(output, event.key_pad);
+
+            cycle = event.cycle;
+        }
+
+        if(!output) throw std::runtime_error{"Unable to write the movie"};
+    }
+
+    /**
+     *  Read a movie written by write_movie().
+     *
+     *  @param input the movie.
+     */
+    static inline Movie read_movie(std::istream& input)
+    {
+        if(read_fixed(input, 4) != MOVIE_MAGIC) throw std::runtime_error{"The data is not a Chip-8 movie"};
+
+        const uint64_t version = read_fixed(input, 2);
+        if(version != MOVIE_VERSION) throw std::runtime_error{"Unsupported movie version " + std::to_string(version)};
+
+        Movie movie{};
+
+        movie.seed     = read_fixed(input, 8);
+        movie.rom_hash = read_fixed(input, 8);
+
+        const uint64_t clock_rate = read_varint(input);
+        movie.length              = read_varint(input);
+        const uint64_t count      = read_varint(input);
+
+        if(clock_rate < TIMER_RATE || clock_rate > UINT32_MAX) throw std::runtime_error{"The movie has an invalid clock rate"};
+
+        movie.clock_rate = static_cast<uint32_t>(clock_rate);
+
+        // A corrupted count must not allocate more than the events actually read.
+        movie.events.reserve(std::min<uint64_t>(count, 1 << 16));
+
+        uint64_t cycle = 0;
+
+        for(uint64_t i = 0 ; i < count ; i++)
+        {
+            cycle += read_varint(input);
+
+            const uint64_t key_pad = read_varint(input);
+
+            if(key_pad > 0xFFFF || cycle > movie.length) throw std::runtime_error{"The movie is corrupted"};
+
+            movie.events.push_back(MovieEvent{ cycle, static_cast<uint16_t>(key_pad) });
+        }
+
+        return movie;
+    }
+
+    /**
+     *  Prepare a cpu to replay a movie: the clock rate and the seed of
+     *  the session are restored. The ROM must be loaded and no
+     *  instruction executed.
+     *
+     *  @param cpu the cpu that will replay the movie.
+     *  @param movie the movie.
+     */
+    static inline void start_replay(CPU& cpu, const Movie& movie)
+    {
+        if(movie_hash(cpu) != movie.rom_hash) throw std::runtime_error{"The movie was recorded with another ROM"};
+
+        set_clock_rate(cpu, movie.clock_rate);
+        seed_random(cpu, movie.seed);
+    }
+
+    /**
+     *  Execute a number of instructions of a movie, setting the key pad
+     *  on the instruction each event was recorded on.
+     *
+     *  @param cpu the cpu replaying the movie.
+     *  @param movie the movie.
+     *  @param next the first event not applied yet, it starts at 0.
+     *  @param cycles the number of instructions to execute.
+     *  @param observer sees every instruction, see run_batch().
+     *
+     *  @return STOP_FAULT if the observer stopped the run, STOP_BUDGET
+     *          otherwise.
+     */
+    template<typename Observer = NoObserver>
+    static inline StopReason play_movie(CPU& cpu, const Movie& movie, size_t& next, uint64_t cycles, Observer observer = Observer{})
+    {
+        const uint64_t end = cpu.cycles + cycles;
+
+        for(;;)
+        {
+            for(; next < movie.events.size() && movie.events[next].cycle <= cpu.cycles ; next++) cpu.key_pad = movie.events[next].key_pad;
+
+            if(cpu.cycles >= end) break;
+
+            const uint64_t until = next < movie.events.size() ? std::min(end, movie.events[next].cycle) : end;
+
+            if(run_batch(cpu, until - cpu.cycles, false, NoBreakpoint{}, observer).reason == STOP_FAULT) return STOP_FAULT;
+        }
+
+        return STOP_BUDGET;
+    }
+}
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
+#include <iomanip>
+#include <algorithm>
+
+#include "./opcode.h"
+#include "./cpu.h"
+#include "./batch.h"
+#include "./disassembler.h"
+
+namespace chip
+{
+    /**
+     *  On this file we present a profiler that counts the instructions
+     *  executed of each class and at each address. It is an observer
+     *  given to run_batch() so, runs that don't profile keep the
+     *  NoObserver of every other entry point and pay nothing for it.
+     */
+
+    /**
+     *  Instructions executed while profiling. Waiting for a key counts
+     *  the instructions the wait takes, like run_batch() does.
+     */
+    struct Profile
+    {
+        Profile() : handlers{}, addresses{} {}
+
+        std::array<uint64_t, HANDLER_COUNT> handlers; // Executions of each HandlerIndex.
+        std::array<uint64_t, 4096>          addresses; // Executions of the instruction at each address.
+    };
+
+    /**
+     *  Names of the instruction classes ordered by HandlerIndex.
+     */
+    const std::array<const char*, HANDLER_COUNT> handler_names
+    {{
+        "00E0", "00EE", "0NNN", "1NNN", "2NNN", "3XNN", "4XNN", "5XY0",
+        "6XNN", "7XNN", "8XY0", "8XY1", "8XY2", "8XY3", "8XY4", "8XY5",
+        "8XY6", "8XY7", "8XYE", "9XY0", "ANNN", "BNNN", "CXNN", "DXYN",
+        "EX9E", "EXA1", "FX07", "FX0A", "FX15", "FX18", "FX1E", "FX29",
+        "FX33", "FX55", "FX65", "data"
+    }};
+
+    struct ProfileCounter
+    {
+        Profile& profile;
+
+        bool operator()(const CPU& cpu, const CachedInstruction& instruction, uint64_t count) const
+        {
+            profile.handlers[instruction.handler] += count;
+            profile.addresses[cpu.PC & 0xFFF]     += count;
+
+            return false;
+        }
+    };
+
+    /**
+     *  Execute a number of instructions counting each one on a profile.
+     *
+     *  @param cpu the cpu that will run the instructions.
+     *  @param profile where the instructions are counted.
+     *  @param cycles the number of instructions to execute.
+     */
+    static inline RunResult run_profiled(CPU& cpu, Profile& profile, uint64_t cycles)
+    {
+        return run_batch(cpu, cycles, false, NoBreakpoint{}, ProfileCounter{profile});
+    }
+
+    /**
+     *  Assembly of the instruction at an address of the memory of a cpu,
+     *  as it is when the report is written.
+     */
+    static inline std::string disassemble_at(const CPU& cpu, size_t address)
+    {
+        if(address + 1 >= cpu.memory.size()) return "";
+
+        const Instruction& instruction = predecode(cpu.memory, address);
+
+        return disassemblers[instruction.handler] != nullptr ? disassemblers[instruction.handler](instruction.op_code) : "(unknown)";
+    }
+
+    /**
+     *  Write the instruction classes sorted by executions and the
+     *  hottest addresses with their assembly, which makes hot loops
+     *  stand out as runs of addresses with about the same count.
+     *
+     *  @param output where the report is written.
+     *  @param profile the instructions counted.
+     *  @param cpu the cpu that was profiled, used to disassemble the addresses.
+     *  @param top the number of addresses written.
+     */
+    static inline void write_profile(std::ostream& output, const Profile& profile, const CPU& cpu, size_t top = 20)
+    {
+        uint64_t total = 0;
+        for(uint64_t count : profile.handlers) total += count;
+
+        const auto percent = [total](uint64_t count) { return total > 0 ? 100.0 * count / total : 0.0; };
+
+        std::vector<uint16_t> order;
+
+        for(uint16_t handler = 0 ; handler < HANDLER_COUNT ; handler++)
+        {
+            if(profile.handlers[handler] > 0) order.push_back(handler);
+        }
+
+        std::stable_sort(order.begin(), order.end(), [&](uint16_t a, uint16_t b) { return profile.handlers[a] > profile.handlers[b]; });
+
+        output << std::setfill(' ') << "Instructions: " << total << "\n\n";
+        output << "Class  " << std::setw(14) << "Count" << std::setw(8) << "%" << "\n";
+
+        for(uint16_t handler : order)
+        {
+            output << std::left << std::setw(7) << handler_names[handler] << std::right
+                   << std::setw(14) << profile.handlers[handler]
+                   << std::setw(8) << std::fixed << std::setprecision(2) << percent(profile.handlers[handler]) << "\n";
+        }
+
+        order.clear();
+
+        for(uint16_t address = 0 ; address < profile.addresses.size() ; address++)
+        {
+            if(profile.addresses[address] > 0) order.push_back(address);
+        }
+
+        std::stable_sort(order.begin(), order.end(), [&](uint16_t a, uint16_t b) { return profile.addresses[a] > profile.addresses[b]; });
+
+        if(order.size() > top) order.resize(top);
+
+        output << "\nAddress" << std::setw(14) << "Count" << std::setw(8) << "%" << "  Instruction\n";
+
+        for(uint16_t address : order)
+        {
+            output << "0x" << std::hex << std::uppercase << std::setw(3) << std::setfill('0') << address
+                   << std::dec << std::nouppercase << std::setfill(' ') << "  "
+                   << std::setw(14) << profile.addresses[address]
+                   << std::setw(8) << std::fixed << std::setprecision(2) << percent(profile.addresses[address])
+                   << "  " << disassemble_at(cpu, address) << "\n";
+        }
+    }
+}
+
+#endif
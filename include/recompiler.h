@@ -0,0 +1,321 @@
+#ifndef RECOMPILER_H
+#define RECOMPILER_H
+
+#include <map>
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <ostream>
+#include <sstream>
+#include <iomanip>
+
+#include "./opcode.h"
+#include "./cpu.h"
+#include "./block.h"
+
+namespace chip
+{
+    /**
+     *  On this file we present a static recompiler that translates a
+     *  ROM into a C++ translation unit ahead of time, together with the
+     *  runtime that executes the translated code.
+     *
+     *  Starting at ROM_START, every instruction that can be reached by
+     *  following jumps, calls, returns and skips is split into basic
+     *  blocks and, each block becomes a function that calls the handlers
+     *  with constant OpCodes so the compiler can inline them. Addresses
+     *  that can't be known ahead of time (BNNN) and blocks overwritten
+     *  by the program run on the interpreter instead.
+     */
+
+    /**
+     *  A block translated ahead of time, covering [start, end).
+     */
+    struct RecompiledBlock
+    {
+        uint16_t start;
+        uint16_t end;
+        uint16_t cycles;
+        void (*run)(CPU& cpu);
+    };
+
+    /**
+     *  Everything emitted by the recompiler: the ROM it was generated
+     *  from and its blocks.
+     */
+    struct RecompiledProgram
+    {
+        std::vector<uint8_t> rom;
+        std::vector<RecompiledBlock> blocks;
+    };
+
+    /**
+     *  Translated blocks indexed by their start address for a cpu
+     *  running a recompiled program.
+     */
+    struct Recompiled
+    {
+        Recompiled() : index{} {}
+        std::array<const RecompiledBlock*, 4096> index;
+    };
+
+    /**
+     *  Handler names ordered by HandlerIndex, used to emit the calls.
+     */
+    const std::array<const char*, HANDLER_COUNT> handler_names
+    {{
+        "op_code_0xE0",  "op_code_0xEE",  "op_code_0x0",   "op_code_0x1",   "op_code_0x2",   "op_code_0x3",   "op_code_0x4",   "op_code_0x50",
+        "op_code_0x6",   "op_code_0x7",   "op_code_0x80",  "op_code_0x81",  "op_code_0x82",  "op_code_0x83",  "op_code_0x84",  "op_code_0x85",
+        "op_code_0x86",  "op_code_0x87",  "op_code_0x8E",  "op_code_0x90",  "op_code_0xA",   "op_code_0xB",   "op_code_0xC",   "op_code_0xD",
+        "op_code_0xE9E", "op_code_0xEA1", "op_code_0xF07", "op_code_0xF0A", "op_code_0xF15", "op_code_0xF18", "op_code_0xF1E", "op_code_0xF29",
+        "op_code_0xF33", "op_code_0xF55", "op_code_0xF65", "op_code_0x0"
+    }};
+
+    /**
+     *  Follow every reachable instruction from ROM_START and split them
+     *  into basic blocks, using the same rules as the block backend.
+     *
+     *  @param cpu a cpu with the ROM already loaded.
+     *
+     *  @return the end address of every block indexed by its start address.
+     */
+    static inline std::map<uint16_t, uint16_t> find_blocks(const CPU& cpu)
+    {
+        std::map<uint16_t, uint16_t> blocks;
+        std::vector<uint16_t> pending { ROM_START };
+
+        while(!pending.empty())
+        {
+            const uint16_t start = pending.back();
+            pending.pop_back();
+
+            if(blocks.count(start) != 0 || static_cast<size_t>(start) + 1 >= cpu.memory.size()) continue;
+
+            uint16_t address = start;
+            uint16_t size    = 0;
+            bool     ended   = false;
+
+            while(size < MAX_BLOCK_SIZE && static_cast<size_t>(address) + 1 < cpu.memory.size())
+            {
+                const Instruction& instruction = predecode(cpu.memory, address);
+
+                address += 2;
+                size    += 1;
+
+                if(is_memory_write(instruction.handler)) break;
+                if(!is_branch(instruction.handler)) continue;
+
+                ended = true;
+
+                switch (instruction.handler)
+                {
+                case OP_0x1:
+                    // cycle() adds two to PC after the jump.
+                    pending.push_back(instruction.NNN + 2);
+                    break;
+                case OP_0x2:
+                    pending.push_back(instruction.NNN);
+                    pending.push_back(address);
+                    break;
+                case OP_0xF0A:
+                    pending.push_back(address - 2);
+                    pending.push_back(address);
+                    break;
+                case OP_0x3:
+                case OP_0x4:
+                case OP_0x50:
+                case OP_0x90:
+                case OP_0xE9E:
+                case OP_0xEA1:
+                    pending.push_back(address);
+                    pending.push_back(address + 2);
+                    break;
+                default:
+                    // 00EE returns to the address after its call and BNNN is computed.
+                    break;
+                }
+                break;
+            }
+
+            if(!ended) pending.push_back(address);
+
+            blocks[start] = address;
+        }
+
+        return blocks;
+    }
+
+    /**
+     *  Emit a C++ translation unit with one function per basic block
+     *  and the RecompiledProgram that describes them.
+     *
+     *  @param rom the bytes of the ROM.
+     *  @param source the path of the ROM, only used on comments.
+     *  @param output where the source code is written.
+     */
+    static inline void recompile(const std::vector<uint8_t>& rom, const std::string& source, std::ostream& output)
+    {
+        CPU cpu{};
+        load_font_set(cpu);
+
+        for(uint32_t i = 0 ; i < rom.size() && ROM_START + i < cpu.memory.size() ; i++) cpu.memory[ROM_START + i] = rom[i];
+
+        const std::map<uint16_t, uint16_t> blocks = find_blocks(cpu);
+
+        output << "// Generated by chip8-recompile from " << source << ", do not edit.\n";
+        output << "#include \"recompiler.h\"\n\n";
+        output << "namespace\n{\n";
+        output << std::hex;
+
+        for(const auto& block : blocks)
+        {
+            output << "    void block_0x" << block.first << "(chip::CPU& cpu)\n    {\n";
+            uint16_t applied = block.first;
+            bool     branch  = false;
+
+            for(uint16_t address = block.first ; address < block.second ; address += 2)
+            {
+                const Instruction& instruction = predecode(cpu.memory, address);
+                const std::string  call        = std::string{"chip::"} + handler_names[instruction.handler];
+
+                std::ostringstream op_code;
+                op_code << std::hex << "chip::OpCode{ 0x" << instruction.op_code.code << ", 0x" << instruction.op_code.data << " }";
+
+                output << "        // 0x" << address << "\n";
+
+                if(is_timer_access(instruction.handler) && address != applied)
+                {
+                    output << "        cpu.cycles += " << std::dec << (address - applied) / 2 << std::hex << ";\n";
+                    applied = address;
+                }
+
+                if(is_branch(instruction.handler))
+                {
+                    output << "        cpu.PC = 0x" << address << ";\n";
+                    output << "        " << call << "(cpu, " << op_code.str() << ");\n";
+                    output << "        cpu.PC += 2;\n";
+                }
+                else
+                {
+                    output << "        " << call << "(cpu, " << op_code.str() << ");\n";
+                }
+
+                branch = is_branch(instruction.handler);
+            }
+
+            if(!branch) output << "        cpu.PC = 0x" << block.second << ";\n";
+
+            output << "        cpu.cycles += " << std::dec << (block.second - applied) / 2 << std::hex << ";\n";
+            output << "    }\n\n";
+        }
+
+        output << "}\n\n";
+        output << "namespace chip\n{\n";
+        output << "    extern const RecompiledProgram recompiled_program;\n\n";
+        output << "    const RecompiledProgram recompiled_program\n    {\n";
+        output << "        {";
+
+        for(uint32_t i = 0 ; i < rom.size() ; i++)
+        {
+            if(i % 16 == 0) output << "\n            ";
+            output << "0x" << std::setw(2) << std::setfill('0') << static_cast<int>(rom[i]) << ", ";
+        }
+
+        output << "\n        },\n        {\n";
+
+        for(const auto& block : blocks)
+        {
+            output << "            { 0x" << block.first << ", 0x" << block.second << ", " << std::dec
+                   << (block.second - block.first) / 2 << std::hex << ", block_0x" << block.first << " },\n";
+        }
+
+        output << "        }\n    };\n}\n";
+        output << std::dec;
+    }
+
+    /**
+     *  Index the blocks of a recompiled program. If the memory of the
+     *  cpu doesn't hold the ROM the program was generated from, no
+     *  block is indexed and everything runs on the interpreter.
+     *
+     *  Loading the ROM left the memory of the cpu dirty, once it is
+     *  known to match the program the dirty range is cleared, else the
+     *  first run would drop every block.
+     *
+     *  @param program the recompiled program.
+     *  @param cpu the cpu that will run the program.
+     */
+    static inline Recompiled make_recompiled(const RecompiledProgram& program, CPU& cpu)
+    {
+        Recompiled result{};
+
+        for(uint32_t i = 0 ; i < program.rom.size() ; i++)
+        {
+            if(ROM_START + i >= cpu.memory.size() || cpu.memory[ROM_START + i] != program.rom[i]) return result;
+        }
+
+        for(const RecompiledBlock& block : program.blocks) result.index[block.start] = &block;
+
+        clear_dirty(cpu);
+
+        return result;
+    }
+
+    /**
+     *  Drop every recompiled block that overlaps the memory written by
+     *  the program, those addresses run on the interpreter from now on.
+     *
+     *  @param recompiled the index of recompiled blocks.
+     *  @param cpu the cpu whose memory has been written.
+     */
+    static inline void invalidate_recompiled(Recompiled& recompiled, CPU& cpu)
+    {
+        for(uint32_t i = 0 ; i < recompiled.index.size() ; i++)
+        {
+            const RecompiledBlock* block = recompiled.index[i];
+
+            if(block != nullptr && block->start < cpu.dirty_end && cpu.dirty_begin < block->end) recompiled.index[i] = nullptr;
+        }
+
+        clear_dirty(cpu);
+    }
+
+    /**
+     *  Execute at least the given amount of instructions, running the
+     *  recompiled blocks and interpreting any address the recompiler
+     *  did not see.
+     *
+     *  @param recompiled the index of recompiled blocks.
+     *  @param cpu the cpu that will run the program.
+     *  @param cycles the number of instructions to execute.
+     *
+     *  @return the number of instructions executed, it can be greater
+     *          than cycles because blocks are never split.
+     */
+    static inline uint64_t run_recompiled(Recompiled& recompiled, CPU& cpu, uint64_t cycles)
+    {
+        uint64_t executed = 0;
+
+        while(executed < cycles)
+        {
+            if(is_dirty(cpu)) invalidate_recompiled(recompiled, cpu);
+
+            const RecompiledBlock* block = recompiled.index[cpu.PC & 0xFFF];
+
+            if(block != nullptr && block->start == cpu.PC)
+            {
+                block->run(cpu);
+                executed += block->cycles;
+            }
+            else
+            {
+                executed += interpret_block(cpu, cycles - executed);
+            }
+        }
+
+        return executed;
+    }
+}
+
+#endif
@@ -0,0 +1,338 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <array>
+#include <bitset>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
+#include <iomanip>
+
+#include "./opcode.h"
+#include "./cpu.h"
+#include "./batch.h"
+#include "./disassembler.h"
+
+namespace chip
+{
+    /**
+     *  On this file we present a flight recorder: a ring buffer with the
+     *  address and the instruction of the last instructions a cpu
+     *  executed. It is an observer given to run_batch() that also looks
+     *  for faults before the instructions that can have one.
+     *
+     *  A call with a full stack or a return with an empty one would
+     *  index the stack out of its bounds so, the run stops before them
+     *  and the recorder ends on the instructions that led to the fault.
+     *  Any other fault is harmless, like an unknown instruction which
+     *  does nothing: the recorder is written once per address and the
+     *  run goes on, unless the recorder is told to halt on every fault.
+     *
+     *  Recording is a store and an increment per instruction so, it is
+     *  cheap enough to leave on. The register each instruction wrote is
+     *  only worked out when the recorder is written, its value is read
+     *  from the cpu when no later instruction wrote the register again.
+     */
+
+    /**
+     *  Instructions kept, a power of two.
+     */
+    const size_t FLIGHT_RECORDER_SIZE = 256;
+
+    static_assert((FLIGHT_RECORDER_SIZE & (FLIGHT_RECORDER_SIZE - 1)) == 0, "The recorder is indexed with a mask");
+
+    enum Fault : uint8_t
+    {
+        FAULT_NONE,
+        FAULT_STACK_OVERFLOW,    // A call with the 16 levels of the stack in use.
+        FAULT_STACK_UNDERFLOW,   // A return with an empty stack.
+        FAULT_PC_OUTSIDE_MEMORY, // The next instruction doesn't fit in memory.
+        FAULT_UNKNOWN_OPCODE     // The next instruction doesn't match any OpCode.
+    };
+
+    const std::array<const char*, 5> fault_names
+    {{
+        "none", "stack overflow", "stack underflow", "PC outside memory", "unknown instruction"
+    }};
+
+    /**
+     *  Registers an instruction can write, indexes below 16 are V0 to VF.
+     */
+    const uint8_t REGISTER_I    = 0x10;
+    const uint8_t REGISTER_VX   = 0x20; // Resolved to the X of the instruction.
+    const uint8_t REGISTER_NONE = 0xFF;
+
+    /**
+     *  Register written by the instructions of each HandlerIndex, the
+     *  one shown by the recorder. The flag written by 8XY4 to 8XYE is
+     *  left out in favour of VX.
+     */
+    const std::array<uint8_t, HANDLER_COUNT> written_registers
+    {{
+        REGISTER_NONE, REGISTER_NONE, REGISTER_NONE, REGISTER_NONE, REGISTER_NONE, REGISTER_NONE, REGISTER_NONE, REGISTER_NONE,
+        REGISTER_VX,   REGISTER_VX,   REGISTER_VX,   REGISTER_VX,   REGISTER_VX,   REGISTER_VX,   REGISTER_VX,   REGISTER_VX,
+        REGISTER_VX,   REGISTER_VX,   REGISTER_VX,   REGISTER_NONE, REGISTER_I,    REGISTER_NONE, REGISTER_VX,   0xF,
+        REGISTER_NONE, REGISTER_NONE, REGISTER_VX,   REGISTER_VX,   REGISTER_NONE, REGISTER_NONE, REGISTER_I,    REGISTER_I,
+        REGISTER_NONE, REGISTER_NONE, REGISTER_VX,   REGISTER_NONE
+    }};
+
+    /**
+     *  Every register an instruction writes, bits 0 to 15 are V0 to VF
+     *  and bit 16 is I.
+     *
+     *  @param handler the HandlerIndex of the instruction.
+     *  @param op_code the instruction, as stored on memory.
+     */
+    static inline uint32_t written_mask(uint8_t handler, uint16_t op_code)
+    {
+        const uint8_t x = (op_code >> 8) & 0xF;
+
+        switch(handler)
+        {
+        case OP_0x84:
+        case OP_0x85:
+        case OP_0x86:
+        case OP_0x87:
+        case OP_0x8E:
+            return (1u << x) | (1u << 0xF);
+        case OP_0xF65:
+            return (2u << x) - 1;
+        default:
+            break;
+        }
+
+        const uint8_t written = written_registers[handler];
+
+        if(written == REGISTER_NONE) return 0x0;
+
+        return 1u << (written == REGISTER_VX ? x : written);
+    }
+
+    struct TraceEntry
+    {
+        uint16_t PC;
+        uint16_t op_code; // Raw instruction, as stored on memory.
+    };
+
+    struct FlightRecorder
+    {
+        explicit FlightRecorder(std::ostream* output = nullptr, bool halt_on_fault = false) :
+                                entries{}, count{0}, fault{FAULT_NONE}, halt_on_fault{halt_on_fault}, output{output}, reported{} {}
+
+        std::array<TraceEntry, FLIGHT_RECORDER_SIZE> entries;
+        uint64_t count; // Instructions recorded, the newest one is at (count - 1) % FLIGHT_RECORDER_SIZE.
+        Fault    fault; // Why the last run was stopped, FAULT_NONE if it wasn't.
+        bool     halt_on_fault; // Stop the run on every fault, not only on the ones that can't run.
+        std::ostream* output;   // Where the faults that don't stop the run are written, nullptr to skip them.
+        std::bitset<4096> reported; // Addresses whose fault has been written already.
+    };
+
+    static inline uint16_t register_value(const CPU& cpu, uint8_t reg)
+    {
+        return reg == REGISTER_I ? cpu.I : cpu.V[reg & 0xF];
+    }
+
+    /**
+     *  The register written by a recorded instruction and the value it
+     *  left, if the cpu still holds it.
+     */
+    struct RecordedWrite
+    {
+        uint8_t  reg;   // Register written, REGISTER_NONE if there is none.
+        bool     known; // No later instruction wrote the register so, value is its result.
+        uint16_t value;
+    };
+
+    /**
+     *  Find the register written by each instruction of a flight
+     *  recorder, going from the newest instruction to the oldest one.
+     *  A register keeps the value of the last instruction that wrote
+     *  it so, older instructions writing it have no known value.
+     *
+     *  @param recorder the flight recorder.
+     *  @param cpu the cpu that was recorded.
+     *
+     *  @return the writes, at the same position as their instruction.
+     */
+    static inline std::array<RecordedWrite, FLIGHT_RECORDER_SIZE> resolve_writes(const FlightRecorder& recorder, const CPU& cpu)
+    {
+        const size_t   MASK  = FLIGHT_RECORDER_SIZE - 1;
+        const uint64_t first = recorder.count > FLIGHT_RECORDER_SIZE ? recorder.count - FLIGHT_RECORDER_SIZE : 0;
+
+        std::array<RecordedWrite, FLIGHT_RECORDER_SIZE> writes{};
+
+        uint32_t current = 0x1FFFF; // Registers still holding the value of the instructions seen so far.
+
+        for(uint64_t i = recorder.count ; i-- > first ; )
+        {
+            const TraceEntry& entry   = recorder.entries[i & MASK];
+            const uint8_t     handler = decode_table()[entry.op_code].handler;
+            const uint8_t     written = written_registers[handler];
+            const uint8_t     reg     = written == REGISTER_VX ? (entry.op_code >> 8) & 0xF : written;
+            const bool        known   = reg != REGISTER_NONE && (current & (1u << reg)) != 0;
+
+            writes[i & MASK] = RecordedWrite{ reg, known, known ? register_value(cpu, reg) : static_cast<uint16_t>(0x0) };
+
+            current &= ~written_mask(handler, entry.op_code);
+        }
+
+        return writes;
+    }
+
+    /**
+     *  Find out if an instruction can't run on the current state of a
+     *  cpu.
+     *
+     *  @param cpu the cpu that is about to run the instruction.
+     *  @param instruction the instruction at the PC of the cpu.
+     */
+    static inline Fault find_fault(const CPU& cpu, const CachedInstruction& instruction)
+    {
+        if(static_cast<size_t>(cpu.PC) + 1 >= cpu.memory.size())         return FAULT_PC_OUTSIDE_MEMORY;
+        if(instruction.handler == OP_UNKNOWN)                             return FAULT_UNKNOWN_OPCODE;
+        if(instruction.handler == OP_0x2  && cpu.SP >= cpu.stack.size()) return FAULT_STACK_OVERFLOW;
+        if(instruction.handler == OP_0xEE && cpu.SP == 0)                 return FAULT_STACK_UNDERFLOW;
+
+        return FAULT_NONE;
+    }
+
+    /**
+     *  Check if a fault can't be run past: the call or the return would
+     *  index the stack out of its bounds.
+     */
+    static inline bool is_fatal(Fault fault)
+    {
+        return fault == FAULT_STACK_OVERFLOW || fault == FAULT_STACK_UNDERFLOW;
+    }
+
+    /**
+     *  Instruction classes that can fault or wait, every other one is
+     *  recorded without looking further.
+     */
+    const std::array<bool, HANDLER_COUNT> checked_handlers
+    {{
+        false, true,  false, false, true,  false, false, false,
+        false, false, false, false, false, false, false, false,
+        false, false, false, false, false, false, false, false,
+        false, false, false, true,  false, false, false, false,
+        false, false, false, true
+    }};
+
+    /**
+     *  Write the instructions of a flight recorder from the oldest to
+     *  the newest one, and the fault that stopped the cpu if any.
+     *
+     *  @param output where the instructions are written.
+     *  @param recorder the flight recorder.
+     *  @param cpu the cpu that was recorded, the registers are read
+     *             from it, see resolve_writes().
+     */
+    static inline void write_flight_recorder(std::ostream& output, const FlightRecorder& recorder, const CPU& cpu)
+    {
+        const size_t   MASK  = FLIGHT_RECORDER_SIZE - 1;
+        const uint64_t first = recorder.count > FLIGHT_RECORDER_SIZE ? recorder.count - FLIGHT_RECORDER_SIZE : 0;
+
+        const auto hex = [&output](uint32_t value, int digits) -> std::ostream&
+        {
+            return output << std::hex << std::uppercase << std::setw(digits) << std::setfill('0') << value << std::dec << std::nouppercase << std::setfill(' ');
+        };
+
+        output << std::dec << std::setfill(' ');
+
+        if(recorder.fault != FAULT_NONE)
+        {
+            output << "Fault: " << fault_names[recorder.fault] << " at 0x";
+            hex(cpu.PC, 3) << " (";
+            hex(fetch(cpu), 4) << ")\n";
+        }
+
+        output << "Last " << recorder.count - first << " of " << recorder.count << " instructions: \n";
+
+        const std::array<RecordedWrite, FLIGHT_RECORDER_SIZE> writes = resolve_writes(recorder, cpu);
+
+        for(uint64_t i = first ; i < recorder.count ; i++)
+        {
+            const TraceEntry&  entry       = recorder.entries[i & MASK];
+            const Instruction& instruction = decode_table()[entry.op_code];
+            const Disassembler disassemble = disassemblers[instruction.handler];
+
+            output << std::setw(10) << i << "  0x";
+            hex(entry.PC, 3) << "  ";
+            hex(entry.op_code, 4) << "  ";
+
+            const std::string assembly = disassemble != nullptr ? disassemble(instruction.op_code) : "(unknown)";
+
+            const RecordedWrite& write = writes[i & MASK];
+
+            if(write.reg == REGISTER_NONE) output << assembly;
+            else
+            {
+                output << std::left << std::setw(24) << assembly << std::right;
+
+                if(write.reg == REGISTER_I) output << "I = 0x";
+                else                        output << "V" << std::hex << std::uppercase << static_cast<int>(write.reg) << std::dec << std::nouppercase << " = 0x";
+
+                if(write.known) hex(write.value, write.reg == REGISTER_I ? 3 : 2);
+                else            output << (write.reg == REGISTER_I ? "???" : "??"); // Overwritten by a later instruction.
+            }
+
+            output << "\n";
+        }
+    }
+
+    struct FlightObserver
+    {
+        FlightRecorder& recorder;
+
+        bool operator()(const CPU& cpu, const CachedInstruction& instruction, uint64_t) const
+        {
+            const size_t MASK = FLIGHT_RECORDER_SIZE - 1;
+
+            if(static_cast<size_t>(cpu.PC) + 1 >= cpu.memory.size() || checked_handlers[instruction.handler])
+            {
+                const Fault fault = find_fault(cpu, instruction);
+
+                if(fault != FAULT_NONE && (recorder.halt_on_fault || is_fatal(fault)))
+                {
+                    recorder.fault = fault;
+                    return true;
+                }
+
+                if(fault != FAULT_NONE && recorder.output != nullptr && !recorder.reported[cpu.PC & 0xFFF])
+                {
+                    recorder.fault = fault;
+                    recorder.reported.set(cpu.PC & 0xFFF);
+
+                    write_flight_recorder(*recorder.output, recorder, cpu);
+                    *recorder.output << std::endl;
+
+                    recorder.fault = FAULT_NONE;
+                }
+
+                // Waiting for a key doesn't execute FX0A, it is recorded once a key is pressed.
+                if(instruction.handler == OP_0xF0A && cpu.key_pad == 0) return false;
+            }
+
+            recorder.entries[recorder.count & MASK] = TraceEntry{ cpu.PC, fetch(cpu) };
+            recorder.count += 1;
+
+            return false;
+        }
+    };
+
+    /**
+     *  Execute a number of instructions keeping the last ones on a
+     *  flight recorder.
+     *
+     *  @param cpu the cpu that will run the instructions.
+     *  @param recorder where the instructions are recorded.
+     *  @param cycles the number of instructions to execute.
+     */
+    static inline RunResult run_recorded(CPU& cpu, FlightRecorder& recorder, uint64_t cycles)
+    {
+        return run_batch(cpu, cycles, false, NoBreakpoint{}, FlightObserver{recorder});
+    }
+}
+
+#endif
@@ -0,0 +1,358 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <array>
+#include <deque>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include "./cpu.h"
+#include "./state.h"
+
+namespace chip
+{
+    /**
+     *  On this file we present the history used to rewind a program
+     *  one frame at a time.
+     *
+     *  Every frame the payload of a snapshot (see state.h) is compared
+     *  a word at a time with the last keyframe and only the runs of
+     *  words that differ are stored, which are a few registers, screen
+     *  rows and memory bytes per frame. Only the pages of memory written
+     *  since the keyframe, which invalidate() marks on the cpu, are
+     *  copied and compared. A frame is restored by copying its keyframe
+     *  and then its runs so, going back is as cheap as going forward.
+     *  The oldest keyframes and their frames are dropped to keep the
+     *  history under a memory budget.
+     */
+
+    /**
+     *  About 60 seconds of history of most programs.
+     */
+    const size_t   REWIND_BUDGET            = 1 << 20;
+    const uint32_t REWIND_KEYFRAME_INTERVAL = 60;
+
+    const size_t PAYLOAD_WORDS = sizeof(StatePayload) / sizeof(uint64_t);
+
+    /**
+     *  Words of the payload before and after memory, the ones at the
+     *  edges hold bytes of memory too.
+     */
+    const size_t MEMORY_BEGIN_WORD = offsetof(StatePayload, memory) / sizeof(uint64_t);
+    const size_t MEMORY_END_WORD   = (offsetof(StatePayload, memory) + sizeof(StatePayload::memory) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    static_assert(sizeof(StatePayload) % sizeof(uint64_t) == 0, "The payload is compared a word at a time");
+
+    /**
+     *  A keyframe holds every word of the payload, any other frame holds
+     *  the runs of words that differ from the keyframe before it, each
+     *  run starts with a word holding the number of equal words skipped
+     *  on the upper half and the length of the run on the lower half.
+     */
+    struct RewindFrame
+    {
+        bool keyframe;
+        std::vector<uint64_t> words;
+    };
+
+    struct RewindBuffer
+    {
+        explicit RewindBuffer(size_t budget = REWIND_BUDGET, uint32_t keyframe_interval = REWIND_KEYFRAME_INTERVAL) :
+                              budget{budget}, keyframe_interval{keyframe_interval}, used{0}, since_keyframe{0}, pages{0},
+                              frames{}, keyframe{}, current{}, runs{}
+        {
+            runs.reserve(PAYLOAD_WORDS);
+        }
+
+        size_t   budget;            // Bytes the frames may take.
+        uint32_t keyframe_interval; // Frames stored after a keyframe before the next one.
+        size_t   used;              // Bytes taken by the frames.
+        uint32_t since_keyframe;    // Frames stored after the newest keyframe.
+        uint64_t pages;             // Pages of memory written since the newest keyframe, one bit each.
+        std::deque<RewindFrame> frames;
+        StatePayload keyframe;      // Payload of the newest keyframe.
+        StatePayload current;       // Payload last stored or restored, its memory is updated a page at a time.
+        std::vector<uint64_t> runs; // Scratch space for the runs being encoded.
+    };
+
+    static inline size_t frame_size(const RewindFrame& frame)
+    {
+        return sizeof(RewindFrame) + frame.words.size() * sizeof(uint64_t);
+    }
+
+    static inline uint64_t payload_word(const StatePayload& payload, size_t index)
+    {
+        uint64_t word;
+        std::memcpy(&word, reinterpret_cast<const uint8_t*>(&payload) + index * sizeof(uint64_t), sizeof(word));
+        return word;
+    }
+
+    /**
+     *  Check if a cache line of a payload, 8 words from the given one,
+     *  is equal on both payloads. The words are compared without
+     *  branches.
+     */
+    static inline bool equal_line(const StatePayload& keyframe, const StatePayload& payload, size_t index)
+    {
+        uint64_t differ = 0x0;
+
+        for(size_t i = index ; i < index + 8 ; i++) differ |= payload_word(payload, i) ^ payload_word(keyframe, i);
+
+        return differ == 0x0;
+    }
+
+    /**
+     *  Find the runs of words of a range of a payload that differ from
+     *  a keyframe. Most of the payload doesn't change so, it is skipped
+     *  a cache line at a time.
+     *
+     *  @param keyframe the payload the runs are relative to.
+     *  @param payload the payload to be encoded.
+     *  @param begin the first word of the range.
+     *  @param end one past the last word of the range.
+     *  @param position one past the last word of the previous run, it is
+     *                  moved past the runs found.
+     *  @param runs where the runs are appended.
+     */
+    static inline void encode_range(const StatePayload& keyframe, const StatePayload& payload, size_t begin, size_t end,
+                                    size_t& position, std::vector<uint64_t>& runs)
+    {
+        size_t i = begin;
+
+        while(i < end)
+        {
+            while(i + 8 <= end && equal_line(keyframe, payload, i)) i += 8;
+            while(i < end && payload_word(payload, i) == payload_word(keyframe, i)) i++;
+
+            if(i == end) break;
+
+            const size_t first  = i;
+            const size_t header = runs.size();
+
+            runs.push_back(0x0);
+            for( ; i < end && payload_word(payload, i) != payload_word(keyframe, i) ; i++) runs.push_back(payload_word(payload, i));
+
+            runs[header] = (static_cast<uint64_t>(first - position) << 32) | (i - first);
+            position     = i;
+        }
+    }
+
+    /**
+     *  Find the runs of words of a payload that differ from a keyframe.
+     *
+     *  @param keyframe the payload the runs are relative to.
+     *  @param payload the payload to be encoded.
+     *  @param runs where the runs are stored.
+     */
+    static inline void encode_runs(const StatePayload& keyframe, const StatePayload& payload, std::vector<uint64_t>& runs)
+    {
+        size_t position = 0;
+
+        runs.clear();
+        encode_range(keyframe, payload, 0, PAYLOAD_WORDS, position, runs);
+    }
+
+    /**
+     *  Same as encode_runs() when memory only differs from the keyframe
+     *  on some pages, the rest of memory is not compared.
+     *
+     *  @param keyframe the payload the runs are relative to.
+     *  @param payload the payload to be encoded.
+     *  @param pages the pages of memory that may differ, one bit each.
+     *  @param runs where the runs are stored.
+     */
+    static inline void encode_pages(const StatePayload& keyframe, const StatePayload& payload, uint64_t pages, std::vector<uint64_t>& runs)
+    {
+        const size_t memory = offsetof(StatePayload, memory);
+
+        size_t position = 0;
+        size_t begin    = 0;
+        size_t end      = MEMORY_BEGIN_WORD + 1;
+
+        runs.clear();
+
+        // Neighbour pages share a word so, their ranges are merged.
+        for(uint64_t m = pages ; m != 0 ; m &= m - 1)
+        {
+            const size_t page       = __builtin_ctzll(m);
+            const size_t page_begin = (memory + page * 64) / 8;
+            const size_t page_end   = (memory + page * 64 + 64 + 7) / 8;
+
+            if(page_begin > end)
+            {
+                encode_range(keyframe, payload, begin, end, position, runs);
+                begin = page_begin;
+            }
+
+            end = page_end;
+        }
+
+        if(MEMORY_END_WORD - 1 > end)
+        {
+            encode_range(keyframe, payload, begin, end, position, runs);
+            begin = MEMORY_END_WORD - 1;
+        }
+
+        encode_range(keyframe, payload, begin, PAYLOAD_WORDS, position, runs);
+    }
+
+    /**
+     *  Write the runs of a frame over the payload of its keyframe.
+     *
+     *  @param runs the runs of the frame.
+     *  @param payload the payload of the keyframe, it becomes the payload of the frame.
+     */
+    static inline void decode_runs(const std::vector<uint64_t>& runs, StatePayload& payload)
+    {
+        uint8_t* bytes    = reinterpret_cast<uint8_t*>(&payload);
+        size_t   position = 0;
+
+        for(size_t i = 0 ; i < runs.size() ; )
+        {
+            const size_t skip   = runs[i] >> 32;
+            const size_t length = runs[i] & 0xFFFFFFFF;
+
+            position += skip;
+            std::memcpy(bytes + position * 8, &runs[i + 1], length * 8);
+
+            position += length;
+            i        += length + 1;
+        }
+    }
+
+    static inline void copy_keyframe(const RewindFrame& frame, StatePayload& payload)
+    {
+        std::memcpy(&payload, frame.words.data(), sizeof(payload));
+    }
+
+    /**
+     *  Drop the oldest keyframe and every frame that depends on it, it
+     *  must not be the newest keyframe.
+     */
+    static inline void drop_oldest_keyframe(RewindBuffer& buffer)
+    {
+        do
+        {
+            buffer.used -= frame_size(buffer.frames.front());
+            buffer.frames.pop_front();
+        }
+        while(!buffer.frames.front().keyframe);
+    }
+
+    /**
+     *  Store the state of a cpu as the newest frame of the history.
+     *
+     *  @param buffer the history.
+     *  @param cpu the cpu to be stored, the pages it has written are
+     *             forgotten.
+     */
+    static inline void push_frame(RewindBuffer& buffer, CPU& cpu)
+    {
+        if(buffer.frames.empty())
+        {
+            save_payload(cpu, buffer.current);
+        }
+        else
+        {
+            save_registers(cpu, buffer.current);
+
+            for(uint64_t m = cpu.written_pages ; m != 0 ; m &= m - 1)
+            {
+                const size_t page = __builtin_ctzll(m);
+                std::memcpy(buffer.current.memory + page * 64, cpu.memory.data() + page * 64, 64);
+            }
+        }
+
+        buffer.pages     |= cpu.written_pages;
+        cpu.written_pages = 0x0;
+
+        RewindFrame frame{ true, {} };
+
+        if(!buffer.frames.empty() && buffer.since_keyframe < buffer.keyframe_interval)
+        {
+            encode_pages(buffer.keyframe, buffer.current, buffer.pages, buffer.runs);
+
+            // Once the frames have drifted too far from the keyframe a new one is cheaper.
+            frame.keyframe = buffer.runs.size() > PAYLOAD_WORDS / 2;
+        }
+
+        if(frame.keyframe)
+        {
+            frame.words.resize(PAYLOAD_WORDS);
+            std::memcpy(frame.words.data(), &buffer.current, sizeof(buffer.current));
+
+            buffer.keyframe       = buffer.current;
+            buffer.since_keyframe = 0;
+            buffer.pages          = 0x0;
+        }
+        else
+        {
+            frame.words.assign(buffer.runs.begin(), buffer.runs.end());
+
+            buffer.since_keyframe += 1;
+        }
+
+        buffer.used += frame_size(frame);
+        buffer.frames.push_back(std::move(frame));
+
+        // The frames of the newest keyframe are always kept.
+        while(buffer.used > buffer.budget && buffer.frames.size() > buffer.since_keyframe + 1) drop_oldest_keyframe(buffer);
+    }
+
+    /**
+     *  Restore the newest frame of the history and drop it.
+     *
+     *  @param buffer the history.
+     *  @param cpu the cpu to be restored.
+     *
+     *  @return false if there were no frames left.
+     */
+    static inline bool rewind_frame(RewindBuffer& buffer, CPU& cpu)
+    {
+        if(buffer.frames.empty()) return false;
+
+        const RewindFrame& frame        = buffer.frames.back();
+        const bool         was_keyframe = frame.keyframe;
+
+        if(frame.keyframe)
+        {
+            copy_keyframe(frame, buffer.current);
+        }
+        else
+        {
+            buffer.current = buffer.keyframe;
+            decode_runs(frame.words, buffer.current);
+        }
+
+        load_payload(cpu, buffer.current);
+
+        buffer.used -= frame_size(frame);
+        buffer.frames.pop_back();
+
+        if(!was_keyframe)
+        {
+            buffer.since_keyframe -= 1;
+            return true;
+        }
+
+        // The frames left depend on the keyframe before the one dropped.
+        buffer.since_keyframe = 0;
+
+        for(auto it = buffer.frames.rbegin() ; it != buffer.frames.rend() ; it++)
+        {
+            if(it->keyframe)
+            {
+                copy_keyframe(*it, buffer.keyframe);
+                break;
+            }
+
+            buffer.since_keyframe += 1;
+        }
+
+        return true;
+    }
+}
+
+#endif
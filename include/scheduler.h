@@ -0,0 +1,183 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace chip
+{
+    /**
+     *  On this file we present a work stealing scheduler that runs a
+     *  list of independent jobs, like emulating a ROM, on every core.
+     *
+     *  Each worker starts with a contiguous slice of the jobs on its
+     *  own deque, it takes jobs from the back and, once it runs out,
+     *  steals them from the front of the deques of the other workers
+     *  so, slow jobs don't leave the rest of the cores idle. Jobs are
+     *  coarse so, a mutex per deque is never contended in practice.
+     */
+
+    /**
+     *  Jobs of a worker, only touched while holding its mutex.
+     */
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<uint32_t> jobs;
+    };
+
+    /**
+     *  What a worker did while running a list of jobs.
+     */
+    struct WorkerStats
+    {
+        uint64_t jobs;   // Jobs run by the worker.
+        uint64_t stolen; // Jobs run by the worker that were taken from other workers.
+        double   busy;   // Seconds spent running jobs.
+        double   wall;   // Seconds since the workers started until this one finished.
+    };
+
+    /**
+     *  Take the last job of a worker's own queue.
+     *
+     *  @param queue the queue of the worker.
+     *  @param job where the job taken is stored.
+     */
+    static inline bool pop_job(WorkQueue& queue, uint32_t& job)
+    {
+        std::lock_guard<std::mutex> lock{queue.mutex};
+
+        if(queue.jobs.empty()) return false;
+
+        job = queue.jobs.back();
+        queue.jobs.pop_back();
+
+        return true;
+    }
+
+    /**
+     *  Take the first job of another worker's queue, the one its owner
+     *  would run last.
+     *
+     *  @param queue the queue of the other worker.
+     *  @param job where the job taken is stored.
+     */
+    static inline bool steal_job(WorkQueue& queue, uint32_t& job)
+    {
+        std::lock_guard<std::mutex> lock{queue.mutex};
+
+        if(queue.jobs.empty()) return false;
+
+        job = queue.jobs.front();
+        queue.jobs.pop_front();
+
+        return true;
+    }
+
+    /**
+     *  Keep a thread on a single core. Only Linux is supported, on
+     *  other systems the thread is left to the operating system.
+     *
+     *  @param thread the thread to be pinned.
+     *  @param core the index of the core.
+     *
+     *  @return true if the thread has been pinned.
+     */
+    static inline bool pin_thread(std::thread& thread, uint32_t core)
+    {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core % CPU_SETSIZE, &set);
+
+        return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+#else
+        (void)thread;
+        (void)core;
+        return false;
+#endif
+    }
+
+    /**
+     *  Run every job exactly once on a number of worker threads.
+     *
+     *  @param jobs the number of jobs, they are numbered from 0.
+     *  @param workers the number of worker threads, at least one.
+     *  @param pin keep each worker on its own core.
+     *  @param function callable taking the job and the worker that runs it.
+     *
+     *  @return what each worker did.
+     */
+    template<typename Function>
+    static inline std::vector<WorkerStats> run_parallel(uint32_t jobs, uint32_t workers, bool pin, Function function)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        workers = workers > 0 ? workers : 1;
+
+        std::unique_ptr<WorkQueue[]> queues{new WorkQueue[workers]};
+        std::vector<WorkerStats>     stats(workers, WorkerStats{ 0, 0, 0.0, 0.0 });
+        std::vector<std::thread>     threads;
+
+        for(uint32_t worker = 0 ; worker < workers ; worker++)
+        {
+            const uint32_t first = static_cast<uint64_t>(jobs) * worker / workers;
+            const uint32_t last  = static_cast<uint64_t>(jobs) * (worker + 1) / workers;
+
+            for(uint32_t job = first ; job < last ; job++) queues[worker].jobs.push_back(job);
+        }
+
+        const Clock::time_point start = Clock::now();
+
+        for(uint32_t worker = 0 ; worker < workers ; worker++)
+        {
+            threads.emplace_back([&, worker]()
+            {
+                WorkerStats& stat = stats[worker];
+                uint32_t     job  = 0;
+
+                for(;;)
+                {
+                    bool stolen = false;
+                    bool found  = pop_job(queues[worker], job);
+
+                    for(uint32_t i = 1 ; !found && i < workers ; i++)
+                    {
+                        found = stolen = steal_job(queues[(worker + i) % workers], job);
+                    }
+
+                    // Jobs never create jobs so, when every queue is empty the work is done.
+                    if(!found) break;
+
+                    const Clock::time_point begin = Clock::now();
+
+                    function(job, worker);
+
+                    stat.busy   += std::chrono::duration<double>(Clock::now() - begin).count();
+                    stat.jobs   += 1;
+                    stat.stolen += stolen;
+                }
+
+                stat.wall = std::chrono::duration<double>(Clock::now() - start).count();
+            });
+
+            if(pin) pin_thread(threads.back(), worker);
+        }
+
+        for(std::thread& thread : threads) thread.join();
+
+        return stats;
+    }
+}
+
+#endif
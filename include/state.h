@@ -0,0 +1,287 @@
+#ifndef STATE_H
+#define STATE_H
+
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+
+#include "./cpu.h"
+#include "./mapped.h"
+
+namespace chip
+{
+    /**
+     *  On this file we present snapshots of a cpu: everything a program
+     *  can observe (registers, timers, stack, memory, screen, key pad
+     *  and the state of the random generator) stored on a fixed layout
+     *  so, saving and restoring a cpu is a handful of memcpy's.
+     *
+     *  A snapshot is a header followed by the payload. The header holds
+     *  a magic number, the version of the layout and a checksum of the
+     *  payload, which are checked before a snapshot is restored. Values
+     *  are stored with the byte order of the host, a snapshot written
+     *  on a host with the other byte order fails the magic check.
+     *
+     *  Snapshots have a fixed size so, a state file can hold any number
+     *  of them one after the other.
+     */
+
+    const uint32_t STATE_MAGIC   = 0x53384843; // "CH8S"
+    const uint16_t STATE_VERSION = 1;
+
+    struct StateHeader
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t reserved;
+        uint32_t payload_size;
+        uint32_t checksum; // state_checksum() of the payload.
+    };
+
+    /**
+     *  Fields are sorted by size so, the layout has no padding and it
+     *  is the same for every compiler.
+     */
+    struct StatePayload
+    {
+        uint64_t   screen[32];
+        uint64_t   cycles;
+        uint64_t   DT_cycle;
+        uint64_t   ST_cycle;
+        uint64_t   random_state;
+        uint32_t   cycles_per_tick;
+        uint16_t   stack[16];
+        uint16_t   PC;
+        uint16_t   I;
+        uint16_t   key_pad;
+        uint8_t    V[16];
+        uint8_t    SP;
+        uint8_t    DT;
+        uint8_t    ST;
+        uint8_t    draw;
+        ScreenRect changed;
+        uint8_t    memory[4096];
+        uint8_t    reserved[6];
+    };
+
+    static_assert(sizeof(StateHeader)  == 16,   "The layout of StateHeader is part of the state format");
+    static_assert(sizeof(StatePayload) == 4456, "The layout of StatePayload is part of the state format");
+
+    /**
+     *  Size in bytes of a snapshot.
+     */
+    const size_t STATE_SIZE = sizeof(StateHeader) + sizeof(StatePayload);
+
+    /**
+     *  FNV-1a hash of the payload taken a word at a time, folded to 32
+     *  bits.
+     *
+     *  @param payload the payload to be hashed.
+     */
+    static inline uint32_t state_checksum(const StatePayload& payload)
+    {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&payload);
+        uint64_t       hash  = 0xCBF29CE484222325ULL;
+
+        for(size_t i = 0 ; i < sizeof(StatePayload) ; i += sizeof(uint64_t))
+        {
+            uint64_t word;
+            std::memcpy(&word, bytes + i, sizeof(word));
+
+            hash ^= word;
+            hash *= 0x100000001B3ULL;
+        }
+
+        return static_cast<uint32_t>(hash ^ (hash >> 32));
+    }
+
+    /**
+     *  Copy every part of the state of a cpu but its memory into a
+     *  payload.
+     *
+     *  @param cpu the cpu to be saved.
+     *  @param payload where the state is stored.
+     */
+    static inline void save_registers(const CPU& cpu, StatePayload& payload)
+    {
+        std::memcpy(payload.screen, cpu.screen.data(), sizeof(payload.screen));
+        std::memcpy(payload.stack,  cpu.stack.data(),  sizeof(payload.stack));
+        std::memcpy(payload.V,      cpu.V.data(),      sizeof(payload.V));
+        std::memset(payload.reserved, 0x0, sizeof(payload.reserved));
+
+        payload.cycles          = cpu.cycles;
+        payload.DT_cycle        = cpu.DT_cycle;
+        payload.ST_cycle        = cpu.ST_cycle;
+        payload.random_state    = cpu.random_state;
+        payload.cycles_per_tick = cpu.cycles_per_tick;
+        payload.PC              = cpu.PC;
+        payload.I               = cpu.I;
+        payload.key_pad         = cpu.key_pad;
+        payload.SP              = cpu.SP;
+        payload.DT              = cpu.DT;
+        payload.ST              = cpu.ST;
+        payload.draw            = cpu.draw;
+        payload.changed         = cpu.changed;
+    }
+
+    /**
+     *  Copy the state of a cpu into a payload.
+     *
+     *  @param cpu the cpu to be saved.
+     *  @param payload where the state is stored.
+     */
+    static inline void save_payload(const CPU& cpu, StatePayload& payload)
+    {
+        save_registers(cpu, payload);
+        std::memcpy(payload.memory, cpu.memory.data(), sizeof(payload.memory));
+    }
+
+    /**
+     *  Copy a payload into a cpu, it isn't checked.
+     *
+     *  @param cpu the cpu to be restored, its decoded cache is invalidated.
+     *  @param payload the state to be restored.
+     */
+    static inline void load_payload(CPU& cpu, const StatePayload& payload)
+    {
+        std::memcpy(cpu.screen.data(), payload.screen, sizeof(payload.screen));
+        std::memcpy(cpu.stack.data(),  payload.stack,  sizeof(payload.stack));
+        std::memcpy(cpu.V.data(),      payload.V,      sizeof(payload.V));
+        std::memcpy(cpu.memory.data(), payload.memory, sizeof(payload.memory));
+
+        cpu.cycles          = payload.cycles;
+        cpu.DT_cycle        = payload.DT_cycle;
+        cpu.ST_cycle        = payload.ST_cycle;
+        cpu.random_state    = payload.random_state;
+        cpu.cycles_per_tick = payload.cycles_per_tick;
+        cpu.PC              = payload.PC;
+        cpu.I               = payload.I;
+        cpu.key_pad         = payload.key_pad;
+        cpu.SP              = payload.SP;
+        cpu.DT              = payload.DT;
+        cpu.ST              = payload.ST;
+        cpu.draw            = payload.draw;
+        cpu.changed         = payload.changed;
+
+        invalidate(cpu, 0x0, cpu.memory.size());
+    }
+
+    /**
+     *  Write a snapshot of a cpu.
+     *
+     *  @param cpu the cpu to be saved.
+     *  @param buffer where the snapshot is written, it must hold at
+     *                least STATE_SIZE bytes.
+     */
+    static inline void save_state(const CPU& cpu, uint8_t* buffer)
+    {
+        StatePayload payload;
+        save_payload(cpu, payload);
+
+        const StateHeader header{ STATE_MAGIC, STATE_VERSION, 0x0, sizeof(StatePayload), state_checksum(payload) };
+
+        std::memcpy(buffer,                  &header,  sizeof(header));
+        std::memcpy(buffer + sizeof(header), &payload, sizeof(payload));
+    }
+
+    /**
+     *  Take a snapshot of a cpu.
+     *
+     *  @param cpu the cpu to be saved.
+     *
+     *  @return the snapshot, STATE_SIZE bytes.
+     */
+    static inline std::vector<uint8_t> save_state(const CPU& cpu)
+    {
+        std::vector<uint8_t> buffer(STATE_SIZE);
+        save_state(cpu, buffer.data());
+        return buffer;
+    }
+
+    /**
+     *  Restore a cpu from a snapshot. The snapshot is checked before
+     *  anything is copied so, the cpu is left untouched when it isn't
+     *  valid.
+     *
+     *  @param cpu the cpu to be restored, its decoded cache is invalidated.
+     *  @param data the snapshot.
+     *  @param size the number of bytes available at data.
+     */
+    static inline void load_state(CPU& cpu, const uint8_t* data, size_t size)
+    {
+        StateHeader  header;
+        StatePayload payload;
+
+        if(size < STATE_SIZE) throw std::runtime_error{"The state is truncated"};
+
+        std::memcpy(&header, data, sizeof(header));
+
+        if(header.magic != STATE_MAGIC)                 throw std::runtime_error{"The data is not a Chip-8 state"};
+        if(header.version != STATE_VERSION)             throw std::runtime_error{"Unsupported state version " + std::to_string(header.version)};
+        if(header.payload_size != sizeof(StatePayload)) throw std::runtime_error{"The state has an invalid size"};
+
+        std::memcpy(&payload, data + sizeof(header), sizeof(payload));
+
+        if(header.checksum != state_checksum(payload))  throw std::runtime_error{"The state is corrupted"};
+        if(payload.cycles_per_tick == 0)                throw std::runtime_error{"The state has an invalid clock rate"};
+
+        load_payload(cpu, payload);
+    }
+
+    static inline void load_state(CPU& cpu, const std::vector<uint8_t>& state)
+    {
+        load_state(cpu, state.data(), state.size());
+    }
+
+    /**
+     *  Append a snapshot of a cpu to a stream, like a state file.
+     *
+     *  @param output where the snapshot is written.
+     *  @param cpu the cpu to be saved.
+     */
+    static inline void write_state(std::ostream& output, const CPU& cpu)
+    {
+        std::array<uint8_t, STATE_SIZE> buffer;
+        save_state(cpu, buffer.data());
+
+        output.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+
+        if(!output) throw std::runtime_error{"Unable to write the state"};
+    }
+
+    /**
+     *  The snapshots of a state file. The file is mapped instead of
+     *  read so, opening it takes the same time whatever its size and
+     *  only the snapshots that are restored are ever loaded.
+     */
+    struct StateFile : MappedFile
+    {
+        explicit StateFile(const std::string& path) : MappedFile{path, "state file"}, count{size / STATE_SIZE}
+        {
+            if(size % STATE_SIZE != 0) throw std::runtime_error{"State file " + path + " is truncated"};
+        }
+
+        size_t count; // Number of snapshots on the file.
+    };
+
+    /**
+     *  Restore a cpu from one of the snapshots of a state file.
+     *
+     *  @param cpu the cpu to be restored.
+     *  @param file the state file.
+     *  @param index the position of the snapshot on the file.
+     */
+    static inline void load_state(CPU& cpu, const StateFile& file, size_t index)
+    {
+        if(index >= file.count) throw std::runtime_error{"The state file has no state " + std::to_string(index)};
+
+        load_state(cpu, file.data + index * STATE_SIZE, STATE_SIZE);
+    }
+}
+
+#endif
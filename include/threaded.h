@@ -0,0 +1,154 @@
+#ifndef THREADED_H
+#define THREADED_H
+
+#include <cstdint>
+
+#include "./opcode.h"
+#include "./cpu.h"
+
+/**
+ *  Threaded code relies on the labels as values extension of GCC and
+ *  Clang. Define CHIP8_NO_COMPUTED_GOTO to build the portable loop.
+ */
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(CHIP8_NO_COMPUTED_GOTO)
+#define CHIP8_COMPUTED_GOTO 1
+#endif
+
+namespace chip
+{
+    /**
+     *  Interpreters that can run a program.
+     *
+     *  CYCLE_BACKEND     calls cycle() once per instruction.
+     *  THREADED_BACKEND  runs run_threaded(), which falls back to
+     *                    cycle() when computed gotos are not available.
+     */
+    enum Backend : uint8_t
+    {
+        CYCLE_BACKEND,
+        THREADED_BACKEND
+    };
+
+    /**
+     *  Check if run_threaded() was built with threaded dispatch.
+     */
+    constexpr bool has_threaded_dispatch()
+    {
+#ifdef CHIP8_COMPUTED_GOTO
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     *  Execute a number of instructions using threaded code: every
+     *  handler ends with its own jump to the handler of the next
+     *  instruction instead of returning to a central loop so, the
+     *  branch predictor can learn which instruction follows each one.
+     *
+     *  The state of the cpu is exactly the same as calling cycle()
+     *  the same number of times.
+     *
+     *  @param cpu the cpu that will run the instructions.
+     *  @param cycles the number of instructions to execute.
+     */
+    static inline void run_threaded(CPU& cpu, uint64_t cycles)
+    {
+#ifdef CHIP8_COMPUTED_GOTO
+        static const void* const labels[HANDLER_COUNT]
+        {
+            &&op_0xE0,  &&op_0xEE,  &&op_0x0,   &&op_0x1,   &&op_0x2,   &&op_0x3,   &&op_0x4,   &&op_0x50,
+            &&op_0x6,   &&op_0x7,   &&op_0x80,  &&op_0x81,  &&op_0x82,  &&op_0x83,  &&op_0x84,  &&op_0x85,
+            &&op_0x86,  &&op_0x87,  &&op_0x8E,  &&op_0x90,  &&op_0xA,   &&op_0xB,   &&op_0xC,   &&op_0xD,
+            &&op_0xE9E, &&op_0xEA1, &&op_0xF07, &&op_0xF0A, &&op_0xF15, &&op_0xF18, &&op_0xF1E, &&op_0xF29,
+            &&op_0xF33, &&op_0xF55, &&op_0xF65, &&op_0x0
+        };
+
+        const CachedInstruction* instruction = nullptr;
+
+        if(cycles == 0) return;
+
+#define CHIP8_DISPATCH()                                \
+        instruction = &lookup(cpu);                     \
+        goto *labels[instruction->handler];
+
+#define CHIP8_NEXT()                                    \
+        cpu.cycles += 1;                                \
+        cpu.PC     += 2;                                \
+        if(--cycles == 0) return;                       \
+        CHIP8_DISPATCH()
+
+#define CHIP8_HANDLER(code)                             \
+        op_##code:                                      \
+        op_code_##code(cpu, instruction->op_code);      \
+        CHIP8_NEXT()
+
+        CHIP8_DISPATCH()
+
+        CHIP8_HANDLER(0xE0)
+        CHIP8_HANDLER(0xEE)
+        CHIP8_HANDLER(0x0)
+        CHIP8_HANDLER(0x1)
+        CHIP8_HANDLER(0x2)
+        CHIP8_HANDLER(0x3)
+        CHIP8_HANDLER(0x4)
+        CHIP8_HANDLER(0x50)
+        CHIP8_HANDLER(0x6)
+        CHIP8_HANDLER(0x7)
+        CHIP8_HANDLER(0x80)
+        CHIP8_HANDLER(0x81)
+        CHIP8_HANDLER(0x82)
+        CHIP8_HANDLER(0x83)
+        CHIP8_HANDLER(0x84)
+        CHIP8_HANDLER(0x85)
+        CHIP8_HANDLER(0x86)
+        CHIP8_HANDLER(0x87)
+        CHIP8_HANDLER(0x8E)
+        CHIP8_HANDLER(0x90)
+        CHIP8_HANDLER(0xA)
+        CHIP8_HANDLER(0xB)
+        CHIP8_HANDLER(0xC)
+        CHIP8_HANDLER(0xD)
+        CHIP8_HANDLER(0xE9E)
+        CHIP8_HANDLER(0xEA1)
+        CHIP8_HANDLER(0xF07)
+        CHIP8_HANDLER(0xF0A)
+        CHIP8_HANDLER(0xF15)
+        CHIP8_HANDLER(0xF18)
+        CHIP8_HANDLER(0xF1E)
+        CHIP8_HANDLER(0xF29)
+        CHIP8_HANDLER(0xF33)
+        CHIP8_HANDLER(0xF55)
+        CHIP8_HANDLER(0xF65)
+
+#undef CHIP8_HANDLER
+#undef CHIP8_NEXT
+#undef CHIP8_DISPATCH
+#else
+        for(; cycles > 0 ; cycles--) cycle(cpu);
+#endif
+    }
+
+    /**
+     *  Execute a number of instructions with the selected backend.
+     *
+     *  @param cpu the cpu that will run the instructions.
+     *  @param cycles the number of instructions to execute.
+     *  @param backend the interpreter that will run the instructions.
+     */
+    static inline void run(CPU& cpu, uint64_t cycles, Backend backend)
+    {
+        switch (backend)
+        {
+        case THREADED_BACKEND:
+            run_threaded(cpu, cycles);
+            break;
+        default:
+            for(; cycles > 0 ; cycles--) cycle(cpu);
+            break;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,587 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <array>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <ostream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <condition_variable>
+
+#include "./opcode.h"
+#include "./cpu.h"
+#include "./batch.h"
+#include "./profiler.h"
+#include "./disassembler.h"
+#include "./mapped.h"
+
+/**
+ *  Handing a block to the writer is rare and big, it is kept out of
+ *  the loops that record instructions so, they stay small enough to
+ *  be inlined.
+ */
+#if defined(__GNUC__)
+#define CHIP8_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define CHIP8_NOINLINE __declspec(noinline)
+#else
+#define CHIP8_NOINLINE
+#endif
+
+namespace chip
+{
+    /**
+     *  On this file we present execution traces: the address and the
+     *  instruction of everything a cpu executed, for runs of billions
+     *  of instructions.
+     *
+     *  A trace file is the magic number and the version followed by
+     *  blocks, each one the size of its records, the number of records
+     *  and the records. A record is a tag byte whose low 7 bits are the
+     *  distance from the address after the previous instruction, or
+     *  TRACE_ABSOLUTE followed by the address, and whose high bit tells
+     *  that the instruction at the address changed since it was last
+     *  seen and follows the address. Readers keep the last instruction
+     *  seen at each address too so, straight code and short branches
+     *  over instructions already seen take a byte.
+     *
+     *  The emulation thread only stores the address and the instruction
+     *  of each instruction executed on a block, a thread of the writer
+     *  takes the full ones, encodes them and writes them to the file.
+     */
+
+    const uint32_t TRACE_MAGIC   = 0x54384843; // "CH8T"
+    const uint16_t TRACE_VERSION = 1;
+
+    const size_t  TRACE_HEADER_SIZE  = 8;       // Magic number, version and 2 reserved bytes.
+    const size_t  TRACE_BLOCK_HEADER = 8;       // Size of the records and number of records.
+    const size_t  TRACE_BLOCK_SIZE   = 1 << 16; // Default number of instructions of a block.
+    const size_t  TRACE_RECORD_MAX   = 5;       // Tag, address and instruction.
+    const size_t  TRACE_BLOCKS       = 4;       // Blocks being filled or waiting to be written.
+    const uint8_t TRACE_ABSOLUTE     = 0x7F;    // The address follows the tag.
+    const uint8_t TRACE_NEW_OPCODE   = 0x80;    // The instruction follows the tag and the address.
+    const int32_t TRACE_DELTA_BIAS   = 63;      // Distance stored as 0 on the tag.
+
+    struct TraceBlock
+    {
+        std::vector<uint32_t> executed; // Address << 16 | instruction, for each instruction executed.
+        size_t count;                   // Instructions stored on executed.
+    };
+
+    /**
+     *  Encode the records of a block of executed instructions.
+     *
+     *  @param executed address << 16 | instruction, for each instruction.
+     *  @param count the number of instructions.
+     *  @param previous the address of the last instruction encoded, updated.
+     *  @param op_codes the last instruction encoded at each address, updated.
+     *  @param records where the records are written, room for count * TRACE_RECORD_MAX bytes.
+     *
+     *  @return the size of the records.
+     */
+    static inline size_t encode_trace_block(const uint32_t* executed, size_t count, uint16_t& previous,
+                                            std::array<uint16_t, 4096>& op_codes, uint8_t* records)
+    {
+        uint8_t* record = records;
+        uint16_t last   = previous; // Kept local, the records written could alias previous.
+
+        for(size_t i = 0 ; i < count ; i++)
+        {
+            const uint16_t PC      = executed[i] >> 16;
+            const uint16_t op_code = executed[i] & 0xFFFF;
+
+            const int32_t distance = static_cast<int32_t>(PC) - static_cast<int32_t>(last) - 2 + TRACE_DELTA_BIAS;
+            const bool    known    = op_codes[PC & 0xFFF] == op_code;
+
+            last = PC;
+
+            // Nearly every record is a byte, the distance of an instruction seen before.
+            if(known && static_cast<uint32_t>(distance) < TRACE_ABSOLUTE)
+            {
+                *record++ = static_cast<uint8_t>(distance);
+                continue;
+            }
+
+            size_t size = 1;
+
+            if(distance >= 0 && distance < TRACE_ABSOLUTE)
+            {
+                record[0] = static_cast<uint8_t>(distance);
+            }
+            else
+            {
+                record[0] = TRACE_ABSOLUTE;
+                record[1] = PC >> 8;
+                record[2] = PC & 0xFF;
+                size = 3;
+            }
+
+            if(!known)
+            {
+                record[0]     |= TRACE_NEW_OPCODE;
+                record[size]     = op_code >> 8;
+                record[size + 1] = op_code & 0xFF;
+                size += 2;
+
+                op_codes[PC & 0xFFF] = op_code;
+            }
+
+            record += size;
+        }
+
+        previous = last;
+
+        return record - records;
+    }
+
+    struct TraceWriter
+    {
+        /**
+         *  Create a trace file and start the thread that writes it.
+         *
+         *  @param path where the trace is written.
+         *  @param block_size number of instructions of each block.
+         */
+        explicit TraceWriter(const std::string& path, size_t block_size = TRACE_BLOCK_SIZE)
+            : file{path, std::ios::out | std::ios::binary | std::ios::trunc}, blocks{}, current{0}, next{nullptr}, end{nullptr},
+              finished{false}, previous{ROM_START - 2}, op_codes{}, records(std::max<size_t>(block_size, 1) * TRACE_RECORD_MAX),
+              instructions{0}, bytes{TRACE_HEADER_SIZE}
+        {
+            if(!file.is_open()) throw std::runtime_error{"Unable to write trace " + path};
+
+            const uint8_t header[TRACE_HEADER_SIZE] =
+            {
+                TRACE_MAGIC & 0xFF, (TRACE_MAGIC >> 8) & 0xFF, (TRACE_MAGIC >> 16) & 0xFF, TRACE_MAGIC >> 24,
+                TRACE_VERSION & 0xFF, TRACE_VERSION >> 8, 0x0, 0x0
+            };
+
+            file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+            // Blocks are allocated once, recording never allocates.
+            for(size_t i = 0 ; i < TRACE_BLOCKS ; i++)
+            {
+                blocks[i] = TraceBlock{ std::vector<uint32_t>(std::max<size_t>(block_size, 1)), 0 };
+
+                if(i != current) free.push_back(i);
+            }
+
+            next = blocks[current].executed.data();
+            end  = next + blocks[current].executed.size();
+
+            thread = std::thread{[this]()
+            {
+                for(;;)
+                {
+                    size_t index = 0;
+
+                    {
+                        std::unique_lock<std::mutex> lock{mutex};
+                        changed.wait(lock, [this]() { return !full.empty() || finished; });
+
+                        if(full.empty()) return;
+
+                        index = full.front();
+                        full.pop_front();
+                    }
+
+                    const TraceBlock& block = blocks[index];
+                    const size_t      used  = encode_trace_block(block.executed.data(), block.count, previous, op_codes, records.data());
+
+                    const uint8_t header[TRACE_BLOCK_HEADER] =
+                    {
+                        static_cast<uint8_t>(used),        static_cast<uint8_t>(used >> 8),
+                        static_cast<uint8_t>(used >> 16),  static_cast<uint8_t>(used >> 24),
+                        static_cast<uint8_t>(block.count), static_cast<uint8_t>(block.count >> 8),
+                        static_cast<uint8_t>(block.count >> 16), static_cast<uint8_t>(block.count >> 24)
+                    };
+
+                    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+                    file.write(reinterpret_cast<const char*>(records.data()), used);
+
+                    instructions += block.count;
+                    bytes        += TRACE_BLOCK_HEADER + used;
+
+                    {
+                        std::lock_guard<std::mutex> lock{mutex};
+                        free.push_back(index);
+                    }
+
+                    changed.notify_all();
+                }
+            }};
+        }
+
+        ~TraceWriter()
+        {
+            // finish_trace() reports errors, a writer destroyed without it just stops.
+            try { finish(); } catch(...) {}
+        }
+
+        TraceWriter(const TraceWriter&) = delete;
+        TraceWriter& operator=(const TraceWriter&) = delete;
+
+        /**
+         *  Hand the remaining instructions to the thread and wait until
+         *  everything is written.
+         */
+        void finish()
+        {
+            if(!thread.joinable()) return;
+
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+
+                blocks[current].count = next - blocks[current].executed.data();
+
+                if(blocks[current].count > 0) full.push_back(current);
+
+                finished = true;
+            }
+
+            changed.notify_all();
+            thread.join();
+
+            file.flush();
+        }
+
+        std::ofstream file;
+        std::array<TraceBlock, TRACE_BLOCKS> blocks;
+        size_t    current; // Block filled by the emulation thread.
+        uint32_t* next;    // Where the emulation thread stores the next instruction.
+        uint32_t* end;     // End of the block being filled.
+
+        std::mutex mutex; // Guards full, free and finished.
+        std::condition_variable changed;
+        std::deque<size_t> full;
+        std::deque<size_t> free;
+        bool finished;
+        std::thread thread;
+
+        // Only the thread touches these until finish() returns.
+        uint16_t previous;                   // Address of the last instruction encoded.
+        std::array<uint16_t, 4096> op_codes; // Last instruction encoded at each address.
+        std::vector<uint8_t> records;        // Records of the block being written.
+        uint64_t instructions;               // Instructions written.
+        uint64_t bytes;                      // Bytes of the file.
+    };
+
+    /**
+     *  Hand the block being filled to the thread of the writer and take
+     *  an empty one, waiting for it if the thread fell behind.
+     */
+    CHIP8_NOINLINE static void submit_block(TraceWriter& writer)
+    {
+        {
+            std::unique_lock<std::mutex> lock{writer.mutex};
+
+            writer.blocks[writer.current].count = writer.next - writer.blocks[writer.current].executed.data();
+
+            writer.full.push_back(writer.current);
+            writer.changed.notify_all();
+            writer.changed.wait(lock, [&writer]() { return !writer.free.empty(); });
+
+            writer.current = writer.free.front();
+            writer.free.pop_front();
+        }
+
+        writer.next = writer.blocks[writer.current].executed.data();
+        writer.end  = writer.next + writer.blocks[writer.current].executed.size();
+    }
+
+    /**
+     *  Record an instruction about to be executed. Encoding is left to
+     *  the thread of the writer so, this is a store on most calls.
+     *
+     *  @param writer the trace.
+     *  @param PC the address of the instruction.
+     *  @param op_code the instruction, as stored on memory.
+     */
+    static inline void trace_instruction(TraceWriter& writer, uint16_t PC, uint16_t op_code)
+    {
+        if(writer.next == writer.end) submit_block(writer);
+
+        *writer.next++ = (static_cast<uint32_t>(PC) << 16) | op_code;
+    }
+
+    /**
+     *  Write the remaining records and close the trace.
+     *
+     *  @param writer the trace.
+     */
+    static inline void finish_trace(TraceWriter& writer)
+    {
+        writer.finish();
+
+        if(!writer.file) throw std::runtime_error{"Unable to write the trace"};
+    }
+
+    struct TraceObserver
+    {
+        TraceWriter& writer;
+
+        bool operator()(const CPU& cpu, const CachedInstruction& instruction, uint64_t) const
+        {
+            // Waiting for a key doesn't execute FX0A, it is recorded once a key is pressed.
+            if(instruction.handler != OP_0xF0A || cpu.key_pad != 0) trace_instruction(writer, cpu.PC, fetch(cpu));
+
+            return false;
+        }
+    };
+
+    /**
+     *  Execute a number of instructions writing them to a trace.
+     *
+     *  @param cpu the cpu that will run the instructions.
+     *  @param writer the trace.
+     *  @param cycles the number of instructions to execute.
+     */
+    static inline RunResult run_traced(CPU& cpu, TraceWriter& writer, uint64_t cycles)
+    {
+        return run_batch(cpu, cycles, false, NoBreakpoint{}, TraceObserver{writer});
+    }
+
+    static inline uint32_t read_le32(const uint8_t* data)
+    {
+        return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+    }
+
+    /**
+     *  Decode a trace, calling a visitor with each instruction.
+     *
+     *  @param data the trace.
+     *  @param size the size of the trace.
+     *  @param visit callable taking the address and the instruction.
+     *
+     *  @return the number of instructions on the trace.
+     */
+    template<typename Visitor>
+    static inline uint64_t read_trace(const uint8_t* data, size_t size, Visitor visit)
+    {
+        if(size < TRACE_HEADER_SIZE || read_le32(data) != TRACE_MAGIC) throw std::runtime_error{"The data is not a Chip-8 trace"};
+
+        const uint16_t version = data[4] | (data[5] << 8);
+        if(version != TRACE_VERSION) throw std::runtime_error{"Unsupported trace version " + std::to_string(version)};
+
+        std::array<uint16_t, 4096> op_codes{};
+
+        uint16_t previous = ROM_START - 2;
+        uint64_t total    = 0;
+        size_t   position = TRACE_HEADER_SIZE;
+
+        while(position < size)
+        {
+            if(size - position < TRACE_BLOCK_HEADER) throw std::runtime_error{"The trace is truncated"};
+
+            const uint32_t bytes = read_le32(data + position);
+            const uint32_t count = read_le32(data + position + 4);
+
+            position += TRACE_BLOCK_HEADER;
+
+            if(size - position < bytes) throw std::runtime_error{"The trace is truncated"};
+
+            const uint8_t*       cursor = data + position;
+            const uint8_t* const end    = cursor + bytes;
+
+            for(uint32_t i = 0 ; i < count ; i++)
+            {
+                if(cursor == end) throw std::runtime_error{"The trace is corrupted"};
+
+                const uint8_t tag      = *cursor++;
+                const uint8_t distance = tag & TRACE_ABSOLUTE;
+                const size_t  extra    = (distance == TRACE_ABSOLUTE ? 2 : 0) + (tag & TRACE_NEW_OPCODE ? 2 : 0);
+
+                if(static_cast<size_t>(end - cursor) < extra) throw std::runtime_error{"The trace is corrupted"};
+
+                uint16_t PC = previous + 2 + distance - TRACE_DELTA_BIAS;
+
+                if(distance == TRACE_ABSOLUTE)
+                {
+                    PC = (cursor[0] << 8) | cursor[1];
+                    cursor += 2;
+                }
+
+                if(tag & TRACE_NEW_OPCODE)
+                {
+                    op_codes[PC & 0xFFF] = (cursor[0] << 8) | cursor[1];
+                    cursor += 2;
+                }
+
+                visit(PC, op_codes[PC & 0xFFF]);
+
+                previous = PC;
+            }
+
+            if(cursor != end) throw std::runtime_error{"The trace is corrupted"};
+
+            position += bytes;
+            total    += count;
+        }
+
+        return total;
+    }
+
+    /**
+     *  A trace file, mapped into memory.
+     */
+    struct TraceFile : MappedFile
+    {
+        // The trace is read once from the start to the end.
+        explicit TraceFile(const std::string& path) : MappedFile{path, "trace", true} {}
+    };
+
+    /**
+     *  What a trace executed. A basic block runs from an instruction
+     *  reached by a branch to the next branch taken, skips included. A
+     *  loop is a branch taken backwards that isn't a return.
+     */
+    struct TraceAnalysis
+    {
+        TraceAnalysis() : instructions{0}, handlers{}, blocks{}, loops{}, op_codes{} {}
+
+        uint64_t instructions;
+        std::array<uint64_t, HANDLER_COUNT> handlers;  // Executions of each HandlerIndex.
+        std::unordered_map<uint32_t, uint64_t> blocks; // Executions of each basic block, keyed by its first << 16 | last address.
+        std::unordered_map<uint32_t, uint64_t> loops;  // Iterations of each loop, keyed by its first << 16 | last address.
+        std::array<uint16_t, 4096> op_codes;           // Last instruction seen at each address.
+    };
+
+    /**
+     *  Compute the instruction mix, the basic blocks and the loops of a
+     *  trace.
+     *
+     *  @param data the trace.
+     *  @param size the size of the trace.
+     */
+    static inline TraceAnalysis analyze_trace(const uint8_t* data, size_t size)
+    {
+        TraceAnalysis analysis{};
+
+        const Instruction* decoded = decode_table();
+
+        bool     started  = false;
+        uint16_t first    = 0;
+        uint16_t previous = 0;
+        uint8_t  handler  = OP_UNKNOWN;
+
+        analysis.instructions = read_trace(data, size, [&](uint16_t PC, uint16_t op_code)
+        {
+            if(!started)
+            {
+                started = true;
+                first   = PC;
+            }
+            else if(PC != static_cast<uint16_t>(previous + 2))
+            {
+                analysis.blocks[(static_cast<uint32_t>(first) << 16) | previous] += 1;
+
+                if(PC <= previous && handler != OP_0xEE) analysis.loops[(static_cast<uint32_t>(PC) << 16) | previous] += 1;
+
+                first = PC;
+            }
+
+            handler = decoded[op_code].handler;
+
+            analysis.handlers[handler]   += 1;
+            analysis.op_codes[PC & 0xFFF] = op_code;
+
+            previous = PC;
+        });
+
+        if(started) analysis.blocks[(static_cast<uint32_t>(first) << 16) | previous] += 1;
+
+        return analysis;
+    }
+
+    /**
+     *  Write the instruction mix of a trace, its hottest basic blocks
+     *  and its hottest loops.
+     *
+     *  @param output where the report is written.
+     *  @param analysis the trace analyzed.
+     *  @param top the number of basic blocks and loops written.
+     */
+    static inline void write_trace_report(std::ostream& output, const TraceAnalysis& analysis, size_t top = 20)
+    {
+        const auto percent = [&analysis](uint64_t count) { return analysis.instructions > 0 ? 100.0 * count / analysis.instructions : 0.0; };
+
+        const auto address = [&output](uint32_t value) -> std::ostream&
+        {
+            return output << "0x" << std::hex << std::uppercase << std::setw(3) << std::setfill('0') << value
+                          << std::dec << std::nouppercase << std::setfill(' ');
+        };
+
+        const auto assembly = [&analysis](uint32_t PC)
+        {
+            const Instruction& instruction = decode_table()[analysis.op_codes[PC & 0xFFF]];
+
+            return disassemblers[instruction.handler] != nullptr ? disassemblers[instruction.handler](instruction.op_code) : "(unknown)";
+        };
+
+        using Entry = std::pair<uint32_t, uint64_t>;
+
+        const auto hottest = [top](const std::unordered_map<uint32_t, uint64_t>& counts)
+        {
+            std::vector<Entry> entries{counts.begin(), counts.end()};
+
+            std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.second != b.second ? a.second > b.second : a.first < b.first; });
+
+            if(entries.size() > top) entries.resize(top);
+
+            return entries;
+        };
+
+        output << std::setfill(' ') << "Instructions: " << analysis.instructions << "\n\n";
+        output << "Class  " << std::setw(14) << "Count" << std::setw(8) << "%" << "\n";
+
+        std::vector<uint16_t> order;
+
+        for(uint16_t handler = 0 ; handler < HANDLER_COUNT ; handler++)
+        {
+            if(analysis.handlers[handler] > 0) order.push_back(handler);
+        }
+
+        std::stable_sort(order.begin(), order.end(), [&](uint16_t a, uint16_t b) { return analysis.handlers[a] > analysis.handlers[b]; });
+
+        for(uint16_t handler : order)
+        {
+            output << std::left << std::setw(7) << handler_names[handler] << std::right
+                   << std::setw(14) << analysis.handlers[handler]
+                   << std::setw(8) << std::fixed << std::setprecision(2) << percent(analysis.handlers[handler]) << "\n";
+        }
+
+        output << "\nBasic block   " << std::setw(14) << "Executions" << std::setw(8) << "%" << "  First instruction\n";
+
+        for(const Entry& block : hottest(analysis.blocks))
+        {
+            const uint32_t first = block.first >> 16;
+            const uint32_t last  = block.first & 0xFFFF;
+
+            // Instructions of the block, each one executed as many times as the block.
+            const uint64_t length = last >= first ? (last - first) / 2 + 1 : 1;
+
+            address(first) << "-";
+            address(last) << std::setw(14) << block.second
+                          << std::setw(8) << std::fixed << std::setprecision(2) << percent(block.second * length)
+                          << "  " << assembly(first) << "\n";
+        }
+
+        output << "\nLoop          " << std::setw(14) << "Iterations" << "  Backward branch\n";
+
+        for(const Entry& loop : hottest(analysis.loops))
+        {
+            address(loop.first >> 16) << "-";
+            address(loop.first & 0xFFFF) << std::setw(14) << loop.second << "  " << assembly(loop.first & 0xFFFF) << "\n";
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,46 @@
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#include "../include/recompiler.h"
+
+int main(int argc, char **argv)
+{
+    if(argc != 3)
+    {
+        std::cout << "Usage: chip8-recompile <ROM> <output.cpp> \n";
+        return 1;
+    }
+
+    std::ifstream file{argv[1], std::ios::in | std::ios::binary};
+
+    if(!file.is_open())
+    {
+        std::cout << "Unable to open ROM " << argv[1] << "\n";
+        return 1;
+    }
+
+    std::vector<uint8_t> rom{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+
+    chip::CPU cpu{};
+
+    if(rom.size() > cpu.memory.size() - chip::ROM_START)
+    {
+        std::cout << "The ROM " << argv[1] << " doesn't fit in memory \n";
+        return 1;
+    }
+
+    std::ofstream output{argv[2], std::ios::out | std::ios::trunc};
+
+    if(!output.is_open())
+    {
+        std::cout << "Unable to write " << argv[2] << "\n";
+        return 1;
+    }
+
+    chip::recompile(rom, argv[1], output);
+
+    return 0;
+}
@@ -0,0 +1,35 @@
+#include <string>
+#include <cstdlib>
+#include <iostream>
+
+#include "../include/cpu.h"
+#include "../include/recompiler.h"
+#include "../include/debbuger.h"
+
+namespace chip
+{
+    extern const RecompiledProgram recompiled_program;
+}
+
+int main(int argc, char **argv)
+{
+    const uint64_t cycles = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+    chip::CPU cpu{};
+    chip::load_font_set(cpu);
+
+    for(uint32_t i = 0 ; i < chip::recompiled_program.rom.size() ; i++) cpu.memory[chip::ROM_START + i] = chip::recompiled_program.rom[i];
+
+    chip::invalidate(cpu, chip::ROM_START, chip::recompiled_program.rom.size());
+
+    chip::Recompiled recompiled = chip::make_recompiled(chip::recompiled_program, cpu);
+
+    const uint64_t executed = chip::run_recompiled(recompiled, cpu, cycles);
+
+    std::cout << "Executed " << executed << " instructions \n";
+
+    chip::print_registers(cpu);
+    chip::print_sp_registers(cpu);
+
+    return 0;
+}
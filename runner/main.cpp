@@ -0,0 +1,198 @@
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+#include "../include/cpu.h"
+#include "../include/headless.h"
+#include "../include/scheduler.h"
+
+/**
+ *  A ROM to run with an input script for a number of frames.
+ */
+struct Job
+{
+    std::string rom;
+    std::string input; // "-" when there is no input script.
+    uint64_t    frames;
+};
+
+struct JobResult
+{
+    uint64_t    hash;
+    uint64_t    cycles;
+    double      seconds;
+    std::string error;
+};
+
+static void print_usage()
+{
+    std::cout << "Usage: chip8-batch <jobs> <results> [options] \n"
+              << "  --workers N           number of worker threads (default every core) \n"
+              << "  --pin                 keep each worker on its own core \n"
+              << "  --cycles-per-frame N  instructions per frame (default 14) \n"
+              << "\n"
+              << "Each line of the jobs file holds <ROM> <input script or -> <frames>. \n";
+}
+
+static std::vector<Job> parse_jobs(std::istream& input)
+{
+    std::vector<Job> jobs;
+    std::string line;
+    uint32_t number = 0;
+
+    while(std::getline(input, line))
+    {
+        number++;
+
+        line = line.substr(0, line.find('#'));
+        if(line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+        std::istringstream fields{line};
+        Job job{};
+
+        if(!(fields >> job.rom >> job.input >> job.frames))
+        {
+            throw std::runtime_error{"Invalid job on line " + std::to_string(number)};
+        }
+
+        jobs.push_back(job);
+    }
+
+    return jobs;
+}
+
+static JobResult run_job(const Job& job, uint64_t cycles_per_frame)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    chip::CPU chip8{};
+    std::vector<chip::InputEvent> events;
+
+    try
+    {
+        chip::load_font_set(chip8);
+        chip::load_ROM(chip8, job.rom);
+
+        if(job.input != "-")
+        {
+            std::ifstream input{job.input};
+            if(!input.is_open()) throw std::runtime_error{"Unable to open input script " + job.input};
+
+            events = chip::parse_input(input);
+        }
+    }
+    catch(const std::exception& error)
+    {
+        return JobResult{ 0, 0, 0.0, error.what() };
+    }
+
+    chip::set_clock_rate(chip8, cycles_per_frame * chip::TIMER_RATE);
+    chip::seed_random(chip8, 0);
+    chip::run_scripted(chip8, events, job.frames * cycles_per_frame, cycles_per_frame);
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return JobResult{ chip::state_hash(chip8), chip8.cycles, seconds, "" };
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 3)
+    {
+        print_usage();
+        return 1;
+    }
+
+    uint32_t workers          = std::max(std::thread::hardware_concurrency(), 1u);
+    uint64_t cycles_per_frame = 14;
+    bool     pin              = false;
+
+    for(int i = 3 ; i < argc ; i++)
+    {
+        const std::string option = argv[i];
+
+        if(option == "--pin")                                      pin              = true;
+        else if(option == "--workers" && i + 1 < argc)             workers          = std::strtoul(argv[++i], nullptr, 10);
+        else if(option == "--cycles-per-frame" && i + 1 < argc)    cycles_per_frame = std::strtoull(argv[++i], nullptr, 10);
+        else
+        {
+            print_usage();
+            return 1;
+        }
+    }
+
+    if(workers == 0 || cycles_per_frame == 0)
+    {
+        print_usage();
+        return 1;
+    }
+
+    std::vector<Job> jobs;
+
+    try
+    {
+        std::ifstream input{argv[1]};
+        if(!input.is_open()) throw std::runtime_error{"Unable to open jobs file " + std::string{argv[1]}};
+
+        jobs = parse_jobs(input);
+    }
+    catch(const std::exception& error)
+    {
+        std::cout << error.what() << "\n";
+        return 1;
+    }
+
+    std::ofstream output{argv[2], std::ios::out | std::ios::trunc};
+
+    if(!output.is_open())
+    {
+        std::cout << "Unable to write " << argv[2] << "\n";
+        return 1;
+    }
+
+    std::vector<JobResult> results(jobs.size());
+
+    const std::vector<chip::WorkerStats> stats = chip::run_parallel(jobs.size(), workers, pin, [&](uint32_t job, uint32_t)
+    {
+        results[job] = run_job(jobs[job], cycles_per_frame);
+    });
+
+    output << "rom\tinput\tframes\thash\tcycles\tseconds\terror\n";
+
+    uint32_t failed = 0;
+
+    for(uint32_t i = 0 ; i < jobs.size() ; i++)
+    {
+        const JobResult& result = results[i];
+
+        output << jobs[i].rom << "\t" << jobs[i].input << "\t" << jobs[i].frames << "\t"
+               << std::hex << std::setw(16) << std::setfill('0') << result.hash << std::dec << "\t"
+               << result.cycles << "\t" << result.seconds << "\t" << result.error << "\n";
+
+        failed += !result.error.empty();
+    }
+
+    double wall = 0.0;
+    for(const chip::WorkerStats& stat : stats) wall = std::max(wall, stat.wall);
+
+    std::cout << "Jobs: " << jobs.size() << " (" << failed << " failed) in " << wall << " s \n";
+
+    for(uint32_t i = 0 ; i < stats.size() ; i++)
+    {
+        const chip::WorkerStats& stat = stats[i];
+
+        std::cout << "Worker " << i << ": " << stat.jobs << " jobs, " << stat.stolen << " stolen, "
+                  << std::fixed << std::setprecision(1) << (wall > 0 ? 100.0 * stat.busy / wall : 0.0) << "% busy \n"
+                  << std::defaultfloat;
+    }
+
+    return failed == 0 ? 0 : 1;
+}
@@ -3,21 +3,54 @@
 #include <string>
 #include <chrono>
 #include <thread>
+#include <atomic>
 #include <cstdint>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <stdexcept>
 
 #include "../include/cpu.h"
 #include "../include/gui.h"
 #include "../include/disassembler.h"
+#include "../include/batch.h"
+#include "../include/frame.h"
+#include "../include/rewind.h"
+#include "../include/movie.h"
+#include "../include/recorder.h"
+#include "../include/debbuger.h"
 
 int main(int argc, char **argv)
 {
-    if(argc != 2)
+    if(argc < 2)
     {
         std::cout << "Unable to start the Emulator becuase no ROM path was provided \n";
         return 0;
     }
 
+    // History kept to rewind the program while backspace is held.
+    size_t      rewind_budget = chip::REWIND_BUDGET;
+    std::string record_path;
+    std::string replay_path;
+    bool        flight_recorder = true;
+    bool        halt_on_fault   = false;
+
+    for(int i = 2 ; i < argc ; i++)
+    {
+        const std::string option = argv[i];
+
+        if(option == "--no-recorder")                 flight_recorder = false;
+        else if(option == "--halt-on-fault")          halt_on_fault   = true;
+        else if(i + 1 < argc && option == "--rewind") rewind_budget   = std::strtoull(argv[++i], nullptr, 10) * 1024;
+        else if(i + 1 < argc && option == "--record") record_path     = argv[++i];
+        else if(i + 1 < argc && option == "--replay") replay_path     = argv[++i];
+        else
+        {
+            std::cout << "Usage: chip8 <ROM> [--rewind KB] [--record MOVIE | --replay MOVIE] [--no-recorder | --halt-on-fault] \n";
+            return 1;
+        }
+    }
+
     if ( SDL_Init(SDL_INIT_EVERYTHING) < 0 ) 
     {
         std::cout << "Couldn't initialize SDL because: " << SDL_GetError();
@@ -57,56 +90,219 @@ int main(int argc, char **argv)
     chip::load_font_set(chip8);
 
     chip::load_ROM(chip8, std::string{argv[1]});
+
+    // About the same speed the emulator had when it slept 1.2 ms per instruction.
+    const uint32_t CYCLES_PER_FRAME = 14;
+    const std::chrono::microseconds FRAME_TIME{16667};
+
+    const bool    replaying = !replay_path.empty();
+    chip::Movie   movie{};
+    std::ofstream record_file;
+    size_t        next_event = 0;
+
+    try
+    {
+        if(replaying)
+        {
+            std::ifstream replay_file{replay_path, std::ios::in | std::ios::binary};
+            if(!replay_file.is_open()) throw std::runtime_error{"Unable to open movie " + replay_path};
+
+            movie = chip::read_movie(replay_file);
+            chip::start_replay(chip8, movie);
+        }
+        else
+        {
+            movie = chip::start_movie(chip8, std::chrono::system_clock::now().time_since_epoch().count(), CYCLES_PER_FRAME * chip::TIMER_RATE);
+        }
+
+        if(!record_path.empty())
+        {
+            record_file.open(record_path, std::ios::out | std::ios::binary | std::ios::trunc);
+            if(!record_file.is_open()) throw std::runtime_error{"Unable to write movie " + record_path};
+        }
+    }
+    catch(const std::exception& error)
+    {
+        std::cout << error.what() << "\n";
+        return 1;
+    }
+
+    // The texture starts uninitialized so, the first frame uploads the whole screen.
+    chip::mark_changed(chip8, chip::ScreenRect{ 0, 0, chip::SCREEN_WIDHT, chip::SCREEN_HEIGHT });
+
+    chip::FrameBuffer      frames{};
+    chip::RewindBuffer     history{rewind_budget};
+    std::atomic<bool>      running{true};
+    std::atomic<bool>      rewinding{false};
+    std::atomic<uint16_t>  key_pad{0};
+    std::atomic<bool>      dump_requested{false};
+
+    // Unless --no-recorder is given, the last instructions executed are written when F1 is pressed or on a fault.
+    chip::FlightRecorder   recorder{&std::cout, halt_on_fault};
+
+    uint64_t captured = 0;
+    std::chrono::nanoseconds emulation_time{0};
+    std::chrono::nanoseconds capture_time{0};
+
+    // The emulation runs on its own thread and only hands frames to this one, which 
+    // owns the window so, waiting on vsync never stalls the cpu.
+    std::thread emulation{[&]()
+    {
+        auto next_frame = std::chrono::steady_clock::now();
+
+        while (running.load(std::memory_order_relaxed))
+        {
+            if(rewinding.load(std::memory_order_relaxed))
+            {
+                // One frame back per frame, the restored screen is presented as a whole.
+                if(!replaying && chip::rewind_frame(history, chip8))
+                {
+                    // The input recorded after the frame restored never happened.
+                    chip::truncate_movie(movie, chip8.cycles);
+                    chip::mark_changed(chip8, chip::ScreenRect{ 0, 0, chip::SCREEN_WIDHT, chip::SCREEN_HEIGHT });
+                    chip::publish_frame(frames, chip8);
+                }
+            }
+            else
+            {
+                const auto start = std::chrono::steady_clock::now();
+
+                // The observer is part of the type of the loop so, without the recorder nothing is left of it.
+                const auto run_frame = [&](auto observer)
+                {
+                    if(replaying) return chip::play_movie(chip8, movie, next_event, CYCLES_PER_FRAME, observer);
+
+                    chip8.key_pad = key_pad.load(std::memory_order_relaxed);
+                    chip::record_input(movie, chip8);
+
+                    return chip::run_batch(chip8, CYCLES_PER_FRAME, false, chip::NoBreakpoint{}, observer).reason;
+                };
+
+                const chip::StopReason stop = flight_recorder ? run_frame(chip::FlightObserver{recorder}) : run_frame(chip::NoObserver{});
+
+                if(stop == chip::STOP_FAULT)
+                {
+                    chip::write_flight_recorder(std::cout, recorder, chip8);
+                    std::cout << std::endl;
+
+                    chip::print_sp_registers(chip8);
+                    chip::print_stack(chip8);
+
+                    running = false;
+                }
+                else if(dump_requested.exchange(false))
+                {
+                    if(flight_recorder) chip::write_flight_recorder(std::cout, recorder, chip8);
+                    else                std::cout << "The flight recorder is off, start without --no-recorder \n";
+
+                    std::cout << std::endl;
+                }
+
+                if(chip8.draw)
+                {
+                    chip8.draw = false;
+                    chip::publish_frame(frames, chip8);
+                }
+
+                const auto emulated = std::chrono::steady_clock::now();
+
+                chip::push_frame(history, chip8);
+
+                emulation_time += emulated - start;
+                capture_time   += std::chrono::steady_clock::now() - emulated;
+                captured       += 1;
+            }
+
+            next_frame += FRAME_TIME;
+            std::this_thread::sleep_until(next_frame);
+        }
+    }};
+
+    uint16_t keys = 0;
     
-    for (;;)
+    while (running.load(std::memory_order_relaxed))
     {
-        chip::cycle(chip8);
-        
         SDL_Event event;
         while (SDL_PollEvent(&event))
         {
-            if (event.type == SDL_QUIT) return 0;
+            if (event.type == SDL_QUIT) running = false;
            
             if (event.type == SDL_KEYDOWN) 
             {
-                if (event.key.keysym.sym == SDLK_ESCAPE) return 0;
+                if (event.key.keysym.sym == SDLK_ESCAPE)    running = false;
+                if (event.key.keysym.sym == SDLK_BACKSPACE) rewinding = true;
+                if (event.key.keysym.sym == SDLK_F1)        dump_requested = true;
 
                 for (int i = 0; i < 16; ++i) 
                 {
                     if (event.key.keysym.sym == key_codes[i]) 
                     {
-                        chip8.key_pad |= (0x1 << i);
+                        keys |= (0x1 << i);
                     }
                 }
             }
 
             if (event.type == SDL_KEYUP) 
             {
+                if (event.key.keysym.sym == SDLK_BACKSPACE) rewinding = false;
+
                 for (int i = 0; i < 16; ++i) 
                 {
                     if (event.key.keysym.sym == key_codes[i]) 
                     {
-                        chip8.key_pad &= ~(0x1 << i);
+                        keys &= ~(0x1 << i);
                     }
                 }
             }
         }
 
-        if(chip8.draw)
+        key_pad.store(keys, std::memory_order_relaxed);
+
+        const chip::Frame* frame = chip::take_frame(frames);
+
+        if(frame == nullptr)
         {
-            chip8.draw = false;
-            for (uint32_t i = 0 ; i < chip8.screen.size() ; i++)
-            {
-                uint8_t pixel   = chip8.screen[i];
-                back_buffer[i]  = (0x00FFFFFF * pixel) | 0xFF000000;
-            }
-            SDL_UpdateTexture(texture, nullptr, back_buffer, 64 * sizeof(Uint32));
-            SDL_RenderClear(renderer);
-            SDL_RenderCopy(renderer, texture, NULL, NULL);
-            SDL_RenderPresent(renderer);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
         }
-        std::this_thread::sleep_for(std::chrono::microseconds(1200));
+
+        // Only the pixels that changed since the last frame are converted and uploaded.
+        if(!chip::is_empty(frame->changed))
+        {
+            const chip::ScreenRect changed = frame->changed;
+            const uint32_t         offset  = changed.left + changed.top * chip::SCREEN_WIDHT;
+            const SDL_Rect         rect    = { changed.left, changed.top, changed.right - changed.left, changed.bottom - changed.top };
+
+            chip::screen_to_argb(frame->screen, changed, back_buffer);
+            SDL_UpdateTexture(texture, &rect, &back_buffer[offset], 64 * sizeof(Uint32));
+        }
+
+        SDL_RenderClear(renderer);
+        SDL_RenderCopy(renderer, texture, NULL, NULL);
+        SDL_RenderPresent(renderer);
+
+        chip::frame_presented(frames);
+    }
+
+    emulation.join();
+
+    if(record_file.is_open())
+    {
+        chip::record_input(movie, chip8);
+        chip::write_movie(record_file, movie);
+
+        std::cout << "Movie: " << movie.events.size() << " key pad changes in " << movie.length << " instructions \n";
+    }
+
+    std::cout << "Frames published: " << frames.published << ", presented: " << frames.presented 
+              << ", dropped: " << frames.dropped << "\n";
+
+    if(captured > 0)
+    {
+        std::cout << "Rewind history: " << history.frames.size() << " frames in " << history.used / 1024 << " KB, "
+                  << capture_time.count() / captured << " ns per frame to capture and "
+                  << emulation_time.count() / captured << " ns per frame to emulate \n";
     }
 
     return 0;
-}
\ No newline at end of file
+}
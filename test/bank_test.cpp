@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <memory>
+
+#include "../include/opcode.h"
+#include "../include/cpu.h"
+#include "../include/bank.h"
+#include "./lockstep.h"
+
+/**
+ *  Lanes with different random numbers and keys take different paths
+ *  through this program, draw at different places and write different
+ *  bytes to memory.
+ */ 
+static const std::array<uint8_t, 70> divergent_program
+{{
+    0x6A, 0x02, // 0x200 VA = 2.
+    0xC0, 0x07, // 0x202 V0 = random & 7.
+    0xE0, 0x9E, // 0x204 Skip next instruction if key V0 is pressed.
+    0x71, 0x01, // 0x206 V1 += 1.
+    0x81, 0x04, // 0x208 V1 += V0.
+    0xA2, 0x30, // 0x20A I = 0x230.
+    0xF1, 0x33, // 0x20C Store BCD of V1 at I.
+    0xF2, 0x65, // 0x20E Load V0 - V2 from I.
+    0xF1, 0x29, // 0x210 I = sprite of digit 1.
+    0xD0, 0x15, // 0x212 Draw at (V0, V1).
+    0xF0, 0x15, // 0x214 DT = V0.
+    0x22, 0x40, // 0x216 Call subroutine at 0x240.
+    0x3F, 0x01, // 0x218 Skip next instruction if VF == 1.
+    0x11, 0xFE, // 0x21A Jump back to 0x200.
+    0x00, 0xE0, // 0x21C Clear the screen.
+    0x11, 0xFE, // 0x21E Jump back to 0x200.
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x220
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x228
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x230
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x238
+    0x83, 0x0E, // 0x240 V3 <<= 1.
+    0xF4, 0x07, // 0x242 V4 = DT.
+    0x00, 0xEE  // 0x244 Return from subroutine.
+}};
+
+template<uint32_t LANES, size_t N>
+static void expect_same_lanes(const chip::CPUBank<LANES>& bank, const std::array<chip::CPU, N>& cpus)
+{
+    for(uint32_t lane = 0 ; lane < LANES ; lane++)
+    {
+        chip::CPU result{};
+        chip::get_lane(bank, lane, result);
+
+        expect_same_state(cpus[lane], result);
+    }
+}
+
+TEST(BankTest, CanRunIdenticalLanesTogether)
+{
+    std::unique_ptr<chip::CPUBank<8>>         bank{new chip::CPUBank<8>{}};
+    std::unique_ptr<std::array<chip::CPU, 8>> cpus{new std::array<chip::CPU, 8>{}};
+
+    for(uint32_t lane = 0 ; lane < 8 ; lane++)
+    {
+        load_lockstep_program((*cpus)[lane]);
+        chip::set_clock_rate((*cpus)[lane], 120);
+        chip::set_lane(*bank, lane, (*cpus)[lane]);
+    }
+
+    for(int i = 0 ; i < 400 ; i++)
+    {
+        for(chip::CPU& cpu : *cpus) chip::cycle(cpu);
+        chip::step_bank(*bank);
+
+        expect_same_lanes(*bank, *cpus);
+    }
+}
+
+TEST(BankTest, CanSplitDivergentLanes)
+{
+    std::unique_ptr<chip::CPUBank<16>>         bank{new chip::CPUBank<16>{}};
+    std::unique_ptr<std::array<chip::CPU, 16>> cpus{new std::array<chip::CPU, 16>{}};
+
+    for(uint32_t lane = 0 ; lane < 16 ; lane++)
+    {
+        chip::CPU& cpu = (*cpus)[lane];
+
+        chip::load_font_set(cpu);
+        load_program(cpu, divergent_program);
+
+        chip::set_clock_rate(cpu, 840);
+        chip::seed_random(cpu, lane);
+        cpu.key_pad = 0x5 << (lane % 6);
+
+        chip::set_lane(*bank, lane, cpu);
+    }
+
+    for(int i = 0 ; i < 2000 ; i++)
+    {
+        for(chip::CPU& cpu : *cpus) chip::cycle(cpu);
+        chip::step_bank(*bank);
+
+        expect_same_lanes(*bank, *cpus);
+    }
+
+    ASSERT_GT(bank->split_steps, 0);
+    ASSERT_LT(bank->split_steps, 2000);
+}
+
+TEST(BankTest, CanTrackDivergentMemory)
+{
+    std::unique_ptr<chip::CPUBank<4>> bank{new chip::CPUBank<4>{}};
+    chip::CPU cpu{};
+
+    for(uint32_t lane = 0 ; lane < 4 ; lane++) chip::set_lane(*bank, lane, cpu);
+
+    ASSERT_FALSE(chip::is_divergent(*bank, 0x300));
+
+    cpu.memory[0x300] = 0x1;
+    chip::set_lane(*bank, 2, cpu);
+
+    ASSERT_TRUE(chip::is_divergent(*bank, 0x300));
+    ASSERT_FALSE(chip::is_divergent(*bank, 0x301));
+
+    chip::mark_divergent(*bank, 0xFFF, 2);
+
+    ASSERT_TRUE(chip::is_divergent(*bank, 0xFFF));
+    ASSERT_TRUE(chip::is_divergent(*bank, 0x000));
+}
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include <array>
+
+#include "../include/opcode.h"
+#include "../include/cpu.h"
+#include "../include/batch.h"
+#include "./lockstep.h"
+
+TEST(BatchTest, CanRunCyclesInLockstep)
+{
+    chip::CPU expected{};
+    chip::CPU result{};
+
+    load_lockstep_program(expected);
+    load_lockstep_program(result);
+
+    for(int i = 0 ; i < 100 ; i++)
+    {
+        const chip::RunResult run = chip::run_cycles(result, 7);
+
+        ASSERT_EQ(run.reason, chip::STOP_BUDGET);
+        ASSERT_EQ(run.cycles, 7);
+
+        for(int j = 0 ; j < 7 ; j++) chip::cycle(expected);
+
+        expect_same_state(expected, result);
+    }
+}
+
+TEST(BatchTest, CanStopFrameOnDraw)
+{
+    chip::CPU expected{};
+    chip::CPU result{};
+
+    load_lockstep_program(expected);
+    load_lockstep_program(result);
+
+    chip::RunResult run{ chip::STOP_BUDGET, 0 };
+
+    for(int i = 0 ; i < 100 && run.reason != chip::STOP_DRAW ; i++)
+    {
+        run = chip::run_frame(result, 10);
+
+        for(uint64_t j = 0 ; j < run.cycles ; j++) chip::cycle(expected);
+    }
+
+    ASSERT_EQ(run.reason, chip::STOP_DRAW);
+    ASSERT_EQ(result.PC, 0x236);
+    ASSERT_TRUE(result.draw);
+    expect_same_state(expected, result);
+}
+
+TEST(BatchTest, CanStopWaitingForKey)
+{
+    chip::CPU cpu{};
+
+    cpu.memory[0x200] = 0xF3;
+    cpu.memory[0x201] = 0x0A;
+    cpu.DT = 10;
+    cpu.ST = 2;
+
+    const chip::RunResult waiting = chip::run_cycles(cpu, 4);
+
+    ASSERT_EQ(waiting.reason, chip::STOP_WAIT_KEY);
+    ASSERT_EQ(waiting.cycles, 4);
+    ASSERT_EQ(cpu.PC, 0x200);
+    ASSERT_EQ(chip::delay_timer(cpu), 6);
+    ASSERT_EQ(chip::sound_timer(cpu), 0);
+
+    cpu.key_pad = 0x1 << 0xB;
+
+    const chip::RunResult pressed = chip::run_cycles(cpu, 1);
+
+    ASSERT_EQ(pressed.reason, chip::STOP_BUDGET);
+    ASSERT_EQ(cpu.PC, 0x202);
+    ASSERT_EQ(cpu.V[3], 0xB);
+}
+
+TEST(BatchTest, CanRunUntilBreakpoint)
+{
+    chip::CPU cpu{};
+
+    load_lockstep_program(cpu);
+
+    const auto breakpoint = [](const chip::CPU& cpu) { return cpu.PC == 0x240; };
+
+    const chip::RunResult stopped = chip::run_until(cpu, 1000, breakpoint);
+
+    ASSERT_EQ(stopped.reason, chip::STOP_BREAKPOINT);
+    ASSERT_EQ(cpu.PC, 0x240);
+    ASSERT_EQ(cpu.SP, 1);
+
+    const chip::RunResult resumed = chip::run_until(cpu, 2, breakpoint);
+
+    ASSERT_EQ(resumed.reason, chip::STOP_BUDGET);
+    ASSERT_EQ(cpu.PC, 0x20C);
+}
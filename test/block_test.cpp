@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+#include <array>
+
+#include "../include/opcode.h"
+#include "../include/cpu.h"
+#include "../include/block.h"
+#include "./lockstep.h"
+
+static void run_lockstep(uint32_t budget, uint32_t clock_rate = chip::TIMER_RATE)
+{
+    chip::CPU expected{};
+    chip::CPU result{};
+    chip::BlockCache cache{};
+
+    load_lockstep_program(expected);
+    load_lockstep_program(result);
+
+    chip::set_clock_rate(expected, clock_rate);
+    chip::set_clock_rate(result, clock_rate);
+
+    for(int i = 0 ; i < 200 ; i++)
+    {
+        const uint32_t executed = chip::run_block(cache, result, budget);
+
+        for(uint32_t j = 0 ; j < executed ; j++) chip::cycle(expected);
+
+        expect_same_state(expected, result);
+    }
+}
+
+TEST(BlockTest, CanRunBlocksInLockstep)
+{
+    run_lockstep(0xFFFF);
+}
+
+TEST(BlockTest, CanRunBlocksWithSmallBudget)
+{
+    run_lockstep(1);
+}
+
+TEST(BlockTest, CanRunBlocksAtClockRate)
+{
+    run_lockstep(0xFFFF, 840);
+    run_lockstep(5, 840);
+    run_lockstep(7, 120);
+}
+
+TEST(BlockTest, CanRunExactBudgets)
+{
+    chip::CPU expected{};
+    chip::CPU result{};
+    chip::BlockCache cache{};
+
+    load_lockstep_program(expected);
+    load_lockstep_program(result);
+
+    chip::set_clock_rate(expected, 840);
+    chip::set_clock_rate(result, 840);
+
+    for(uint64_t budget = 1 ; budget < 200 ; budget++)
+    {
+        ASSERT_EQ(chip::run_blocks(cache, result, budget), budget);
+
+        for(uint64_t j = 0 ; j < budget ; j++) chip::cycle(expected);
+
+        expect_same_state(expected, result);
+    }
+}
+
+TEST(BlockTest, CanTranslateSuperinstructions)
+{
+    chip::CPU cpu{};
+    chip::BlockCache cache{};
+
+    load_lockstep_program(cpu);
+
+    const chip::Block& timer = chip::translate(cache, cpu, 0x200);
+
+    ASSERT_EQ(timer.size,   2);
+    ASSERT_EQ(timer.cycles, 5);
+    ASSERT_EQ(timer.end,    0x20A);
+    ASSERT_EQ(cache.ops[timer.first_op].kind,     chip::SET_DELAY_TIMER);
+    ASSERT_EQ(cache.ops[timer.first_op + 1].kind, chip::WAIT_DELAY_TIMER);
+    ASSERT_EQ(cache.ops[timer.first_op + 1].NN,   0x0);
+}
+
+TEST(BlockTest, CanInvalidateWrittenBlocks)
+{
+    chip::CPU cpu{};
+    chip::BlockCache cache{};
+
+    load_lockstep_program(cpu);
+    chip::clear_dirty(cpu);
+
+    chip::translate(cache, cpu, 0x216);
+    chip::translate(cache, cpu, 0x232);
+
+    chip::invalidate(cpu, 0x218, 2);
+    chip::invalidate_blocks(cache, cpu);
+
+    ASSERT_EQ(cache.index[0x216], 0);
+    ASSERT_NE(cache.index[0x232], 0);
+    ASSERT_FALSE(chip::is_dirty(cpu));
+}
@@ -4,6 +4,7 @@
 
 #include "../include/opcode.h"
 #include "../include/cpu.h"
+#include "./lockstep.h"
 
 TEST(CPUTest, CanDecodeChip8Instructions)
 {
@@ -95,6 +96,47 @@ TEST(CPUTest, CanDecodeChip8Instructions)
     }
 }
 
+TEST(CPUTest, CanPredecodeChip8Instructions)
+{
+    for(uint32_t i = 0 ; i < 0x10000 ; i++)
+    {
+        const std::array<uint8_t, 2> program {{ static_cast<uint8_t>(i >> 8), static_cast<uint8_t>(i & 0xFF) }};
+
+        const chip::OpCode       expected = chip::decode(program, 0);
+        const chip::Instruction& result   = chip::predecode(program, 0);
+
+        ASSERT_EQ(expected.code, result.op_code.code);
+        ASSERT_EQ(expected.data, result.op_code.data);
+        ASSERT_EQ(chip::get_handler_index(i), result.handler);
+    }
+
+    const chip::Instruction& draw = chip::decode_table()[0xD1A4];
+
+    ASSERT_EQ(draw.handler, chip::OP_0xD);
+    ASSERT_EQ(draw.X,   0x1);
+    ASSERT_EQ(draw.Y,   0xA);
+    ASSERT_EQ(draw.N,   0x4);
+    ASSERT_EQ(draw.NN,  0xA4);
+    ASSERT_EQ(draw.NNN, 0x1A4);
+}
+
+TEST(CPUTest, CanDispatchChip8Instructions)
+{
+    ASSERT_EQ(chip::get_handler(0x00E0), chip::op_code_0xE0);
+    ASSERT_EQ(chip::get_handler(0x00EE), chip::op_code_0xEE);
+    ASSERT_EQ(chip::get_handler(0x0123), chip::op_code_0x0);
+    ASSERT_EQ(chip::get_handler(0x1223), chip::op_code_0x1);
+    ASSERT_EQ(chip::get_handler(0x5210), chip::op_code_0x50);
+    ASSERT_EQ(chip::get_handler(0x5211), chip::op_code_0x0);
+    ASSERT_EQ(chip::get_handler(0x8914), chip::op_code_0x84);
+    ASSERT_EQ(chip::get_handler(0x831E), chip::op_code_0x8E);
+    ASSERT_EQ(chip::get_handler(0xD114), chip::op_code_0xD);
+    ASSERT_EQ(chip::get_handler(0xE1A1), chip::op_code_0xEA1);
+    ASSERT_EQ(chip::get_handler(0xF133), chip::op_code_0xF33);
+    ASSERT_EQ(chip::get_handler(0x9411), chip::op_code_0x0);
+    ASSERT_EQ(chip::get_handler(0xF1FF), chip::op_code_0x0);
+}
+
 TEST(CPUTest, CanExecute0xE0)
 {
     chip::OpCode op_code{};
@@ -103,11 +145,11 @@ TEST(CPUTest, CanExecute0xE0)
 
     chip::CPU cpu{};
 
-    for(int i = 0 ; i < cpu.screen.size() ; i++) cpu.screen[i] = 1;
+    cpu.screen.fill(~0x0ULL);
 
     op_code_0xE0(cpu, op_code);
 
-    for(int i = 0 ; i < cpu.screen.size() ; i++) ASSERT_EQ(cpu.screen[i], 0);
+    for(int i = 0 ; i < cpu.screen.size() ; i++) ASSERT_EQ(cpu.screen[i], 0x0);
 }
 
 TEST(CPUTest, CanExecute0x2)
@@ -442,7 +484,7 @@ TEST(CPUTest, CanExecute0xB)
     op_code_0xB(cpu, op_code);
     ASSERT_EQ(cpu.PC, 0x123 + 0x5);    
 }
-/*
+
 TEST(CPUTest, CanExecute0xC)
 {
     chip::OpCode op_code{};
@@ -450,12 +492,38 @@ TEST(CPUTest, CanExecute0xC)
     op_code.data = 0x233;
 
     chip::CPU cpu{};
-    uint8_t random = rand() % 256;
+    chip::CPU copy = cpu;
+    uint8_t random = chip::next_random(copy);
 
     op_code_0xC(cpu, op_code);
     ASSERT_EQ(cpu.V[2], 0x33 & random);
+    ASSERT_EQ(cpu.random_state, copy.random_state);
+}
+
+TEST(CPUTest, CanSeedRandomNumbers)
+{
+    chip::CPU first{};
+    chip::CPU second{};
+    chip::CPU other{};
+
+    chip::seed_random(first, 42);
+    chip::seed_random(second, 42);
+    chip::seed_random(other, 43);
+
+    std::array<uint8_t, 16> sequence{};
+    std::array<uint8_t, 16> repeated{};
+    std::array<uint8_t, 16> different{};
+
+    for(int i = 0 ; i < 16 ; i++)
+    {
+        sequence[i]  = chip::next_random(first);
+        repeated[i]  = chip::next_random(second);
+        different[i] = chip::next_random(other);
+    }
+
+    ASSERT_EQ(sequence, repeated);
+    ASSERT_NE(sequence, different);
 }
-*/
 TEST(CPUTest, CanExecute0xD)
 {
     chip::OpCode op_code{};
@@ -475,30 +543,124 @@ TEST(CPUTest, CanExecute0xD)
 
     op_code_0xD(cpu, op_code);
 
-    ASSERT_EQ(cpu.screen[8],  0x1); ASSERT_EQ(cpu.screen[9],  0x1);
-    ASSERT_EQ(cpu.screen[10], 0x1); ASSERT_EQ(cpu.screen[11], 0x1);
-    ASSERT_EQ(cpu.screen[12], 0x0); ASSERT_EQ(cpu.screen[13], 0x0);
-    ASSERT_EQ(cpu.screen[14], 0x0); ASSERT_EQ(cpu.screen[15], 0x0);
+    ASSERT_TRUE(chip::get_pixel(cpu, 8, 0)); ASSERT_TRUE(chip::get_pixel(cpu, 9, 0));
+    ASSERT_TRUE(chip::get_pixel(cpu, 10, 0)); ASSERT_TRUE(chip::get_pixel(cpu, 11, 0));
+    ASSERT_FALSE(chip::get_pixel(cpu, 12, 0)); ASSERT_FALSE(chip::get_pixel(cpu, 13, 0));
+    ASSERT_FALSE(chip::get_pixel(cpu, 14, 0)); ASSERT_FALSE(chip::get_pixel(cpu, 15, 0));
 
-    ASSERT_EQ(cpu.screen[72], 0x1); ASSERT_EQ(cpu.screen[73], 0x0);
-    ASSERT_EQ(cpu.screen[74], 0x0); ASSERT_EQ(cpu.screen[75], 0x1);
-    ASSERT_EQ(cpu.screen[76], 0x0); ASSERT_EQ(cpu.screen[77], 0x0);
-    ASSERT_EQ(cpu.screen[78], 0x0); ASSERT_EQ(cpu.screen[79], 0x0);
+    ASSERT_TRUE(chip::get_pixel(cpu, 8, 1)); ASSERT_FALSE(chip::get_pixel(cpu, 9, 1));
+    ASSERT_FALSE(chip::get_pixel(cpu, 10, 1)); ASSERT_TRUE(chip::get_pixel(cpu, 11, 1));
+    ASSERT_FALSE(chip::get_pixel(cpu, 12, 1)); ASSERT_FALSE(chip::get_pixel(cpu, 13, 1));
+    ASSERT_FALSE(chip::get_pixel(cpu, 14, 1)); ASSERT_FALSE(chip::get_pixel(cpu, 15, 1));
 
-    ASSERT_EQ(cpu.screen[136], 0x1); ASSERT_EQ(cpu.screen[137], 0x0);
-    ASSERT_EQ(cpu.screen[138], 0x0); ASSERT_EQ(cpu.screen[139], 0x1);
-    ASSERT_EQ(cpu.screen[140], 0x0); ASSERT_EQ(cpu.screen[141], 0x0);
-    ASSERT_EQ(cpu.screen[142], 0x0); ASSERT_EQ(cpu.screen[143], 0x0);
+    ASSERT_TRUE(chip::get_pixel(cpu, 8, 2)); ASSERT_FALSE(chip::get_pixel(cpu, 9, 2));
+    ASSERT_FALSE(chip::get_pixel(cpu, 10, 2)); ASSERT_TRUE(chip::get_pixel(cpu, 11, 2));
+    ASSERT_FALSE(chip::get_pixel(cpu, 12, 2)); ASSERT_FALSE(chip::get_pixel(cpu, 13, 2));
+    ASSERT_FALSE(chip::get_pixel(cpu, 14, 2)); ASSERT_FALSE(chip::get_pixel(cpu, 15, 2));
     
-    ASSERT_EQ(cpu.screen[200], 0x1); ASSERT_EQ(cpu.screen[201], 0x0);
-    ASSERT_EQ(cpu.screen[202], 0x0); ASSERT_EQ(cpu.screen[203], 0x1);
-    ASSERT_EQ(cpu.screen[204], 0x0); ASSERT_EQ(cpu.screen[205], 0x0);
-    ASSERT_EQ(cpu.screen[206], 0x0); ASSERT_EQ(cpu.screen[207], 0x0);
+    ASSERT_TRUE(chip::get_pixel(cpu, 8, 3)); ASSERT_FALSE(chip::get_pixel(cpu, 9, 3));
+    ASSERT_FALSE(chip::get_pixel(cpu, 10, 3)); ASSERT_TRUE(chip::get_pixel(cpu, 11, 3));
+    ASSERT_FALSE(chip::get_pixel(cpu, 12, 3)); ASSERT_FALSE(chip::get_pixel(cpu, 13, 3));
+    ASSERT_FALSE(chip::get_pixel(cpu, 14, 3)); ASSERT_FALSE(chip::get_pixel(cpu, 15, 3));
+
+    ASSERT_TRUE(chip::get_pixel(cpu, 8, 4)); ASSERT_TRUE(chip::get_pixel(cpu, 9, 4));
+    ASSERT_TRUE(chip::get_pixel(cpu, 10, 4)); ASSERT_TRUE(chip::get_pixel(cpu, 11, 4));
+    ASSERT_FALSE(chip::get_pixel(cpu, 12, 4)); ASSERT_FALSE(chip::get_pixel(cpu, 13, 4));
+    ASSERT_FALSE(chip::get_pixel(cpu, 14, 4)); ASSERT_FALSE(chip::get_pixel(cpu, 15, 4));
+}
+
+TEST(CPUTest, CanClipSpritesOnTheEdges)
+{
+    chip::OpCode op_code{};
+    op_code.code = 0xD;
+    op_code.data = 0x013;
+
+    chip::CPU cpu{};
+    cpu.V[0] = 60 + 64;
+    cpu.V[1] = 30;
+    cpu.I    = 0x2;
+
+    cpu.memory[2] = 0xFF;
+    cpu.memory[3] = 0xFF;
+    cpu.memory[4] = 0xFF;
+
+    op_code_0xD(cpu, op_code);
+
+    ASSERT_EQ(cpu.screen[30], 0xF);
+    ASSERT_EQ(cpu.screen[31], 0xF);
+    ASSERT_EQ(cpu.screen[0],  0x0);
+    ASSERT_EQ(cpu.screen[29], 0x0);
+    ASSERT_EQ(cpu.V[0xF], 0x0);
+}
+
+TEST(CPUTest, CanDetectSpriteCollisions)
+{
+    chip::OpCode op_code{};
+    op_code.code = 0xD;
+    op_code.data = 0x011;
+
+    chip::CPU cpu{};
+    cpu.V[0] = 4;
+    cpu.V[1] = 0;
+    cpu.I    = 0x2;
+
+    cpu.memory[2] = 0x81;
+
+    op_code_0xD(cpu, op_code);
+    ASSERT_EQ(cpu.V[0xF], 0x0);
+
+    cpu.V[0] = 11;
+    op_code_0xD(cpu, op_code);
 
-    ASSERT_EQ(cpu.screen[264], 0x1); ASSERT_EQ(cpu.screen[265], 0x1);
-    ASSERT_EQ(cpu.screen[266], 0x1); ASSERT_EQ(cpu.screen[267], 0x1);
-    ASSERT_EQ(cpu.screen[268], 0x0); ASSERT_EQ(cpu.screen[269], 0x0);
-    ASSERT_EQ(cpu.screen[270], 0x0); ASSERT_EQ(cpu.screen[271], 0x0);
+    ASSERT_EQ(cpu.V[0xF], 0x1);
+    ASSERT_TRUE(chip::get_pixel(cpu, 4, 0));
+    ASSERT_FALSE(chip::get_pixel(cpu, 11, 0));
+    ASSERT_TRUE(chip::get_pixel(cpu, 18, 0));
+}
+
+TEST(CPUTest, CanTrackChangedPixels)
+{
+    chip::OpCode draw{};
+    draw.code = 0xD;
+    draw.data = 0x012;
+
+    chip::OpCode clear{};
+    clear.code = 0xE0;
+    clear.data = 0x0;
+
+    chip::CPU cpu{};
+    cpu.V[0] = 60;
+    cpu.V[1] = 4;
+
+    ASSERT_FALSE(chip::has_changed(cpu));
+
+    op_code_0xD(cpu, draw);
+
+    ASSERT_TRUE(chip::has_changed(cpu));
+    ASSERT_EQ(cpu.changed.left,   60);
+    ASSERT_EQ(cpu.changed.top,    4);
+    ASSERT_EQ(cpu.changed.right,  64);
+    ASSERT_EQ(cpu.changed.bottom, 6);
+
+    cpu.V[0] = 10;
+    cpu.V[1] = 2;
+
+    op_code_0xD(cpu, draw);
+
+    ASSERT_EQ(cpu.changed.left,   10);
+    ASSERT_EQ(cpu.changed.top,    2);
+    ASSERT_EQ(cpu.changed.right,  64);
+    ASSERT_EQ(cpu.changed.bottom, 6);
+
+    chip::clear_changed(cpu);
+    ASSERT_FALSE(chip::has_changed(cpu));
+
+    op_code_0xE0(cpu, clear);
+
+    ASSERT_EQ(cpu.changed.left,   0);
+    ASSERT_EQ(cpu.changed.top,    0);
+    ASSERT_EQ(cpu.changed.right,  64);
+    ASSERT_EQ(cpu.changed.bottom, 32);
 }
 
 TEST(CPUTest, CanExecute0xE9E)
@@ -741,4 +903,80 @@ TEST(CPUTest, CanLoadROM)
 
     for(int i = 0; i < program.size() ; i++) 
         ASSERT_EQ(cpu.memory[chip::ROM_START + i], program[i]);
-}
\ No newline at end of file
+}
+
+TEST(CPUTest, CanRunSelfModifyingCode)
+{
+    chip::CPU cpu{};
+
+    std::array<uint8_t, 12> program 
+    {{
+        0x73, 0x01, // V3 += 1.
+        0xA2, 0x00, // I = 0x200.
+        0x60, 0x72, // V0 = 0x72.
+        0x61, 0x05, // V1 = 0x05.
+        0xF1, 0x55, // Overwrite the instruction at 0x200 with 0x7205 (V2 += 5).
+        0x11, 0xFE  // Jump back to 0x200.
+    }};
+
+    load_program(cpu, program);
+
+    for(int i = 0; i < 6 ; i++) chip::cycle(cpu);
+
+    ASSERT_EQ(cpu.PC, 0x200);
+    ASSERT_EQ(cpu.V[3], 0x1);
+    ASSERT_EQ(cpu.decoded[0x200].handler, chip::NOT_DECODED);
+
+    chip::cycle(cpu);
+
+    ASSERT_EQ(cpu.V[2], 0x5);
+    ASSERT_EQ(cpu.V[3], 0x1);
+}
+
+TEST(CPUTest, CanInvalidateDecodedInstructions)
+{
+    chip::CPU cpu{};
+
+    cpu.decoded[0x1FF].handler = chip::OP_0x1;
+    cpu.decoded[0x200].handler = chip::OP_0x1;
+    cpu.decoded[0x201].handler = chip::OP_0x1;
+    cpu.decoded[0x202].handler = chip::OP_0x1;
+
+    chip::invalidate(cpu, 0x200, 2);
+
+    ASSERT_EQ(cpu.decoded[0x1FF].handler, chip::NOT_DECODED);
+    ASSERT_EQ(cpu.decoded[0x200].handler, chip::NOT_DECODED);
+    ASSERT_EQ(cpu.decoded[0x201].handler, chip::NOT_DECODED);
+    ASSERT_EQ(cpu.decoded[0x202].handler, chip::OP_0x1);
+}
+
+TEST(CPUTest, CanTickTimersAtClockRate)
+{
+    chip::CPU cpu{};
+
+    chip::set_clock_rate(cpu, 600);
+
+    cpu.V[1] = 5;
+    cpu.memory[0x200] = 0xF1;
+    cpu.memory[0x201] = 0x15;
+    cpu.memory[0x202] = 0xF1;
+    cpu.memory[0x203] = 0x18;
+
+    chip::cycle(cpu);
+    chip::cycle(cpu);
+
+    ASSERT_EQ(cpu.cycles_per_tick, 10);
+    ASSERT_EQ(chip::delay_timer(cpu), 5);
+    ASSERT_EQ(chip::sound_timer(cpu), 5);
+
+    for(int i = 0 ; i < 28 ; i++) chip::cycle(cpu);
+
+    ASSERT_EQ(cpu.cycles, 30);
+    ASSERT_EQ(chip::delay_timer(cpu), 2);
+    ASSERT_EQ(chip::sound_timer(cpu), 2);
+
+    for(int i = 0 ; i < 30 ; i++) chip::cycle(cpu);
+
+    ASSERT_EQ(chip::delay_timer(cpu), 0);
+    ASSERT_EQ(chip::sound_timer(cpu), 0);
+}
@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+#include <cstdint>
+
+#include "../include/opcode.h"
+#include "../include/cpu.h"
+#include "../include/batch.h"
+#include "../include/debbuger.h"
+#include "./lockstep.h"
+
+TEST(DebuggerTest, CanRunLikeCycleWithoutBreakpoints)
+{
+    chip::CPU expected{};
+    chip::CPU result{};
+    chip::Debugger debugger{};
+
+    load_lockstep_program(expected);
+    load_lockstep_program(result);
+
+    for(int i = 0 ; i < 500 ; i++) chip::cycle(expected);
+
+    // A breakpoint the program never reaches doesn't change how it runs.
+    chip::set_debug_flags(debugger, 0x700, chip::DEBUG_BREAK | chip::DEBUG_WATCH_WRITE, true);
+
+    const chip::RunResult run = chip::debug_continue(result, debugger, 500);
+
+    ASSERT_EQ(run.reason, chip::STOP_BUDGET);
+    ASSERT_EQ(debugger.hit, chip::HIT_NONE);
+
+    expect_same_state(expected, result);
+
+    chip::set_debug_flags(debugger, 0x700, chip::DEBUG_BREAK | chip::DEBUG_WATCH_WRITE, false);
+
+    ASSERT_EQ(debugger.breakpoints, 0);
+    ASSERT_EQ(debugger.watchpoints, 0);
+}
+
+TEST(DebuggerTest, CanStopAtBreakpoints)
+{
+    chip::CPU cpu{};
+    chip::Debugger debugger{};
+
+    load_lockstep_program(cpu);
+
+    chip::set_debug_flags(debugger, 0x234, chip::DEBUG_BREAK, true);
+
+    chip::RunResult run = chip::debug_continue(cpu, debugger, 1000);
+
+    ASSERT_EQ(run.reason,       chip::STOP_BREAKPOINT);
+    ASSERT_EQ(cpu.PC,           0x234);
+    ASSERT_EQ(debugger.hit,     chip::HIT_BREAKPOINT);
+    ASSERT_EQ(debugger.address, 0x234);
+
+    const uint64_t cycles = cpu.cycles;
+
+    // Continuing runs the instruction at the breakpoint and the jump back to it.
+    run = chip::debug_continue(cpu, debugger, 1000);
+
+    ASSERT_EQ(run.reason, chip::STOP_BREAKPOINT);
+    ASSERT_EQ(cpu.PC,     0x234);
+    ASSERT_EQ(cpu.cycles, cycles + 2);
+
+    // Stepping ignores the breakpoint.
+    run = chip::debug_step(cpu, debugger);
+
+    ASSERT_EQ(run.cycles, 1);
+    ASSERT_EQ(cpu.PC,     0x236);
+}
+
+TEST(DebuggerTest, CanStopBeforeWatchedMemoryIsAccessed)
+{
+    chip::CPU cpu{};
+    chip::Debugger debugger{};
+
+    load_lockstep_program(cpu);
+
+    // The program overwrites the instruction at 0x218 with FX55 at 0x22A.
+    chip::set_debug_flags(debugger, 0x219, chip::DEBUG_WATCH_WRITE, true);
+
+    chip::RunResult run = chip::debug_continue(cpu, debugger, 1000);
+
+    ASSERT_EQ(run.reason,       chip::STOP_BREAKPOINT);
+    ASSERT_EQ(cpu.PC,           0x22A);
+    ASSERT_EQ(debugger.hit,     chip::HIT_WRITE);
+    ASSERT_EQ(debugger.address, 0x219);
+    ASSERT_EQ(cpu.memory[0x219], 0x01);
+
+    chip::debug_step(cpu, debugger);
+
+    ASSERT_EQ(cpu.memory[0x219], 0x10);
+
+    // The sprite of digit 0 is read by DXYN at 0x234.
+    chip::set_debug_flags(debugger, 0x219, chip::DEBUG_WATCH_WRITE, false);
+    chip::set_debug_flags(debugger, 0x002, chip::DEBUG_WATCH_READ,  true);
+
+    run = chip::debug_continue(cpu, debugger, 1000);
+
+    ASSERT_EQ(run.reason,       chip::STOP_BREAKPOINT);
+    ASSERT_EQ(cpu.PC,           0x234);
+    ASSERT_EQ(debugger.hit,     chip::HIT_READ);
+    ASSERT_EQ(debugger.address, 0x002);
+}
+
+TEST(DebuggerTest, CanRunToAnAddress)
+{
+    chip::CPU cpu{};
+    chip::Debugger debugger{};
+
+    load_lockstep_program(cpu);
+
+    chip::RunResult run = chip::debug_run_to(cpu, debugger, 0x240, 1000);
+
+    ASSERT_EQ(run.reason,   chip::STOP_BREAKPOINT);
+    ASSERT_EQ(cpu.PC,       0x240);
+    ASSERT_EQ(cpu.SP,       1);
+    ASSERT_EQ(debugger.hit, chip::HIT_RUN_TO);
+
+    // A breakpoint before the address stops the run first.
+    chip::set_debug_flags(debugger, 0x20C, chip::DEBUG_BREAK, true);
+
+    run = chip::debug_run_to(cpu, debugger, 0x232, 1000);
+
+    ASSERT_EQ(cpu.PC,       0x20C);
+    ASSERT_EQ(debugger.hit, chip::HIT_BREAKPOINT);
+}
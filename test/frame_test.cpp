@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <thread>
+
+#include "../include/opcode.h"
+#include "../include/cpu.h"
+#include "../include/frame.h"
+
+TEST(FrameTest, CanTakeTheNewestFrame)
+{
+    chip::CPU cpu{};
+    chip::FrameBuffer buffer{};
+
+    ASSERT_EQ(chip::take_frame(buffer), nullptr);
+
+    cpu.screen[0] = 0x1;
+    chip::publish_frame(buffer, cpu);
+
+    cpu.screen[0] = 0x2;
+    chip::publish_frame(buffer, cpu);
+
+    const chip::Frame* frame = chip::take_frame(buffer);
+
+    ASSERT_NE(frame, nullptr);
+    ASSERT_EQ(frame->sequence, 2);
+    ASSERT_EQ(frame->screen[0], 0x2);
+    ASSERT_EQ(chip::take_frame(buffer), nullptr);
+
+    chip::frame_presented(buffer);
+
+    ASSERT_EQ(buffer.published, 2);
+    ASSERT_EQ(buffer.presented, 1);
+    ASSERT_EQ(buffer.dropped,   1);
+}
+
+TEST(FrameTest, CanKeepChangesOfDroppedFrames)
+{
+    chip::CPU cpu{};
+    chip::FrameBuffer buffer{};
+
+    chip::mark_changed(cpu, chip::ScreenRect{ 0, 0, 8, 5 });
+    chip::publish_frame(buffer, cpu);
+
+    ASSERT_FALSE(chip::has_changed(cpu));
+
+    chip::mark_changed(cpu, chip::ScreenRect{ 56, 27, 64, 32 });
+    chip::publish_frame(buffer, cpu);
+
+    const chip::Frame* dropped = chip::take_frame(buffer);
+
+    ASSERT_EQ(dropped->changed.left,   0);
+    ASSERT_EQ(dropped->changed.top,    0);
+    ASSERT_EQ(dropped->changed.right,  64);
+    ASSERT_EQ(dropped->changed.bottom, 32);
+
+    chip::mark_changed(cpu, chip::ScreenRect{ 10, 10, 18, 12 });
+    chip::publish_frame(buffer, cpu);
+
+    const chip::Frame* frame = chip::take_frame(buffer);
+
+    ASSERT_EQ(frame->changed.left,   10);
+    ASSERT_EQ(frame->changed.top,    10);
+    ASSERT_EQ(frame->changed.right,  18);
+    ASSERT_EQ(frame->changed.bottom, 12);
+}
+
+TEST(FrameTest, CanHandOffFramesBetweenThreads)
+{
+    const uint64_t FRAMES = 20000;
+
+    chip::FrameBuffer buffer{};
+
+    std::thread producer{[&]()
+    {
+        chip::CPU cpu{};
+
+        for(uint64_t i = 1 ; i <= FRAMES ; i++)
+        {
+            cpu.screen.fill(i);
+            chip::publish_frame(buffer, cpu);
+        }
+    }};
+
+    uint64_t last = 0;
+
+    while(last < FRAMES)
+    {
+        const chip::Frame* frame = chip::take_frame(buffer);
+
+        if(frame == nullptr) continue;
+
+        ASSERT_GT(frame->sequence, last);
+
+        for(uint64_t row : frame->screen) ASSERT_EQ(row, frame->sequence);
+
+        last = frame->sequence;
+        chip::frame_presented(buffer);
+    }
+
+    producer.join();
+
+    ASSERT_EQ(buffer.published, FRAMES);
+    ASSERT_EQ(buffer.presented + buffer.dropped, FRAMES);
+}
+
+TEST(FrameTest, CanConvertScreenToARGB)
+{
+    std::array<uint64_t, 32> screen{};
+    std::array<uint32_t, chip::SCREEN_WIDHT * chip::SCREEN_HEIGHT> pixels{};
+
+    for(int y = 0 ; y < 32 ; y++) screen[y] = 0x9E3779B97F4A7C15ULL * (y + 1);
+
+    const chip::ScreenRect rect{ 3, 2, 61, 30 };
+    chip::screen_to_argb(screen, rect, pixels.data());
+
+    for(uint32_t y = 0 ; y < chip::SCREEN_HEIGHT ; y++)
+    {
+        for(uint32_t x = 0 ; x < chip::SCREEN_WIDHT ; x++)
+        {
+            const bool     inside   = x >= rect.left && x < rect.right && y >= rect.top && y < rect.bottom;
+            const uint32_t expected = !inside ? 0x0 : chip::get_pixel(screen, x, y) ? 0xFFFFFFFF : 0xFF000000;
+
+            ASSERT_EQ(pixels[x + y * chip::SCREEN_WIDHT], expected);
+        }
+    }
+}
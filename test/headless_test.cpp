@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <sstream>
+#include <stdexcept>
+
+#include "../include/opcode.h"
+#include "../include/cpu.h"
+#include "../include/headless.h"
+#include "./lockstep.h"
+
+TEST(HeadlessTest, CanHashScreens)
+{
+    chip::CPU first{};
+    chip::CPU second{};
+
+    ASSERT_EQ(chip::screen_hash(first.screen), chip::screen_hash(second.screen));
+
+    first.screen[31] = 0x1;
+
+    ASSERT_NE(chip::screen_hash(first.screen), chip::screen_hash(second.screen));
+
+    second.screen[31] = 0x1;
+
+    ASSERT_EQ(chip::screen_hash(first.screen), chip::screen_hash(second.screen));
+}
+
+TEST(HeadlessTest, CanWritePPM)
+{
+    chip::CPU cpu{};
+    std::ostringstream output;
+
+    cpu.screen[0] = 0x1ULL << 63;
+
+    chip::write_ppm(output, cpu.screen, 2);
+
+    const std::string image  = output.str();
+    const std::string header = "P6\n128 64\n255\n";
+
+    ASSERT_EQ(image.size(), header.size() + 128 * 64 * 3);
+    ASSERT_EQ(image.substr(0, header.size()), header);
+    ASSERT_EQ(static_cast<uint8_t>(image[header.size()]),           0xFF);
+    ASSERT_EQ(static_cast<uint8_t>(image[header.size() + 3]),       0xFF);
+    ASSERT_EQ(static_cast<uint8_t>(image[header.size() + 6]),       0x00);
+    ASSERT_EQ(static_cast<uint8_t>(image[header.size() + 128 * 3]), 0xFF);
+}
+
+TEST(HeadlessTest, CanParseInputScripts)
+{
+    std::istringstream script{"# Hold key 5 for a second.\n120 0x0000\n60  0x0020 # press\n\n"};
+
+    const std::vector<chip::InputEvent> events = chip::parse_input(script);
+
+    ASSERT_EQ(events.size(), 2);
+    ASSERT_EQ(events[0].frame,   60);
+    ASSERT_EQ(events[0].key_pad, 0x20);
+    ASSERT_EQ(events[1].frame,   120);
+    ASSERT_EQ(events[1].key_pad, 0x0);
+
+    std::istringstream invalid{"60 0x20\nabc\n"};
+
+    ASSERT_THROW(chip::parse_input(invalid), std::runtime_error);
+}
+
+TEST(HeadlessTest, CanRunInputScripts)
+{
+    chip::CPU pressed{};
+    chip::CPU idle{};
+
+    // Store the key pad wait result in V0 and loop on 1200.
+    const std::array<uint8_t, 4> program = {{ 0xF0, 0x0A, 0x11, 0xFE }};
+
+    load_program(pressed, program);
+    load_program(idle, program);
+
+    chip::run_scripted(pressed, { chip::InputEvent{ 2, 0x0020 } }, 10 * 14, 14);
+    chip::run_scripted(idle,    {},                                10 * 14, 14);
+
+    ASSERT_EQ(pressed.V[0], 0x5);
+    ASSERT_EQ(pressed.cycles, 10 * 14);
+    ASSERT_EQ(idle.cycles,    10 * 14);
+    ASSERT_NE(chip::state_hash(pressed), chip::state_hash(idle));
+}
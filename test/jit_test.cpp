@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <random>
+
+#include "../include/opcode.h"
+#include "../include/cpu.h"
+#include "../include/jit.h"
+#include "./lockstep.h"
+
+static void run_lockstep(chip::CPU& expected, chip::CPU& result, chip::Jit& jit, int steps)
+{
+    for(int i = 0 ; i < steps ; i++)
+    {
+        // Budgets below and above the size of the blocks, so both compiled and interpreted code run.
+        const uint64_t budget   = 1 + i % chip::MAX_BLOCK_SIZE;
+        const uint64_t executed = chip::run_jit(jit, result, budget);
+
+        ASSERT_EQ(executed, budget);
+
+        for(uint64_t j = 0 ; j < executed ; j++) chip::cycle(expected);
+
+        expect_same_state(expected, result);
+    }
+}
+
+TEST(JitTest, CanRunCompiledCodeInLockstep)
+{
+    chip::CPU expected{};
+    chip::CPU result{};
+    chip::Jit jit{1};
+
+    load_lockstep_program(expected);
+    load_lockstep_program(result);
+
+    run_lockstep(expected, result, jit, 300);
+
+    if(chip::CHIP8_JIT_AVAILABLE) 
+    {
+        ASSERT_FALSE(jit.blocks.empty());
+    }
+}
+
+TEST(JitTest, CanRunRandomArithmeticInLockstep)
+{
+    std::mt19937 random{1234};
+
+    // Instructions that are emitted natively, with random registers and values.
+    const std::array<uint16_t, 17> families
+    {{
+        0x6000, 0x7000, 0x8000, 0x8001, 0x8002, 0x8003, 0x8004, 0x8005,
+        0x8006, 0x8007, 0x800E, 0xA000, 0xF01E, 0x3000, 0x4000, 0x5000, 0x9000
+    }};
+
+    for(int program = 0 ; program < 50 ; program++)
+    {
+        chip::CPU expected{};
+        chip::CPU result{};
+        chip::Jit jit{2};
+
+        uint16_t address = chip::ROM_START;
+
+        for(int i = 0 ; i < 40 ; i++)
+        {
+            const uint16_t family = families[random() % families.size()];
+            uint16_t instruction  = family;
+
+            if((family & 0xF000) == 0x8000 || family == 0x5000 || family == 0x9000)
+                instruction |= ((random() % 16) << 8) | ((random() % 16) << 4);
+            else if(family == 0xF01E)
+                instruction |= (random() % 16) << 8;
+            else if(family == 0xA000)
+                instruction |= random() % 0x1000;
+            else
+                instruction |= ((random() % 16) << 8) | (random() % 256);
+
+            expected.memory[address]     = result.memory[address]     = instruction >> 8;
+            expected.memory[address + 1] = result.memory[address + 1] = instruction & 0xFF;
+            address += 2;
+        }
+
+        // Jump back to the start of the program, twice in case the last instruction skips.
+        for(int i = 0 ; i < 4 ; i += 2)
+        {
+            expected.memory[address + i]     = result.memory[address + i]     = 0x11;
+            expected.memory[address + i + 1] = result.memory[address + i + 1] = 0xFE;
+        }
+
+        for(int i = 0 ; i < 16 ; i++) expected.V[i] = result.V[i] = random() % 256;
+
+        run_lockstep(expected, result, jit, 200);
+
+        if(chip::CHIP8_JIT_AVAILABLE) 
+        {
+            ASSERT_FALSE(jit.blocks.empty());
+        }
+    }
+}
+
+TEST(JitTest, CanInvalidateCompiledBlocks)
+{
+    chip::CPU cpu{};
+    chip::Jit jit{1};
+
+    load_lockstep_program(cpu);
+    chip::clear_dirty(cpu);
+
+    cpu.PC = 0x216;
+    chip::run_jit(jit, cpu, 1);
+
+    if(!chip::CHIP8_JIT_AVAILABLE) return;
+
+    ASSERT_NE(jit.index[0x216], 0);
+
+    chip::invalidate(cpu, 0x218, 2);
+    chip::invalidate_jit(jit, cpu);
+
+    ASSERT_EQ(jit.index[0x216], 0);
+}
@@ -0,0 +1,53 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include <gtest/gtest.h>
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "../include/opcode.h"
+#include "../include/cpu.h"
+#include "./lockstep_program.h"
+
+/**
+ *  Copy a program to the start of the memory of a cpu, a list of bytes
+ *  between braces is taken as a vector.
+ */
+template<typename Program = std::vector<uint8_t>>
+static inline void load_program(chip::CPU& cpu, const Program& program)
+{
+    for(size_t i = 0 ; i < program.size() ; i++) cpu.memory[chip::ROM_START + i] = program[i];
+
+    chip::invalidate(cpu, chip::ROM_START, program.size());
+}
+
+static inline void load_lockstep_program(chip::CPU& cpu)
+{
+    chip::load_font_set(cpu);
+
+    load_program(cpu, lockstep_program);
+}
+
+static inline void expect_same_state(const chip::CPU& expected, const chip::CPU& result)
+{
+    ASSERT_EQ(expected.PC, result.PC);
+    ASSERT_EQ(expected.I,  result.I);
+    ASSERT_EQ(expected.SP, result.SP);
+    ASSERT_EQ(expected.cycles, result.cycles);
+    ASSERT_EQ(expected.random_state, result.random_state);
+    ASSERT_EQ(chip::delay_timer(expected), chip::delay_timer(result));
+    ASSERT_EQ(chip::sound_timer(expected), chip::sound_timer(result));
+    ASSERT_EQ(expected.draw,   result.draw);
+    ASSERT_EQ(expected.V,      result.V);
+    ASSERT_EQ(expected.stack,  result.stack);
+    ASSERT_EQ(expected.memory, result.memory);
+    ASSERT_EQ(expected.screen, result.screen);
+    ASSERT_EQ(expected.changed.left,   result.changed.left);
+    ASSERT_EQ(expected.changed.top,    result.changed.top);
+    ASSERT_EQ(expected.changed.right,  result.changed.right);
+    ASSERT_EQ(expected.changed.bottom, result.changed.bottom);
+}
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef LOCKSTEP_PROGRAM_H
+#define LOCKSTEP_PROGRAM_H
+
+#include <array>
+#include <cstdint>
+
+/**
+ *  A program that goes through calls, skips, the delay timer, BCD,
+ *  self-modifying code and sprites so, every backend can be checked
+ *  against cycle() instruction by instruction.
+ */ 
+static const std::array<uint8_t, 68> lockstep_program
+{{
+    0x61, 0x05, // 0x200 V1 = 5.
+    0xF1, 0x15, // 0x202 DT = V1 (fused with the previous instruction).
+    0xF1, 0x07, // 0x204 V1 = DT.
+    0x31, 0x00, // 0x206 Skip next instruction if V1 == 0.
+    0x12, 0x02, // 0x208 Jump back to 0x204 (fused delay timer loop).
+    0x22, 0x40, // 0x20A Call subroutine at 0x240.
+    0xA3, 0x00, // 0x20C I = 0x300.
+    0xF2, 0x33, // 0x20E Store BCD of V2 at I.
+    0x72, 0x01, // 0x210 V2 += 1.
+    0x32, 0x05, // 0x212 Skip next instruction if V2 == 5.
+    0x12, 0x0A, // 0x214 Jump back to 0x20C.
+    0x7C, 0x01, // 0x216 VC += 1.
+    0x7D, 0x01, // 0x218 VD += 1, overwritten with VD += 0x10.
+    0x3C, 0x02, // 0x21A Skip next instruction if VC == 2.
+    0x12, 0x22, // 0x21C Jump to 0x224.
+    0x12, 0x30, // 0x21E Jump to 0x232.
+    0x00, 0x00, // 0x220
+    0x00, 0x00, // 0x222
+    0xA2, 0x18, // 0x224 I = 0x218.
+    0x60, 0x7D, // 0x226 V0 = 0x7D.
+    0x61, 0x10, // 0x228 V1 = 0x10.
+    0xF1, 0x55, // 0x22A Overwrite the instruction at 0x218.
+    0x12, 0x14, // 0x22C Jump back to 0x216.
+    0x00, 0x00, // 0x22E
+    0x00, 0x00, // 0x230
+    0xF0, 0x29, // 0x232 I = sprite of digit 0.
+    0xD1, 0x25, // 0x234 Draw the digit at (V1, V2).
+    0x12, 0x32, // 0x236 Jump back to 0x234.
+    0x00, 0x00, // 0x238
+    0x00, 0x00, // 0x23A
+    0x00, 0x00, // 0x23C
+    0x00, 0x00, // 0x23E
+    0x80, 0x14, // 0x240 V0 += V1.
+    0x00, 0xEE  // 0x242 Return from subroutine.
+}};
+
+#endif
@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <sstream>
+
+#include "../include/opcode.h"
+#include "../include/cpu.h"
+#include "../include/batch.h"
+#include "../include/movie.h"
+#include "./lockstep.h"
+
+/**
+ *  A program whose state depends on the key pad, the random generator
+ *  and the delay timer.
+ */
+static const std::array<uint8_t, 22> key_program
+{{
+    0xC0, 0x0F, // 0x200 V0 = random & 0xF.
+    0xE0, 0x9E, // 0x202 Skip next instruction if key V0 is pressed.
+    0x12, 0x08, // 0x204 Jump to 0x20A.
+    0x71, 0x01, // 0x206 V1 += 1.
+    0xF2, 0x0A, // 0x208 Wait for a key and store it on V2.
+    0xF0, 0x15, // 0x20A DT = V0.
+    0xA3, 0x00, // 0x20C I = 0x300.
+    0xF1, 0x33, // 0x20E Store BCD of V1 at I.
+    0xD3, 0x43, // 0x210 Draw the digits at (V3, V4).
+    0x73, 0x03, // 0x212 V3 += 3.
+    0x11, 0xFE  // 0x214 Jump back to 0x200.
+}};
+
+static void load_key_program(chip::CPU& cpu)
+{
+    chip::load_font_set(cpu);
+
+    load_program(cpu, key_program);
+}
+
+static uint16_t key_pad_of(uint64_t frame)
+{
+    return (frame / 7) % 3 == 0 ? 0x1 << (frame % 16) : 0x0;
+}
+
+static void record_frames(chip::Movie& movie, chip::CPU& cpu, uint64_t first, uint64_t last)
+{
+    for(uint64_t frame = first ; frame < last ; frame++)
+    {
+        cpu.key_pad = key_pad_of(frame);
+        chip::record_input(movie, cpu);
+        chip::run_cycles(cpu, 14);
+    }
+
+    chip::record_input(movie, cpu);
+}
+
+static chip::Movie write_and_read(const chip::Movie& movie)
+{
+    std::stringstream file;
+    chip::write_movie(file, movie);
+
+    return chip::read_movie(file);
+}
+
+TEST(MovieTest, CanReplayRecordedSession)
+{
+    chip::CPU cpu{};
+    load_key_program(cpu);
+
+    chip::Movie movie = chip::start_movie(cpu, 1234, 14 * chip::TIMER_RATE);
+    record_frames(movie, cpu, 0, 600);
+
+    const chip::Movie read = write_and_read(movie);
+
+    ASSERT_EQ(read.seed,       movie.seed);
+    ASSERT_EQ(read.clock_rate, movie.clock_rate);
+    ASSERT_EQ(read.rom_hash,   movie.rom_hash);
+    ASSERT_EQ(read.length,     cpu.cycles);
+    ASSERT_EQ(read.events.size(), movie.events.size());
+
+    // The replay doesn't depend on how the instructions are split.
+    for(uint64_t chunk : { uint64_t{1}, uint64_t{14}, uint64_t{37}, read.length })
+    {
+        chip::CPU result{};
+        load_key_program(result);
+        chip::start_replay(result, read);
+
+        size_t next = 0;
+
+        while(result.cycles < read.length) chip::play_movie(result, read, next, std::min(chunk, read.length - result.cycles));
+
+        expect_same_state(cpu, result);
+        ASSERT_EQ(next, read.events.size());
+    }
+}
+
+TEST(MovieTest, CanTruncateRewoundSession)
+{
+    chip::CPU cpu{};
+    load_key_program(cpu);
+
+    chip::Movie movie = chip::start_movie(cpu, 99, 14 * chip::TIMER_RATE);
+    record_frames(movie, cpu, 0, 200);
+
+    const chip::CPU rewound = [&]()
+    {
+        chip::CPU copy{};
+        load_key_program(copy);
+        chip::start_replay(copy, movie);
+
+        size_t next = 0;
+        chip::play_movie(copy, movie, next, 100 * 14);
+
+        return copy;
+    }();
+
+    // Go back to frame 100 and play something else.
+    cpu = rewound;
+    chip::truncate_movie(movie, cpu.cycles);
+    record_frames(movie, cpu, 300, 400);
+
+    const chip::Movie read = write_and_read(movie);
+
+    chip::CPU result{};
+    load_key_program(result);
+    chip::start_replay(result, read);
+
+    size_t next = 0;
+    chip::play_movie(result, read, next, read.length);
+
+    expect_same_state(cpu, result);
+}
+
+TEST(MovieTest, CanRejectInvalidMovies)
+{
+    chip::CPU cpu{};
+    load_key_program(cpu);
+
+    chip::Movie movie = chip::start_movie(cpu, 7, 14 * chip::TIMER_RATE);
+    record_frames(movie, cpu, 0, 100);
+
+    std::stringstream file;
+    chip::write_movie(file, movie);
+
+    const std::string data = file.str();
+
+    std::istringstream truncated{data.substr(0, data.size() - 1)};
+    ASSERT_THROW(chip::read_movie(truncated), std::runtime_error);
+
+    std::istringstream magic{"CH8S" + data.substr(4)};
+    ASSERT_THROW(chip::read_movie(magic), std::runtime_error);
+
+    chip::CPU other{};
+    load_lockstep_program(other);
+    ASSERT_THROW(chip::start_replay(other, movie), std::runtime_error);
+}
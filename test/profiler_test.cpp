@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <string>
+#include <sstream>
+
+#include "../include/opcode.h"
+#include "../include/cpu.h"
+#include "../include/batch.h"
+#include "../include/profiler.h"
+#include "./lockstep.h"
+
+TEST(ProfilerTest, CanCountEveryInstruction)
+{
+    chip::CPU expected{};
+    chip::CPU result{};
+    chip::Profile profile{};
+
+    load_lockstep_program(expected);
+    load_lockstep_program(result);
+
+    for(int i = 0 ; i < 500 ; i++) chip::cycle(expected);
+
+    chip::run_profiled(result, profile, 500);
+
+    // Counting doesn't change how the program runs.
+    expect_same_state(expected, result);
+
+    uint64_t handlers  = 0;
+    uint64_t addresses = 0;
+
+    for(uint64_t count : profile.handlers)  handlers  += count;
+    for(uint64_t count : profile.addresses) addresses += count;
+
+    ASSERT_EQ(handlers,  500);
+    ASSERT_EQ(addresses, 500);
+
+    // Every instruction of the delay timer loop runs as many times as the others.
+    ASSERT_GT(profile.addresses[0x204], 0);
+    ASSERT_EQ(profile.addresses[0x204], profile.addresses[0x206]);
+    ASSERT_EQ(profile.handlers[chip::OP_0xF07], profile.addresses[0x204]);
+}
+
+TEST(ProfilerTest, CanCountInstructionsWaitingForAKey)
+{
+    chip::CPU cpu{};
+    chip::Profile profile{};
+
+    cpu.memory[chip::ROM_START]     = 0xF0;
+    cpu.memory[chip::ROM_START + 1] = 0x0A;
+
+    const chip::RunResult result = chip::run_profiled(cpu, profile, 100);
+
+    ASSERT_EQ(result.reason, chip::STOP_WAIT_KEY);
+    ASSERT_EQ(profile.handlers[chip::OP_0xF0A], 100);
+    ASSERT_EQ(profile.addresses[chip::ROM_START], 100);
+}
+
+TEST(ProfilerTest, CanReportHotAddressesWithTheirAssembly)
+{
+    chip::CPU cpu{};
+    chip::Profile profile{};
+
+    load_lockstep_program(cpu);
+    chip::run_profiled(cpu, profile, 500);
+
+    std::ostringstream report;
+    chip::write_profile(report, profile, cpu, 3);
+
+    const std::string text = report.str();
+
+    ASSERT_NE(text.find("Instructions: 500"), std::string::npos);
+    ASSERT_NE(text.find("DXYN"), std::string::npos);
+    ASSERT_NE(text.find("0x234"), std::string::npos);
+    ASSERT_NE(text.find(chip::disassemble_at(cpu, 0x234)), std::string::npos);
+}
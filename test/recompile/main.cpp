@@ -0,0 +1,33 @@
+#include <vector>
+#include <fstream>
+#include <iostream>
+
+#include "../../include/recompiler.h"
+#include "../lockstep_program.h"
+
+/**
+ *  Recompile the lockstep program so the tests can run the generated
+ *  code against cycle().
+ */
+int main(int argc, char **argv)
+{
+    if(argc != 2)
+    {
+        std::cout << "Usage: lockstep-recompile <output.cpp> \n";
+        return 1;
+    }
+
+    std::ofstream output{argv[1], std::ios::out | std::ios::trunc};
+
+    if(!output.is_open())
+    {
+        std::cout << "Unable to write " << argv[1] << "\n";
+        return 1;
+    }
+
+    const std::vector<uint8_t> rom{lockstep_program.begin(), lockstep_program.end()};
+
+    chip::recompile(rom, "lockstep", output);
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <sstream>
+
+#include "../include/opcode.h"
+#include "../include/cpu.h"
+#include "../include/recompiler.h"
+#include "./lockstep.h"
+
+namespace chip
+{
+    // Generated from lockstep_program by lockstep-recompile.
+    extern const RecompiledProgram recompiled_program;
+}
+
+TEST(RecompilerTest, CanFindReachableBlocks)
+{
+    chip::CPU cpu{};
+
+    load_lockstep_program(cpu);
+
+    const std::map<uint16_t, uint16_t> blocks = chip::find_blocks(cpu);
+
+    ASSERT_EQ(blocks.size(), 15);
+    ASSERT_EQ(blocks.at(0x200), 0x208);
+    ASSERT_EQ(blocks.at(0x20C), 0x210);
+    ASSERT_EQ(blocks.at(0x224), 0x22C);
+    ASSERT_EQ(blocks.at(0x240), 0x244);
+    ASSERT_EQ(blocks.count(0x220), 0);
+    ASSERT_EQ(blocks.count(0x238), 0);
+}
+
+TEST(RecompilerTest, CanEmitRecompiledBlocks)
+{
+    std::ostringstream output;
+    const std::vector<uint8_t> rom{lockstep_program.begin(), lockstep_program.end()};
+
+    chip::recompile(rom, "lockstep", output);
+
+    const std::string source = output.str();
+
+    ASSERT_NE(source.find("void block_0x240(chip::CPU& cpu)"), std::string::npos);
+    ASSERT_NE(source.find("chip::op_code_0x84(cpu, chip::OpCode{ 0x84, 0x1 });"), std::string::npos);
+    ASSERT_NE(source.find("{ 0x200, 0x208, 4, block_0x200 },"), std::string::npos);
+    ASSERT_NE(source.find("0x80, 0x14, 0x00, 0xee,"), std::string::npos);
+}
+
+static void block_0x200(chip::CPU& cpu)
+{
+    cpu.PC = 0x202;
+}
+
+TEST(RecompilerTest, CanRejectDifferentROM)
+{
+    chip::CPU cpu{};
+    const chip::RecompiledProgram program{ { 0x12, 0x00 }, { { 0x200, 0x202, 1, block_0x200 } } };
+
+    load_lockstep_program(cpu);
+
+    const chip::Recompiled recompiled = chip::make_recompiled(program, cpu);
+
+    ASSERT_EQ(recompiled.index[0x200], nullptr);
+}
+
+TEST(RecompilerTest, CanInterpretUnknownBlocks)
+{
+    chip::CPU expected{};
+    chip::CPU result{};
+    const chip::RecompiledProgram program{ { lockstep_program.begin(), lockstep_program.end() }, {} };
+
+    load_lockstep_program(expected);
+    load_lockstep_program(result);
+
+    chip::Recompiled recompiled = chip::make_recompiled(program, result);
+
+    for(int i = 0 ; i < 200 ; i++)
+    {
+        const uint64_t executed = chip::run_recompiled(recompiled, result, 3);
+
+        for(uint64_t j = 0 ; j < executed ; j++) chip::cycle(expected);
+
+        expect_same_state(expected, result);
+    }
+}
+
+TEST(RecompilerTest, CanRunRecompiledCodeInLockstep)
+{
+    chip::CPU expected{};
+    chip::CPU result{};
+
+    load_lockstep_program(expected);
+    load_lockstep_program(result);
+
+    chip::Recompiled recompiled = chip::make_recompiled(chip::recompiled_program, result);
+
+    ASSERT_NE(recompiled.index[0x200], nullptr);
+
+    int blocks_run = 0;
+
+    for(int i = 0 ; i < 300 ; i++)
+    {
+        const chip::RecompiledBlock* block = recompiled.index[result.PC & 0xFFF];
+
+        if(block != nullptr && block->start == result.PC) blocks_run += 1;
+
+        const uint64_t executed = chip::run_recompiled(recompiled, result, 1);
+
+        for(uint64_t j = 0 ; j < executed ; j++) chip::cycle(expected);
+
+        expect_same_state(expected, result);
+    }
+
+    // Loading the program must not drop the blocks before they run.
+    ASSERT_NE(recompiled.index[0x200], nullptr);
+    ASSERT_GT(blocks_run, 0);
+}
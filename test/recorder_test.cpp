@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstdint>
+
+#include "../include/opcode.h"
+#include "../include/cpu.h"
+#include "../include/batch.h"
+#include "../include/recorder.h"
+#include "./lockstep.h"
+
+TEST(RecorderTest, CanKeepTheLastInstructions)
+{
+    chip::CPU expected{};
+    chip::CPU result{};
+    chip::FlightRecorder recorder{};
+
+    load_lockstep_program(expected);
+    load_lockstep_program(result);
+
+    std::vector<uint16_t> addresses;
+
+    for(int i = 0 ; i < 500 ; i++)
+    {
+        addresses.push_back(expected.PC);
+        chip::cycle(expected);
+    }
+
+    const chip::RunResult run = chip::run_recorded(result, recorder, 500);
+
+    // Recording doesn't change how the program runs.
+    expect_same_state(expected, result);
+
+    ASSERT_EQ(run.reason, chip::STOP_BUDGET);
+    ASSERT_EQ(recorder.count, 500);
+    ASSERT_EQ(recorder.fault, chip::FAULT_NONE);
+
+    // The ring wrapped around and holds the newest instructions only.
+    for(uint64_t i = 500 - chip::FLIGHT_RECORDER_SIZE ; i < 500 ; i++)
+    {
+        const chip::TraceEntry& entry = recorder.entries[i % chip::FLIGHT_RECORDER_SIZE];
+
+        ASSERT_EQ(entry.PC, addresses[i]);
+        ASSERT_EQ(entry.op_code, (result.memory[entry.PC] << 8) | result.memory[entry.PC + 1]);
+    }
+}
+
+TEST(RecorderTest, CanRecordTheRegisterWritten)
+{
+    chip::CPU cpu{};
+    chip::FlightRecorder recorder{};
+
+    load_program(cpu, { 0x60, 0x05, 0x70, 0x03, 0x30, 0x09, 0xA1, 0x23, 0x6F, 0x01, 0x80, 0x14 });
+
+    chip::run_recorded(cpu, recorder, 6);
+
+    ASSERT_EQ(recorder.count, 6);
+    ASSERT_EQ(recorder.entries[3].PC,      0x206);
+    ASSERT_EQ(recorder.entries[3].op_code, 0xA123);
+
+    const std::array<chip::RecordedWrite, chip::FLIGHT_RECORDER_SIZE> writes = chip::resolve_writes(recorder, cpu);
+
+    // V0 = 5 was overwritten by V0 += 3, which was overwritten by V0 += V1.
+    ASSERT_EQ(writes[0].reg, 0x0);
+    ASSERT_FALSE(writes[0].known);
+    ASSERT_EQ(writes[1].reg, 0x0);
+    ASSERT_FALSE(writes[1].known);
+    ASSERT_EQ(writes[2].reg, chip::REGISTER_NONE);
+    ASSERT_EQ(writes[3].reg, chip::REGISTER_I);
+    ASSERT_TRUE(writes[3].known);
+    ASSERT_EQ(writes[3].value, 0x123);
+
+    // VF = 1 was overwritten by the flag of V0 += V1.
+    ASSERT_EQ(writes[4].reg, 0xF);
+    ASSERT_FALSE(writes[4].known);
+    ASSERT_EQ(writes[5].reg, 0x0);
+    ASSERT_TRUE(writes[5].known);
+    ASSERT_EQ(writes[5].value, 0x08);
+
+    std::ostringstream dump;
+    chip::write_flight_recorder(dump, recorder, cpu);
+
+    const std::string text = dump.str();
+
+    ASSERT_NE(text.find("Last 6 of 6 instructions"), std::string::npos);
+    ASSERT_NE(text.find("V0 = 0x08"), std::string::npos);
+    ASSERT_NE(text.find("V0 = 0x??"), std::string::npos);
+    ASSERT_NE(text.find("I = 0x123"), std::string::npos);
+}
+
+TEST(RecorderTest, CanStopBeforeAFault)
+{
+    struct FaultCase
+    {
+        std::vector<uint8_t> program;
+        uint64_t             executed;
+        chip::Fault          fault;
+    };
+
+    const std::array<FaultCase, 4> cases
+    {{
+        { { 0x22, 0x00 }, 16, chip::FAULT_STACK_OVERFLOW },    // Calls itself.
+        { { 0x00, 0xEE },  0, chip::FAULT_STACK_UNDERFLOW },   // Returns without a call.
+        { { 0x1F, 0xFD },  1, chip::FAULT_PC_OUTSIDE_MEMORY }, // Jumps to 0xFFF.
+        { { 0x60, 0x01, 0xFF, 0xFF }, 1, chip::FAULT_UNKNOWN_OPCODE }
+    }};
+
+    for(const FaultCase& fault_case : cases)
+    {
+        chip::CPU cpu{};
+        chip::FlightRecorder recorder{nullptr, true};
+
+        load_program(cpu, fault_case.program);
+
+        const chip::RunResult run = chip::run_recorded(cpu, recorder, 100);
+
+        ASSERT_EQ(run.reason,     chip::STOP_FAULT);
+        ASSERT_EQ(run.cycles,     fault_case.executed);
+        ASSERT_EQ(cpu.cycles,     fault_case.executed);
+        ASSERT_EQ(recorder.count, fault_case.executed);
+        ASSERT_EQ(recorder.fault, fault_case.fault);
+
+        std::ostringstream dump;
+        chip::write_flight_recorder(dump, recorder, cpu);
+
+        ASSERT_NE(dump.str().find(chip::fault_names[fault_case.fault]), std::string::npos);
+    }
+}
+
+TEST(RecorderTest, CanRunPastHarmlessFaults)
+{
+    chip::CPU cpu{};
+    std::ostringstream dump;
+    chip::FlightRecorder recorder{&dump};
+
+    // An unknown instruction on a loop is written once and does nothing.
+    load_program(cpu, { 0x60, 0x01, 0xFF, 0xFF, 0x12, 0x02 });
+
+    const chip::RunResult run = chip::run_recorded(cpu, recorder, 100);
+
+    ASSERT_EQ(run.reason,     chip::STOP_BUDGET);
+    ASSERT_EQ(recorder.count, 100);
+    ASSERT_EQ(recorder.fault, chip::FAULT_NONE);
+
+    const std::string text = dump.str();
+    const size_t      first = text.find(chip::fault_names[chip::FAULT_UNKNOWN_OPCODE]);
+
+    ASSERT_NE(first, std::string::npos);
+    ASSERT_EQ(text.find(chip::fault_names[chip::FAULT_UNKNOWN_OPCODE], first + 1), std::string::npos);
+
+    // A return without a call would read outside of the stack so, it always stops.
+    chip::CPU underflow{};
+    chip::FlightRecorder stopped{&dump};
+
+    load_program(underflow, { 0x00, 0xEE });
+
+    ASSERT_EQ(chip::run_recorded(underflow, stopped, 100).reason, chip::STOP_FAULT);
+    ASSERT_EQ(stopped.fault, chip::FAULT_STACK_UNDERFLOW);
+}
@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "../include/opcode.h"
+#include "../include/cpu.h"
+#include "../include/batch.h"
+#include "../include/rewind.h"
+#include "./lockstep.h"
+
+TEST(RewindTest, CanRewindEveryFrame)
+{
+    chip::CPU cpu{};
+    chip::RewindBuffer buffer{chip::REWIND_BUDGET, 16};
+    std::vector<chip::CPU> history;
+
+    load_lockstep_program(cpu);
+    chip::set_clock_rate(cpu, 14 * chip::TIMER_RATE);
+
+    for(int i = 0 ; i < 100 ; i++)
+    {
+        chip::run_cycles(cpu, 14);
+        chip::push_frame(buffer, cpu);
+        history.push_back(cpu);
+    }
+
+    ASSERT_EQ(buffer.frames.size(), 100);
+
+    chip::CPU result{};
+
+    for(int i = 99 ; i >= 50 ; i--)
+    {
+        ASSERT_TRUE(chip::rewind_frame(buffer, result));
+        expect_same_state(history[i], result);
+    }
+
+    // Frames stored after rewinding are relative to the right keyframe.
+    history.resize(50);
+
+    for(int i = 0 ; i < 30 ; i++)
+    {
+        chip::run_cycles(result, 14);
+        chip::push_frame(buffer, result);
+        history.push_back(result);
+    }
+
+    for(int i = history.size() - 1 ; i >= 0 ; i--)
+    {
+        ASSERT_TRUE(chip::rewind_frame(buffer, result));
+        expect_same_state(history[i], result);
+    }
+
+    ASSERT_FALSE(chip::rewind_frame(buffer, result));
+    ASSERT_EQ(buffer.used, 0);
+}
+
+TEST(RewindTest, CanKeepHistoryUnderBudget)
+{
+    chip::CPU cpu{};
+    chip::RewindBuffer buffer{64 * 1024, 30};
+
+    load_lockstep_program(cpu);
+    chip::set_clock_rate(cpu, 14 * chip::TIMER_RATE);
+
+    for(int i = 0 ; i < 2000 ; i++)
+    {
+        chip::run_cycles(cpu, 14);
+        chip::push_frame(buffer, cpu);
+
+        ASSERT_LE(buffer.used, 64 * 1024);
+    }
+
+    ASSERT_GT(buffer.frames.size(), 30);
+    ASSERT_LT(buffer.frames.size(), 2000);
+    ASSERT_TRUE(buffer.frames.front().keyframe);
+
+    // The newest frame is the last one pushed.
+    chip::CPU result{};
+    ASSERT_TRUE(chip::rewind_frame(buffer, result));
+    expect_same_state(cpu, result);
+}
+
+TEST(RewindTest, CanHoldAMinuteOfHistory)
+{
+    chip::CPU cpu{};
+    chip::RewindBuffer buffer{};
+
+    load_lockstep_program(cpu);
+    chip::set_clock_rate(cpu, 14 * chip::TIMER_RATE);
+
+    for(int i = 0 ; i < 60 * 60 ; i++)
+    {
+        chip::run_cycles(cpu, 14);
+        chip::push_frame(buffer, cpu);
+    }
+
+    ASSERT_EQ(buffer.frames.size(), 60 * 60);
+    ASSERT_LE(buffer.used, chip::REWIND_BUDGET);
+}
+
+TEST(RewindTest, CanTrackWrittenPages)
+{
+    chip::CPU cpu{};
+    cpu.written_pages = 0x0;
+
+    chip::invalidate(cpu, 0x300, 3);
+    ASSERT_EQ(cpu.written_pages, 0x1ULL << 12);
+
+    chip::invalidate(cpu, 0x33E, 4);
+    ASSERT_EQ(cpu.written_pages, 0x3ULL << 12);
+
+    cpu.written_pages = 0x0;
+
+    // Writes past the end of memory wrap around to the first page.
+    chip::invalidate(cpu, 0xFFF, 2);
+    ASSERT_EQ(cpu.written_pages, (0x1ULL << 63) | 0x1ULL);
+
+    chip::invalidate(cpu, 0x0, 4096);
+    ASSERT_EQ(cpu.written_pages, ~0x0ULL);
+}
+
+TEST(RewindTest, CanEncodeOnlyWrittenPages)
+{
+    chip::CPU cpu{};
+    chip::StatePayload keyframe{};
+    chip::StatePayload payload{};
+
+    load_lockstep_program(cpu);
+    chip::save_payload(cpu, keyframe);
+
+    cpu.V[3]          = 0x7;
+    cpu.memory[0x000] = 0x1;
+    cpu.memory[0x03F] = 0x2;
+    cpu.memory[0x040] = 0x3;
+    cpu.memory[0x300] = 0x4;
+    cpu.memory[0xFFF] = 0x5;
+    chip::save_payload(cpu, payload);
+
+    std::vector<uint64_t> expected;
+    std::vector<uint64_t> result;
+
+    chip::encode_runs(keyframe, payload, expected);
+    chip::encode_pages(keyframe, payload, 0x3ULL | (0x1ULL << 12) | (0x1ULL << 63), result);
+
+    ASSERT_EQ(expected, result);
+}
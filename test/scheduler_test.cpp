@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../include/scheduler.h"
+
+TEST(SchedulerTest, CanRunEveryJobOnce)
+{
+    std::array<std::atomic<uint32_t>, 100> runs{};
+
+    const std::vector<chip::WorkerStats> stats = chip::run_parallel(runs.size(), 3, false, [&](uint32_t job, uint32_t)
+    {
+        runs[job].fetch_add(1);
+    });
+
+    uint64_t jobs = 0;
+    for(const chip::WorkerStats& stat : stats) jobs += stat.jobs;
+
+    ASSERT_EQ(stats.size(), 3);
+    ASSERT_EQ(jobs, runs.size());
+
+    for(const std::atomic<uint32_t>& run : runs) ASSERT_EQ(run.load(), 1);
+}
+
+TEST(SchedulerTest, CanStealJobsFromSlowWorkers)
+{
+    std::array<std::atomic<uint32_t>, 40> runs{};
+
+    // The first slice is slow so, the other workers have to take part of it.
+    const std::vector<chip::WorkerStats> stats = chip::run_parallel(runs.size(), 4, false, [&](uint32_t job, uint32_t)
+    {
+        if(job < 10) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+
+        runs[job].fetch_add(1);
+    });
+
+    uint64_t stolen = 0;
+    for(const chip::WorkerStats& stat : stats) stolen += stat.stolen;
+
+    ASSERT_GT(stolen, 0);
+    ASSERT_LT(stats[0].jobs, 10);
+
+    for(const std::atomic<uint32_t>& run : runs) ASSERT_EQ(run.load(), 1);
+}
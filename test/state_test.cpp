@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+#include "../include/opcode.h"
+#include "../include/cpu.h"
+#include "../include/state.h"
+#include "./lockstep.h"
+
+TEST(StateTest, CanSaveAndLoadState)
+{
+    chip::CPU expected{};
+    load_lockstep_program(expected);
+    chip::set_clock_rate(expected, 120);
+    chip::seed_random(expected, 7);
+
+    for(int i = 0 ; i < 150 ; i++) chip::cycle(expected);
+
+    expected.key_pad = 0x1234;
+
+    const std::vector<uint8_t> state = chip::save_state(expected);
+
+    ASSERT_EQ(state.size(), chip::STATE_SIZE);
+
+    chip::CPU result{};
+    chip::load_state(result, state);
+
+    expect_same_state(expected, result);
+    ASSERT_EQ(result.key_pad, 0x1234);
+
+    // The restored cpu keeps running exactly like the original one.
+    for(int i = 0 ; i < 150 ; i++)
+    {
+        chip::cycle(expected);
+        chip::cycle(result);
+
+        expect_same_state(expected, result);
+    }
+}
+
+TEST(StateTest, CanRejectInvalidStates)
+{
+    chip::CPU cpu{};
+    chip::CPU result{};
+
+    std::vector<uint8_t> state = chip::save_state(cpu);
+
+    ASSERT_THROW(chip::load_state(result, state.data(), state.size() - 1), std::runtime_error);
+
+    state[100] ^= 0x1;
+    ASSERT_THROW(chip::load_state(result, state), std::runtime_error);
+    state[100] ^= 0x1;
+
+    state[4] += 1;
+    ASSERT_THROW(chip::load_state(result, state), std::runtime_error);
+    state[4] -= 1;
+
+    state[0] = 'X';
+    ASSERT_THROW(chip::load_state(result, state), std::runtime_error);
+}
+
+TEST(StateTest, CanMapStateFiles)
+{
+    const std::string path = "state_test.ch8s";
+
+    chip::CPU cpu{};
+    load_lockstep_program(cpu);
+
+    std::vector<chip::CPU> saved;
+
+    {
+        std::ofstream output{path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc};
+
+        for(int i = 0 ; i < 3 ; i++)
+        {
+            for(int j = 0 ; j < 50 ; j++) chip::cycle(cpu);
+
+            chip::write_state(output, cpu);
+            saved.push_back(cpu);
+        }
+    }
+
+    {
+        chip::StateFile file{path};
+
+        ASSERT_EQ(file.count, 3);
+
+        for(size_t i = 0 ; i < file.count ; i++)
+        {
+            chip::CPU result{};
+            chip::load_state(result, file, i);
+
+            expect_same_state(saved[i], result);
+        }
+
+        chip::CPU result{};
+        ASSERT_THROW(chip::load_state(result, file, 3), std::runtime_error);
+    }
+
+    std::remove(path.c_str());
+
+    ASSERT_THROW(chip::StateFile{path}, std::runtime_error);
+}
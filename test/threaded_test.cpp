@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+#include <array>
+
+#include "../include/opcode.h"
+#include "../include/cpu.h"
+#include "../include/threaded.h"
+#include "./lockstep.h"
+
+static void run_lockstep(chip::Backend backend, uint64_t cycles)
+{
+    chip::CPU expected{};
+    chip::CPU result{};
+
+    load_lockstep_program(expected);
+    load_lockstep_program(result);
+
+    for(int i = 0 ; i < 100 ; i++)
+    {
+        chip::run(result, cycles, backend);
+
+        for(uint64_t j = 0 ; j < cycles ; j++) chip::cycle(expected);
+
+        expect_same_state(expected, result);
+    }
+}
+
+TEST(ThreadedTest, CanRunThreadedCodeInLockstep)
+{
+    run_lockstep(chip::THREADED_BACKEND, 1);
+    run_lockstep(chip::THREADED_BACKEND, 7);
+    run_lockstep(chip::THREADED_BACKEND, 64);
+}
+
+TEST(ThreadedTest, CanRunCycleBackend)
+{
+    run_lockstep(chip::CYCLE_BACKEND, 7);
+}
+
+TEST(ThreadedTest, CanRunZeroCycles)
+{
+    chip::CPU cpu{};
+
+    chip::run_threaded(cpu, 0);
+
+    ASSERT_EQ(cpu.PC, chip::ROM_START);
+}
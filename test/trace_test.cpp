@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <utility>
+#include <fstream>
+#include <stdexcept>
+
+#include "../include/opcode.h"
+#include "../include/cpu.h"
+#include "../include/batch.h"
+#include "../include/trace.h"
+#include "./lockstep.h"
+
+TEST(TraceTest, CanReadTheInstructionsWritten)
+{
+    const std::string path = "trace_test.trace";
+
+    chip::CPU expected{};
+    chip::CPU result{};
+
+    load_lockstep_program(expected);
+    load_lockstep_program(result);
+
+    std::vector<std::pair<uint16_t, uint16_t>> executed;
+
+    for(int i = 0 ; i < 5000 ; i++)
+    {
+        executed.emplace_back(expected.PC, chip::fetch(expected));
+        chip::cycle(expected);
+    }
+
+    {
+        // Small blocks so, the trace is split in many of them.
+        chip::TraceWriter writer{path, 64};
+
+        chip::run_traced(result, writer, 5000);
+        chip::finish_trace(writer);
+
+        ASSERT_EQ(writer.instructions, 5000);
+
+        // Straight code and short loops take about a byte per instruction.
+        ASSERT_LT(writer.bytes, 5000 * 3 / 2);
+    }
+
+    // Tracing doesn't change how the program runs.
+    expect_same_state(expected, result);
+
+    std::vector<std::pair<uint16_t, uint16_t>> read;
+
+    {
+        chip::TraceFile file{path};
+
+        const uint64_t count = chip::read_trace(file.data, file.size, [&read](uint16_t PC, uint16_t op_code) { read.emplace_back(PC, op_code); });
+
+        ASSERT_EQ(count, 5000);
+    }
+
+    std::remove(path.c_str());
+
+    // The instruction overwritten at 0x218 is read with both of its values.
+    ASSERT_EQ(read, executed);
+}
+
+TEST(TraceTest, CanFindBlocksAndLoops)
+{
+    const std::string path = "trace_test_loop.trace";
+
+    chip::CPU cpu{};
+
+    const std::array<uint8_t, 8> program
+    {{
+        0x70, 0x01, // 0x200 V0 += 1.
+        0x30, 0x0A, // 0x202 Skip next instruction if V0 == 10.
+        0x11, 0xFE, // 0x204 Jump to 0x200.
+        0x12, 0x04  // 0x206 Jump to 0x206.
+    }};
+
+    load_program(cpu, program);
+
+    {
+        chip::TraceWriter writer{path};
+
+        chip::run_traced(cpu, writer, 35);
+        chip::finish_trace(writer);
+    }
+
+    chip::TraceAnalysis analysis{};
+
+    {
+        chip::TraceFile file{path};
+        analysis = chip::analyze_trace(file.data, file.size);
+    }
+
+    std::remove(path.c_str());
+
+    ASSERT_EQ(analysis.instructions, 35);
+    ASSERT_EQ(analysis.handlers[chip::OP_0x7], 10);
+    ASSERT_EQ(analysis.handlers[chip::OP_0x3], 10);
+    ASSERT_EQ(analysis.handlers[chip::OP_0x1], 15);
+
+    // The counting loop runs 9 times through its jump and once through the skip.
+    ASSERT_EQ(analysis.blocks[(0x200 << 16) | 0x204], 9);
+    ASSERT_EQ(analysis.blocks[(0x200 << 16) | 0x202], 1);
+    ASSERT_EQ(analysis.blocks[(0x206 << 16) | 0x206], 6);
+    ASSERT_EQ(analysis.loops[(0x200 << 16) | 0x204], 9);
+    ASSERT_EQ(analysis.loops[(0x206 << 16) | 0x206], 5);
+}
+
+TEST(TraceTest, CanRejectCorruptedTraces)
+{
+    const std::string path = "trace_test_corrupted.trace";
+
+    chip::CPU cpu{};
+    load_lockstep_program(cpu);
+
+    {
+        chip::TraceWriter writer{path};
+
+        chip::run_traced(cpu, writer, 100);
+        chip::finish_trace(writer);
+    }
+
+    std::vector<uint8_t> data;
+
+    {
+        chip::TraceFile file{path};
+        data.assign(file.data, file.data + file.size);
+    }
+
+    std::remove(path.c_str());
+
+    const auto ignore = [](uint16_t, uint16_t) {};
+
+    ASSERT_EQ(chip::read_trace(data.data(), data.size(), ignore), 100);
+
+    std::vector<uint8_t> truncated{data.begin(), data.end() - 1};
+    ASSERT_THROW(chip::read_trace(truncated.data(), truncated.size(), ignore), std::runtime_error);
+
+    std::vector<uint8_t> magic = data;
+    magic[0] ^= 0xFF;
+    ASSERT_THROW(chip::read_trace(magic.data(), magic.size(), ignore), std::runtime_error);
+
+    // One more instruction than the records of the block.
+    std::vector<uint8_t> count = data;
+    count[chip::TRACE_HEADER_SIZE + 4] += 1;
+    ASSERT_THROW(chip::read_trace(count.data(), count.size(), ignore), std::runtime_error);
+}
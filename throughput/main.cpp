@@ -0,0 +1,648 @@
+#include <map>
+#include <cctype>
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+#include "../include/cpu.h"
+#include "../include/batch.h"
+#include "../include/block.h"
+#include "../include/threaded.h"
+#include "../include/jit.h"
+#include "../include/movie.h"
+#include "../include/headless.h"
+
+/**
+ *  Every measurement runs on its own process on unix systems so, the
+ *  peak resident memory belongs to a single ROM and backend.
+ */
+#if defined(__unix__) || defined(__APPLE__)
+#define THROUGHPUT_FORK 1
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#endif
+
+/**
+ *  A ROM to run for a number of frames with the input of a movie, or
+ *  with a fixed input pattern when there is no movie.
+ */
+struct Workload
+{
+    std::string name;
+    std::string rom;   // A ROM file or builtin:<name>.
+    std::string movie; // "-" when there is no movie.
+    uint64_t    frames;
+};
+
+enum Backend : uint8_t
+{
+    BACKEND_CYCLE,
+    BACKEND_BATCH,
+    BACKEND_BLOCK,
+    BACKEND_THREADED,
+    BACKEND_JIT,
+    BACKEND_COUNT
+};
+
+static const std::array<const char*, BACKEND_COUNT> backend_names{{ "cycle", "batch", "block", "threaded", "jit" }};
+
+struct Measurement
+{
+    uint64_t cycles;  // Instructions executed.
+    uint64_t frames;
+    double   seconds;
+    uint64_t rss_kb;  // Peak resident memory of the process.
+    uint64_t hash;    // state_hash() once the workload ends.
+};
+
+/**
+ *  A line of the report and of the baseline.
+ */
+struct Result
+{
+    std::string rom;
+    std::string backend;
+    double      instructions_per_second;
+    double      frames_per_second;
+    double      peak_rss_kb;
+};
+
+/**
+ *  Programs that behave like the main loops of most ROMs, so the
+ *  suite runs without any ROM file.
+ */
+static const std::map<std::string, std::vector<uint8_t>> builtin_roms
+{
+    // Waits for the delay timer and draws a digit every other tick.
+    { "frame_loop", {
+        0x60, 0x02, // 0x200 V0 = 2.
+        0xF0, 0x15, // 0x202 DT = V0.
+        0xF1, 0x07, // 0x204 V1 = DT.
+        0x31, 0x00, // 0x206 Skip next instruction if V1 == 0.
+        0x12, 0x02, // 0x208 Jump to 0x204.
+        0xA0, 0x00, // 0x20A I = sprite of digit 0.
+        0xD3, 0x45, // 0x20C Draw it at (V3, V4).
+        0x73, 0x05, // 0x20E V3 += 5.
+        0x11, 0xFE  // 0x210 Jump to 0x200.
+    } },
+    // Clears the screen and covers it with 15 row sprites.
+    { "sprites", {
+        0x00, 0xE0, // 0x200 Clear the screen.
+        0x63, 0x00, // 0x202 V3 = 0.
+        0x64, 0x00, // 0x204 V4 = 0.
+        0xA0, 0x00, // 0x206 I = 0.
+        0xD3, 0x4F, // 0x208 Draw 15 rows at (V3, V4).
+        0x73, 0x08, // 0x20A V3 += 8.
+        0x33, 0x40, // 0x20C Skip next instruction if V3 == 64.
+        0x12, 0x06, // 0x20E Jump to 0x208.
+        0x63, 0x00, // 0x210 V3 = 0.
+        0x74, 0x10, // 0x212 V4 += 16.
+        0x34, 0x20, // 0x214 Skip next instruction if V4 == 32.
+        0x12, 0x06, // 0x216 Jump to 0x208.
+        0x11, 0xFE  // 0x218 Jump to 0x200.
+    } },
+    // Arithmetic with a subroutine that stores and loads registers.
+    { "arithmetic", {
+        0x70, 0x01, // 0x200 V0 += 1.
+        0x81, 0x04, // 0x202 V1 += V0.
+        0x82, 0x13, // 0x204 V2 ^= V1.
+        0x83, 0x25, // 0x206 V3 -= V2.
+        0x84, 0x36, // 0x208 V4 = V3 >> 1.
+        0x22, 0x14, // 0x20A Call 0x214.
+        0x85, 0x4E, // 0x20C V5 = V4 << 1.
+        0x86, 0x51, // 0x20E V6 |= V5.
+        0x11, 0xFE, // 0x210 Jump to 0x200.
+        0x00, 0x00, // 0x212
+        0xA3, 0x00, // 0x214 I = 0x300.
+        0xF2, 0x33, // 0x216 Store BCD of V2 at I.
+        0xF6, 0x55, // 0x218 Store V0 to V6 at I.
+        0xF6, 0x65, // 0x21A Load V0 to V6 from I.
+        0x00, 0xEE  // 0x21C Return from subroutine.
+    } },
+    // Reacts to the key pad and the random generator.
+    { "keys", {
+        0xC0, 0x0F, // 0x200 V0 = random & 0xF.
+        0xE0, 0x9E, // 0x202 Skip next instruction if key V0 is pressed.
+        0x12, 0x08, // 0x204 Jump to 0x20A.
+        0x71, 0x01, // 0x206 V1 += 1.
+        0xF2, 0x0A, // 0x208 Wait for a key and store it on V2.
+        0xF0, 0x15, // 0x20A DT = V0.
+        0xA3, 0x00, // 0x20C I = 0x300.
+        0xF1, 0x33, // 0x20E Store BCD of V1 at I.
+        0xD3, 0x43, // 0x210 Draw the digits at (V3, V4).
+        0x73, 0x03, // 0x212 V3 += 3.
+        0x11, 0xFE  // 0x214 Jump to 0x200.
+    } }
+};
+
+static void print_usage()
+{
+    std::cout << "Usage: chip8-throughput <suite> [options] \n"
+              << "  --baseline FILE   compare with the results stored on FILE, they are stored there when it doesn't exist \n"
+              << "  --update          store the results on the baseline instead \n"
+              << "  --threshold PCT   slowdown or memory growth flagged as a regression (default 10) \n"
+              << "  --repeat N        runs of each workload, the fastest one counts (default 3) \n"
+              << "  --backend NAME    only run one backend: cycle, batch, block, threaded or jit \n"
+              << "\n"
+              << "Each line of the suite holds <name> <ROM or builtin:NAME> <movie or -> <frames>. \n";
+}
+
+static std::vector<Workload> parse_suite(std::istream& input)
+{
+    std::vector<Workload> workloads;
+    std::string line;
+    uint32_t number = 0;
+
+    while(std::getline(input, line))
+    {
+        number++;
+
+        line = line.substr(0, line.find('#'));
+        if(line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+        std::istringstream fields{line};
+        Workload workload{};
+
+        if(!(fields >> workload.name >> workload.rom >> workload.movie >> workload.frames))
+        {
+            throw std::runtime_error{"Invalid workload on line " + std::to_string(number)};
+        }
+
+        workloads.push_back(workload);
+    }
+
+    return workloads;
+}
+
+/**
+ *  The input used when a workload has no movie: a key held for 10
+ *  frames out of every 20, a different key each time.
+ */
+static chip::Movie make_movie(chip::CPU& cpu, uint64_t frames, uint64_t cycles_per_frame)
+{
+    chip::Movie movie = chip::start_movie(cpu, 0, cycles_per_frame * chip::TIMER_RATE);
+
+    for(uint64_t frame = 0 ; frame < frames ; frame++)
+    {
+        const uint16_t key_pad = (frame / 10) % 2 == 1 ? 0x1 << ((frame / 20) % 16) : 0x0;
+
+        if(key_pad != movie.events.back().key_pad) movie.events.push_back(chip::MovieEvent{ frame * cycles_per_frame, key_pad });
+    }
+
+    movie.length = frames * cycles_per_frame;
+
+    return movie;
+}
+
+static chip::Movie load_workload(chip::CPU& cpu, const Workload& workload)
+{
+    const std::string BUILTIN = "builtin:";
+
+    chip::load_font_set(cpu);
+
+    if(workload.rom.compare(0, BUILTIN.size(), BUILTIN) == 0)
+    {
+        const auto rom = builtin_roms.find(workload.rom.substr(BUILTIN.size()));
+        if(rom == builtin_roms.end()) throw std::runtime_error{"There is no " + workload.rom};
+
+        std::copy(rom->second.begin(), rom->second.end(), cpu.memory.begin() + chip::ROM_START);
+        chip::invalidate(cpu, chip::ROM_START, rom->second.size());
+    }
+    else
+    {
+        chip::load_ROM(cpu, workload.rom);
+    }
+
+    if(workload.movie == "-") return make_movie(cpu, workload.frames, 14);
+
+    std::ifstream file{workload.movie, std::ios::in | std::ios::binary};
+    if(!file.is_open()) throw std::runtime_error{"Unable to open movie " + workload.movie};
+
+    const chip::Movie movie = chip::read_movie(file);
+    chip::start_replay(cpu, movie);
+
+    return movie;
+}
+
+/**
+ *  Run a workload frame by frame, setting the key pad from the movie
+ *  at the start of every frame.
+ */
+static Measurement run_workload(const Workload& workload, Backend backend)
+{
+    chip::CPU cpu{};
+
+    const chip::Movie movie            = load_workload(cpu, workload);
+    const uint64_t    cycles_per_frame = cpu.cycles_per_tick;
+
+    std::unique_ptr<chip::BlockCache> cache{backend == BACKEND_BLOCK ? new chip::BlockCache{} : nullptr};
+    std::unique_ptr<chip::Jit>        jit{backend == BACKEND_JIT ? new chip::Jit{} : nullptr};
+
+    uint64_t executed = 0;
+    size_t   next     = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for(uint64_t frame = 0 ; frame < workload.frames ; frame++)
+    {
+        for(; next < movie.events.size() && movie.events[next].cycle <= cpu.cycles ; next++) cpu.key_pad = movie.events[next].key_pad;
+
+        switch(backend)
+        {
+            case BACKEND_CYCLE:
+                for(uint64_t i = 0 ; i < cycles_per_frame ; i++) chip::cycle(cpu);
+                executed += cycles_per_frame;
+                break;
+            case BACKEND_BATCH:
+                chip::run_cycles(cpu, cycles_per_frame);
+                executed += cycles_per_frame;
+                break;
+            case BACKEND_BLOCK:
+                executed += chip::run_blocks(*cache, cpu, cycles_per_frame);
+                break;
+            case BACKEND_THREADED:
+                chip::run_threaded(cpu, cycles_per_frame);
+                executed += cycles_per_frame;
+                break;
+            default:
+                executed += chip::run_jit(*jit, cpu, cycles_per_frame);
+                break;
+        }
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return Measurement{ executed, workload.frames, seconds, 0, chip::state_hash(cpu) };
+}
+
+/**
+ *  Run a workload on a child process and collect its peak resident
+ *  memory, elsewhere the memory is not measured.
+ */
+static Measurement measure(const Workload& workload, Backend backend)
+{
+#ifdef THROUGHPUT_FORK
+    int channel[2];
+    if(pipe(channel) != 0) throw std::runtime_error{"Unable to create a pipe"};
+
+    std::cout.flush();
+
+    const pid_t child = fork();
+
+    if(child < 0) throw std::runtime_error{"Unable to start a process"};
+
+    if(child == 0)
+    {
+        close(channel[0]);
+
+        try
+        {
+            Measurement measurement = run_workload(workload, backend);
+
+            struct rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+
+#ifdef __APPLE__
+            measurement.rss_kb = usage.ru_maxrss / 1024;
+#else
+            measurement.rss_kb = usage.ru_maxrss;
+#endif
+            if(write(channel[1], &measurement, sizeof(measurement)) != sizeof(measurement)) _exit(1);
+        }
+        catch(const std::exception& error)
+        {
+            std::cerr << error.what() << "\n";
+        }
+
+        _exit(0);
+    }
+
+    close(channel[1]);
+
+    Measurement measurement{};
+    const ssize_t received = read(channel[0], &measurement, sizeof(measurement));
+
+    close(channel[0]);
+    waitpid(child, nullptr, 0);
+
+    if(received != sizeof(measurement))
+    {
+        throw std::runtime_error{"Unable to run " + workload.name + " on the " + backend_names[backend] + " backend"};
+    }
+
+    return measurement;
+#else
+    return run_workload(workload, backend);
+#endif
+}
+
+static void write_results(std::ostream& output, const std::vector<Result>& results)
+{
+    output << "[\n";
+
+    for(size_t i = 0 ; i < results.size() ; i++)
+    {
+        const Result& result = results[i];
+
+        output << "  { \"rom\": \"" << result.rom << "\", \"backend\": \"" << result.backend << "\", "
+               << std::fixed << std::setprecision(0)
+               << "\"instructions_per_second\": " << result.instructions_per_second << ", "
+               << "\"frames_per_second\": "       << result.frames_per_second       << ", "
+               << "\"peak_rss_kb\": "             << result.peak_rss_kb             << " }"
+               << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+
+    output << "]\n";
+}
+
+/**
+ *  Read the results written by write_results(): an array of flat
+ *  objects whose values are strings without escapes or numbers.
+ */
+static std::vector<Result> parse_results(std::istream& input)
+{
+    const std::string text{std::istreambuf_iterator<char>{input}, std::istreambuf_iterator<char>{}};
+
+    std::vector<Result> results;
+    size_t position = 0;
+
+    const auto skip = [&]()
+    {
+        while(position < text.size() && std::isspace(static_cast<unsigned char>(text[position]))) position++;
+    };
+
+    const auto expect = [&](char c)
+    {
+        skip();
+        if(position >= text.size() || text[position] != c) throw std::runtime_error{"Invalid baseline, expected " + std::string{c}};
+        position++;
+    };
+
+    const auto string = [&]()
+    {
+        expect('"');
+
+        const size_t end = text.find('"', position);
+        if(end == std::string::npos) throw std::runtime_error{"Invalid baseline, unterminated string"};
+
+        const std::string value = text.substr(position, end - position);
+        position = end + 1;
+
+        return value;
+    };
+
+    expect('[');
+    skip();
+
+    if(position < text.size() && text[position] == ']') return results;
+
+    for(;;)
+    {
+        Result result{};
+
+        expect('{');
+
+        for(;;)
+        {
+            const std::string key = string();
+            expect(':');
+            skip();
+
+            if(key == "rom" || key == "backend")
+            {
+                (key == "rom" ? result.rom : result.backend) = string();
+            }
+            else
+            {
+                char* end = nullptr;
+                const double value = std::strtod(text.c_str() + position, &end);
+
+                if(end == text.c_str() + position) throw std::runtime_error{"Invalid baseline, expected a number for " + key};
+
+                position = end - text.c_str();
+
+                if(key == "instructions_per_second") result.instructions_per_second = value;
+                else if(key == "frames_per_second")  result.frames_per_second       = value;
+                else if(key == "peak_rss_kb")        result.peak_rss_kb             = value;
+            }
+
+            skip();
+            if(position < text.size() && text[position] == ',') { position++; continue; }
+
+            expect('}');
+            break;
+        }
+
+        results.push_back(result);
+
+        skip();
+        if(position < text.size() && text[position] == ',') { position++; continue; }
+
+        expect(']');
+        break;
+    }
+
+    return results;
+}
+
+static std::string format_rate(double rate)
+{
+    std::ostringstream text;
+
+    if(rate >= 1e9)      text << std::fixed << std::setprecision(2) << rate / 1e9 << "G";
+    else if(rate >= 1e6) text << std::fixed << std::setprecision(2) << rate / 1e6 << "M";
+    else                 text << std::fixed << std::setprecision(0) << rate;
+
+    return text.str();
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 2)
+    {
+        print_usage();
+        return 1;
+    }
+
+    std::string baseline_path;
+    std::string only_backend;
+    bool        update    = false;
+    double      threshold = 10.0;
+    uint32_t    repeat    = 3;
+
+    for(int i = 2 ; i < argc ; i++)
+    {
+        const std::string option = argv[i];
+
+        if(option == "--update")
+        {
+            update = true;
+            continue;
+        }
+
+        if(i + 1 >= argc)
+        {
+            print_usage();
+            return 1;
+        }
+
+        const char* value = argv[++i];
+
+        if(option == "--baseline")       baseline_path = value;
+        else if(option == "--threshold") threshold     = std::strtod(value, nullptr);
+        else if(option == "--repeat")    repeat        = std::max<uint32_t>(std::strtoul(value, nullptr, 10), 1);
+        else if(option == "--backend")   only_backend  = value;
+        else
+        {
+            print_usage();
+            return 1;
+        }
+    }
+
+    std::vector<Workload> workloads;
+    std::vector<Result>   baseline;
+
+    try
+    {
+        std::ifstream suite{argv[1]};
+        if(!suite.is_open()) throw std::runtime_error{"Unable to open suite " + std::string{argv[1]}};
+
+        workloads = parse_suite(suite);
+
+        if(!baseline_path.empty() && !update)
+        {
+            std::ifstream file{baseline_path};
+
+            // Timings only compare on the same machine so, the first run stores the baseline.
+            if(file.is_open()) baseline = parse_results(file);
+            else update = true;
+        }
+    }
+    catch(const std::exception& error)
+    {
+        std::cout << error.what() << "\n";
+        return 1;
+    }
+
+    std::vector<Result> results;
+    uint32_t regressions = 0;
+    uint32_t mismatches  = 0;
+
+    std::cout << std::left << std::setw(14) << "ROM" << std::setw(10) << "Backend" << std::right
+              << std::setw(12) << "Instr/s" << std::setw(12) << "Frames/s" << std::setw(12) << "RSS KB"
+              << std::setw(18) << "State hash" << "  vs baseline \n";
+
+    for(const Workload& workload : workloads)
+    {
+        // Every backend runs the same instructions so, they must end on the state of the cycle backend.
+        uint64_t expected_hash = 0;
+
+        for(uint8_t backend = 0 ; backend < BACKEND_COUNT ; backend++)
+        {
+            if(!only_backend.empty() && only_backend != backend_names[backend]) continue;
+            if(backend == BACKEND_JIT && !chip::CHIP8_JIT_AVAILABLE) continue;
+
+            Measurement best{};
+
+            try
+            {
+                for(uint32_t run = 0 ; run < repeat ; run++)
+                {
+                    const Measurement measurement = measure(workload, static_cast<Backend>(backend));
+
+                    if(run == 0 || measurement.seconds < best.seconds) best = measurement;
+
+                    best.rss_kb = std::max(best.rss_kb, measurement.rss_kb);
+                }
+
+                if(backend == BACKEND_CYCLE) expected_hash = best.hash;
+                else if(only_backend == backend_names[backend]) expected_hash = run_workload(workload, BACKEND_CYCLE).hash;
+            }
+            catch(const std::exception& error)
+            {
+                std::cout << error.what() << "\n";
+                return 1;
+            }
+
+            const double seconds = std::max(best.seconds, 1e-9);
+            const Result result{ workload.name, backend_names[backend], best.cycles / seconds, best.frames / seconds, static_cast<double>(best.rss_kb) };
+
+            results.push_back(result);
+
+            std::cout << std::left << std::setw(14) << result.rom << std::setw(10) << result.backend << std::right
+                      << std::setw(12) << format_rate(result.instructions_per_second)
+                      << std::setw(12) << format_rate(result.frames_per_second)
+                      << std::setw(12) << best.rss_kb
+                      << "  " << std::hex << std::setw(16) << std::setfill('0') << best.hash << std::dec << std::setfill(' ');
+
+            if(best.hash != expected_hash)
+            {
+                mismatches += 1;
+                std::cout << "  MISMATCH";
+            }
+
+            const auto stored = std::find_if(baseline.begin(), baseline.end(), [&](const Result& line)
+            {
+                return line.rom == result.rom && line.backend == result.backend;
+            });
+
+            if(stored == baseline.end())
+            {
+                std::cout << (baseline.empty() ? "\n" : "  new\n");
+                continue;
+            }
+
+            const double speed  = (result.instructions_per_second / stored->instructions_per_second - 1.0) * 100.0;
+            const double frames = (result.frames_per_second / stored->frames_per_second - 1.0) * 100.0;
+            const double memory = stored->peak_rss_kb > 0 ? (result.peak_rss_kb / stored->peak_rss_kb - 1.0) * 100.0 : 0.0;
+
+            const bool regressed = speed < -threshold || frames < -threshold || memory > threshold;
+
+            regressions += regressed;
+
+            std::cout << "  " << std::showpos << std::fixed << std::setprecision(1) << speed << "% speed, "
+                      << memory << "% memory" << std::noshowpos << (regressed ? "  REGRESSION" : "") << "\n";
+        }
+    }
+
+    if(mismatches > 0)
+    {
+        std::cout << mismatches << " backends ended on a state different from the cycle backend \n";
+        return 1;
+    }
+
+    if(update)
+    {
+        std::ofstream file{baseline_path.empty() ? "baseline.json" : baseline_path, std::ios::out | std::ios::trunc};
+
+        if(!file.is_open())
+        {
+            std::cout << "Unable to write the baseline \n";
+            return 1;
+        }
+
+        write_results(file, results);
+        std::cout << "Baseline updated \n";
+
+        return 0;
+    }
+
+    if(regressions > 0)
+    {
+        std::cout << regressions << " regressions above " << threshold << "% \n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+#include "../include/trace.h"
+
+static void print_usage()
+{
+    std::cout << "Usage: chip8-trace <TRACE> [options] \n"
+              << "  --top N  basic blocks and loops reported (default 20) \n"
+              << "The trace is written by chip8-headless --trace. \n";
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 2)
+    {
+        print_usage();
+        return 1;
+    }
+
+    size_t top = 20;
+
+    for(int i = 2 ; i < argc ; i++)
+    {
+        const std::string option = argv[i];
+
+        if(i + 1 >= argc)
+        {
+            print_usage();
+            return 1;
+        }
+
+        const char* value = argv[++i];
+
+        if(option == "--top") top = std::strtoull(value, nullptr, 10);
+        else
+        {
+            print_usage();
+            return 1;
+        }
+    }
+
+    try
+    {
+        const chip::TraceFile file{std::string{argv[1]}};
+
+        const auto start = std::chrono::steady_clock::now();
+
+        const chip::TraceAnalysis analysis = chip::analyze_trace(file.data, file.size);
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "Bytes: " << file.size << "\n";
+        std::cout << "Bytes per instruction: " << std::fixed << std::setprecision(2)
+                  << (analysis.instructions > 0 ? static_cast<double>(file.size) / analysis.instructions : 0.0) << "\n";
+        std::cout << "Seconds: " << seconds << "\n";
+
+        chip::write_trace_report(std::cout, analysis, top);
+    }
+    catch(const std::exception& error)
+    {
+        std::cout << error.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}